@@ -0,0 +1,245 @@
+#include "AabbTree.h"
+
+// A moved box gets room for this many more moves like the last one
+#define MOVES_AHEAD 4
+
+AabbTree::AabbTree(Real fMargin):m_fMargin(fMargin)
+{
+	Clear();
+}
+
+void AabbTree::Clear()
+{
+	m_vNodes.clear();
+	m_nRoot = m_nFree = -1;
+	m_nLeaves = 0;
+}
+
+int AabbTree::AllocNode()
+{
+	int nNode = m_nFree;
+	if( nNode < 0 )
+	{
+		nNode = (int)m_vNodes.size();
+		m_vNodes.resize(nNode + 1);
+	}
+	else
+		m_nFree = m_vNodes[nNode].nParent;
+	Node &node = m_vNodes[nNode];
+	node.nParent = node.nLeft = node.nRight = -1;
+	node.nHeight = 0;
+	node.nData = -1;
+	return nNode;
+}
+
+void AabbTree::FreeNode(int nNode)
+{
+	m_vNodes[nNode].nParent = m_nFree;
+	m_vNodes[nNode].nHeight = -1;
+	m_nFree = nNode;
+}
+
+void AabbTree::Fix(int nNode)
+{
+	Node &node = m_vNodes[nNode];
+	const Node &left = m_vNodes[node.nLeft], &right = m_vNodes[node.nRight];
+	node.box = left.box.Union(right.box);
+	node.nHeight = 1 + max(left.nHeight, right.nHeight);
+}
+
+int AabbTree::Insert(const Aabb &box, int nData)
+{
+	const int nLeaf = AllocNode();
+	Node &leaf = m_vNodes[nLeaf];
+	Aabb fat = { box.fMinX - m_fMargin, box.fMinY - m_fMargin, box.fMaxX + m_fMargin, box.fMaxY + m_fMargin };
+	leaf.box = fat;
+	leaf.nData = nData;
+	InsertLeaf(nLeaf);
+	m_nLeaves++;
+	return nLeaf;
+}
+
+void AabbTree::Remove(int nProxy)
+{
+	ASSERT(nProxy >= 0 && nProxy < (int)m_vNodes.size() && m_vNodes[nProxy].IsLeaf());
+	RemoveLeaf(nProxy);
+	FreeNode(nProxy);
+	m_nLeaves--;
+}
+
+bool AabbTree::Move(int nProxy, const Aabb &box, Real dx, Real dy)
+{
+	ASSERT(nProxy >= 0 && nProxy < (int)m_vNodes.size() && m_vNodes[nProxy].IsLeaf());
+	Node &leaf = m_vNodes[nProxy];
+	if( leaf.box.Contains(box) )
+		return false;
+	// room for the margin and for a few moves like the last one
+	Aabb fat = { box.fMinX - m_fMargin, box.fMinY - m_fMargin, box.fMaxX + m_fMargin, box.fMaxY + m_fMargin };
+	if( dx < 0 )
+		fat.fMinX = fat.fMinX + MOVES_AHEAD * dx;
+	else
+		fat.fMaxX = fat.fMaxX + MOVES_AHEAD * dx;
+	if( dy < 0 )
+		fat.fMinY = fat.fMinY + MOVES_AHEAD * dy;
+	else
+		fat.fMaxY = fat.fMaxY + MOVES_AHEAD * dy;
+	// refitted in place while the parent still covers it, the tree above does not change
+	if( leaf.nParent >= 0 && m_vNodes[leaf.nParent].box.Contains(fat) )
+	{
+		leaf.box = fat;
+		return false;
+	}
+	RemoveLeaf(nProxy);
+	m_vNodes[nProxy].box = fat;
+	InsertLeaf(nProxy);
+	return true;
+}
+
+void AabbTree::InsertLeaf(int nLeaf)
+{
+	if( m_nRoot < 0 )
+	{
+		m_nRoot = nLeaf;
+		m_vNodes[nLeaf].nParent = -1;
+		return;
+	}
+	// go down to the sibling with the least perimeter growth, counting what every level above grows
+	const Aabb box = m_vNodes[nLeaf].box;
+	int nSibling = m_nRoot;
+	while( !m_vNodes[nSibling].IsLeaf() )
+	{
+		const Node &node = m_vNodes[nSibling];
+		const Real fPerimeter = node.box.Perimeter(), fUnion = node.box.Union(box).Perimeter();
+		// a new parent of this node and the leaf, and the growth for its ancestors
+		const Real fCost = 2 * fUnion, fInherited = 2 * (fUnion - fPerimeter);
+		Real fCosts[2];
+		for(int i = 0; i < 2; i++)
+		{
+			const Node &child = m_vNodes[i ? node.nRight : node.nLeft];
+			const Real fChildUnion = child.box.Union(box).Perimeter();
+			fCosts[i] = child.IsLeaf() ? fChildUnion + fInherited : fChildUnion - child.box.Perimeter() + fInherited;
+		}
+		if( fCost < fCosts[0] && fCost < fCosts[1] )
+			break;
+		nSibling = fCosts[0] <= fCosts[1] ? node.nLeft : node.nRight;
+	}
+
+	const int nOldParent = m_vNodes[nSibling].nParent, nParent = AllocNode();
+	Node &parent = m_vNodes[nParent];
+	parent.nParent = nOldParent;
+	parent.nLeft = nSibling;
+	parent.nRight = nLeaf;
+	m_vNodes[nSibling].nParent = nParent;
+	m_vNodes[nLeaf].nParent = nParent;
+	if( nOldParent < 0 )
+		m_nRoot = nParent;
+	else if( m_vNodes[nOldParent].nLeft == nSibling )
+		m_vNodes[nOldParent].nLeft = nParent;
+	else
+		m_vNodes[nOldParent].nRight = nParent;
+
+	for(int nNode = nParent; nNode >= 0; nNode = m_vNodes[nNode].nParent)
+	{
+		nNode = Rotate(nNode);
+		Fix(nNode);
+	}
+}
+
+void AabbTree::RemoveLeaf(int nLeaf)
+{
+	if( nLeaf == m_nRoot )
+	{
+		m_nRoot = -1;
+		return;
+	}
+	const int nParent = m_vNodes[nLeaf].nParent, nGrandParent = m_vNodes[nParent].nParent;
+	const int nSibling = m_vNodes[nParent].nLeft == nLeaf ? m_vNodes[nParent].nRight : m_vNodes[nParent].nLeft;
+	FreeNode(nParent);
+	m_vNodes[nSibling].nParent = nGrandParent;
+	if( nGrandParent < 0 )
+	{
+		m_nRoot = nSibling;
+		return;
+	}
+	if( m_vNodes[nGrandParent].nLeft == nParent )
+		m_vNodes[nGrandParent].nLeft = nSibling;
+	else
+		m_vNodes[nGrandParent].nRight = nSibling;
+	// only shrinks the boxes above, the rotations of the next insertions tidy up
+	for(int nNode = nGrandParent; nNode >= 0; nNode = m_vNodes[nNode].nParent)
+		Fix(nNode);
+}
+
+// Swaps a child with a grandchild under the other child when that makes the other child smaller, returns the node
+int AabbTree::Rotate(int nA)
+{
+	Node &a = m_vNodes[nA];
+	if( a.IsLeaf() )
+		return nA;
+	const int nB = a.nLeft, nC = a.nRight;
+	// best swap: the child nX goes down in place of the grandchild nY under nP, the other child
+	Real fBest = 0;
+	int nX = -1, nY = -1, nP = -1;
+	for(int side = 0; side < 2; side++)
+	{
+		const int nChild = side ? nC : nB, nOther = side ? nB : nC;
+		const Node &other = m_vNodes[nOther];
+		if( other.IsLeaf() )
+			continue;
+		const Real fArea = other.box.Perimeter();
+		for(int k = 0; k < 2; k++)
+		{
+			const int nGrand = k ? other.nRight : other.nLeft, nKeep = k ? other.nLeft : other.nRight;
+			const Real fGain = fArea - m_vNodes[nKeep].box.Union(m_vNodes[nChild].box).Perimeter();
+			if( fGain > fBest )
+			{
+				fBest = fGain;
+				nX = nGrand;
+				nY = nChild;
+				nP = nOther;
+			}
+		}
+	}
+	if( nX < 0 )
+		return nA;
+	// nX comes up as a child of nA, nY goes down under nP
+	Node &p = m_vNodes[nP];
+	if( p.nLeft == nX )
+		p.nLeft = nY;
+	else
+		p.nRight = nY;
+	if( a.nLeft == nY )
+		a.nLeft = nX;
+	else
+		a.nRight = nX;
+	m_vNodes[nX].nParent = nA;
+	m_vNodes[nY].nParent = nP;
+	Fix(nP);
+	return nA;
+}
+
+bool AabbTree::Validate() const
+{
+	int nLeaves = 0;
+	for(int i = 0; i < (int)m_vNodes.size(); i++)
+	{
+		const Node &node = m_vNodes[i];
+		if( node.nHeight < 0 )
+			continue;
+		if( i == m_nRoot ? node.nParent >= 0 : node.nParent < 0 )
+			return false;
+		if( node.IsLeaf() )
+		{
+			nLeaves++;
+			if( node.nHeight != 0 )
+				return false;
+			continue;
+		}
+		const Node &left = m_vNodes[node.nLeft], &right = m_vNodes[node.nRight];
+		if( left.nParent != i || right.nParent != i || !node.box.Contains(left.box) || !node.box.Contains(right.box) )
+			return false;
+		if( node.nHeight != 1 + max(left.nHeight, right.nHeight) )
+			return false;
+	}
+	return nLeaves == m_nLeaves;
+}
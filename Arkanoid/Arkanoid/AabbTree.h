@@ -0,0 +1,97 @@
+#ifndef __AABBTREE_H_
+#define __AABBTREE_H_
+
+#include <vector>
+
+#include "Utils.h"
+#include "Math.h"
+
+// Query stack size, far above the height of any tree of boxes that fit in memory
+#define MAX_TREE_DEPTH 256
+
+// Axis aligned box in simulation units
+struct Aabb
+{
+	Real fMinX, fMinY, fMaxX, fMaxY;
+
+	bool Contains(const Aabb &box) const { return fMinX <= box.fMinX && fMinY <= box.fMinY && box.fMaxX <= fMaxX && box.fMaxY <= fMaxY; }
+	bool Overlaps(const Aabb &box) const { return fMinX <= box.fMaxX && box.fMinX <= fMaxX && fMinY <= box.fMaxY && box.fMinY <= fMaxY; }
+	Real Perimeter() const { return 2 * (fMaxX - fMinX + fMaxY - fMinY); }
+	Aabb Union(const Aabb &box) const
+	{
+		Aabb u = { min(fMinX, box.fMinX), min(fMinY, box.fMinY), max(fMaxX, box.fMaxX), max(fMaxY, box.fMaxY) };
+		return u;
+	}
+};
+
+// Dynamic bounding volume tree for colliders off the level grid.
+// Leaves hold boxes grown by a margin and by the last move, so a collider moving a little every tick
+// is only reinserted when it leaves its box. Insertion picks the sibling by the growth of the
+// perimeters on the way down, and on the way up rotations swap in whatever makes the boxes smaller,
+// which keeps queries logarithmic also for colliders inserted in no particular order.
+class AabbTree
+{
+	struct Node
+	{
+		Aabb box;
+		int nParent;         // next free node while on the free list
+		int nLeft, nRight;   // -1 for leaves
+		int nHeight;         // 0 for leaves, -1 for free nodes
+		int nData;
+		bool IsLeaf() const { return nLeft < 0; }
+	};
+	std::vector<Node> m_vNodes;
+	int m_nRoot, m_nFree, m_nLeaves;
+	Real m_fMargin;
+
+	int AllocNode();
+	void FreeNode(int nNode);
+	void InsertLeaf(int nLeaf);
+	void RemoveLeaf(int nLeaf);
+	int Rotate(int nNode);
+	void Fix(int nNode); // box and height from the children
+public:
+	// fMargin is the room around every box
+	AabbTree(Real fMargin = 0.1f);
+	void Clear();
+
+	// Returns the proxy of the box, valid until Remove
+	int Insert(const Aabb &box, int nData);
+	void Remove(int nProxy);
+	// The box moved by (dx, dy) since the last call. Returns true if the proxy had to be reinserted.
+	bool Move(int nProxy, const Aabb &box, Real dx, Real dy);
+
+	int GetData(int nProxy) const { return m_vNodes[nProxy].nData; }
+	const Aabb &GetFatBox(int nProxy) const { return m_vNodes[nProxy].box; }
+	int GetCount() const { return m_nLeaves; }
+	int GetHeight() const { return m_nRoot < 0 ? 0 : m_vNodes[m_nRoot].nHeight; }
+	// Checks the links, boxes and heights of every node
+	bool Validate() const;
+
+	// Calls f(nData) for every leaf whose box overlaps the box, nTests counts the nodes tested
+	template<class F>
+	void Query(const Aabb &box, F f, int &nTests) const
+	{
+		if( m_nRoot < 0 )
+			return;
+		int stack[MAX_TREE_DEPTH], nStack = 0;
+		stack[nStack++] = m_nRoot;
+		while( nStack )
+		{
+			const Node &node = m_vNodes[stack[--nStack]];
+			nTests++;
+			if( !node.box.Overlaps(box) )
+				continue;
+			if( node.IsLeaf() )
+				f(node.nData);
+			else
+			{
+				ASSERT(nStack + 2 <= MAX_TREE_DEPTH);
+				stack[nStack++] = node.nRight;
+				stack[nStack++] = node.nLeft;
+			}
+		}
+	}
+};
+
+#endif __AABBTREE_H_
@@ -1,7 +1,7 @@
 #include <deque>
 
-#include "application.h"
-#include "utils.h"
+#include "Application.h"
+#include "Utils.h"
 
 #ifndef WM_TOGGLEFULLSCREEN							// Application Define Message For Toggling
 #	define WM_TOGGLEFULLSCREEN (WM_USER+1)									
@@ -3,7 +3,7 @@
 
 #include <windows.h>
 
-#include "ui.h"
+#include "UI.h"
 
 #define Message(fmt, ...) Message(hWnd, fmt, __VA_ARGS__)
 
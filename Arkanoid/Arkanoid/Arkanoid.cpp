@@ -2,26 +2,23 @@
 #include <map>
 #include <math.h>
 
-#include "utils.h"
-#include "graphics.h"
-#include "ui.h"
-#include "math.h"
-#include "application.h"
-#include "comm.h"
-
-#define LEVEL_WIDTH 20
-#define LEVEL_HEIGHT 10
-#define MAX_DIST (LEVEL_WIDTH * LEVEL_HEIGHT)
-#define MAX_TYPE 4
-
-#define SQRT2 1.41421356237f
+#include "Utils.h"
+#include "Graphics.h"
+#include "UI.h"
+#include "Math.h"
+#include "Application.h"
+#include "Comm.h"
+#include "Simulation.h"
+#include "Particles.h"
+#include "Profile.h"
+#include "Path.h"
 
 float fPerspAngle = 60;
 float fPerspNearZ = 0.01f;
 float fPerspFarZ = 100.0f;
 std::map<std::string, Image> mImages;
 const Image *imgBall2D = NULL;
-Texture texBall, texParticle, texWood, texStation, texElectronics, texSmile, texLava, texClock, texPlatform;
+Texture texBall, texParticle, texStation, texElectronics, texLava, texPlatform, texBricks[MAX_TYPE];
 GLfloat
 	pLightAmbient[]= { 0.5f, 0.5f, 0.5f, 1.0f }, // Ambient Light Values
 	pLightDiffuse[]= { 1.0f, 1.0f, 1.0f, 1.0f }, // Diffuse Light Values
@@ -34,51 +31,30 @@ float fLastSimTime = 0;
 GLenum uFogQuality = GL_DONT_CARE;
 
 Timer timer;
-DisplayList dlBall, dlBrickBall, dlBrickCube, dlBack, dlSides, dlBottom, dlPlatform;
+DisplayList dlBall, dlBricks[MAX_SHAPE], dlBack, dlSides, dlBottom, dlPlatform;
 Transform transform;
 const float
 	fPlaneZDef = -4.8f,
 	fParPlaneZ = -20.0f,
-	fBallSpeed = 1.5f,
 	fBallRotation = 60.0f,
-	fBallR = 0.2,
-	fLevelWidth = 5.0f,
-	fBrickMargin = 0.01f,
-	fBrickSize = fLevelWidth / (LEVEL_WIDTH - 1) - fBrickMargin,
-	fBrickRadiusBall = 0.85f * fBrickSize / 2,
-	fBrickRadiusCube = fBrickSize / 2,
-	fMinDistBase = fBallR + 0.71f * fBrickSize,
-	fMinDistBall = fBallR + fBrickRadiusBall,
-	fLevelHeight = (LEVEL_HEIGHT - 1) * (fBrickSize + fBrickMargin),
-	fLevelOffsetX = 0,
-	fLevelOffsetY = 0.5f,
-	fLevelMinX = fLevelOffsetX - fLevelWidth / 2,
-	fLevelMaxX = fLevelOffsetX + fLevelWidth / 2,
-	fLevelMinY = fLevelOffsetY - fLevelHeight / 2,
-	fLevelMaxY = fLevelOffsetY + fLevelHeight / 2,
-	fMaxSelDist = fBrickSize,
-	fMaxSelDist2 = fMaxSelDist * fMaxSelDist,
 	fLevelDepth = 1.0f,
-	fLevelSpanX = 3.0f,
-	fLevelSpanY = 3 * fLevelSpanX / 4,
-	fPlatW = 1.0f, fPlatV = 2.0f, fPlatY = -fLevelSpanY + 0.3f,
-	fBallXStart = 0, fBallYStart = fPlatY + fBallR, fBallZStart = 0;
+	fBallZStart = 0;
 float
 	fPlaneZ = fPlaneZDef,
-	fBallX = fBallXStart, fBallY = fBallYStart, fBallZ = fBallZStart,
-	fBallA = 0,
-	fBallDirX = 0, fBallDirY = 0,
+	fBallZ = fBallZStart,
 	fBallRotX = 0, fBallRotY = 1, fBallRotZ = 0,
 	fSelX = -1.0f, fSelY = -1.0f, fSelZ = 0.0f,
-	fPlatX = 0;
+	fSimTimeAcc = 0;
+Quaternion qBall; // the spin of the ball
 int nNewWinX = -1, nNewWinY = -1, nBallN = 6;
-bool bNewBall = false, bNewMouse = false, bNewSelection = false, bValidSpeed = false, bNewMouseClick = false, bMouseReleased = true, bNewClick = false;
+const int nMaxTicksPerFrame = 30;
+bool bNewBall = false, bNewMouse = false, bNewSelection = false, bNewAim = false, bNewMouseClick = false, bMouseReleased = true, bNewClick = false;
 Font font("Times New Roman", -16), smallFont("Courier New", -12);
 Event evComm;
 Panel c_pEditor, c_pGame, c_pControls, c_pParticles, c_pTest;
 Label c_lPath;
 Button c_bExit, c_bLoad, c_bSave;
-CheckBox c_cbFullscreen, c_cbGeometry, c_cbParticles, c_cbBrush;
+CheckBox c_cbFullscreen, c_cbGeometry, c_cbParticles, c_cbBrush, c_cbSparks;
 SliderBar c_sFriction, c_sSlowdown, c_sBrick;
 static CriticalSection csReceive, csSend;
 
@@ -86,62 +62,32 @@ std::deque<float> lfFrameIntervals;
 const float fTimeSumMax = 3;
 float fLastFrameTime = 0, fFrameInterval = 0, fSimTimeCoef = 1.0f;
 bool bGeometry = false;
-#define MAX_PARTICLES 1200
-float
-	fParSlowdown = 0.0f,
-	fParSpeedX = 5.0f, fParSpeedY = 3.0f, 
-	fParSpeedInitMin = 1.0f, fParSpeedInitMax = 2.0f,
-	fParAccelX = 0.0f, fParAccelY = -1.5f, fParAccelZ = 0.0f,
-	fParFriction = 0.05f,
-	fParFadeMin = 0.05f, fParFadeMax = 0.5f,
-	fParMaxAge = 6.0f,
-	fParResizeMax = -0.15f, fParResizeMin = -0.05f,
-	fParSizeMin = 0.45f, fParSizeMax = 0.55f,
-	fParRotateMax = 50.0f, fParRotateMin = -50.0f,
-	fParX0 = 0, fParY0 = 0, fParZ0 = fParPlaneZ;
-static GLfloat pfParColors[12][3] =
-{
-    {1.0f,0.5f,0.5f}, {1.0f,0.75f,0.5f}, {1.0f,1.0f,0.5f}, {0.75f,1.0f,0.5f},
-    {0.5f,1.0f,0.5f}, {0.5f,1.0f,0.75f}, {0.5f,1.0f,1.0f}, {0.5f,0.75f,1.0f},
-    {0.5f,0.5f,1.0f}, {0.75f,0.5f,1.0f}, {1.0f,0.5f,1.0f}, {1.0f,0.5f,0.75f}
-};
-struct Particle
-{
-	float age, alpha, size;
-    float fade, resize, rotate;
-	float r, g, b;
-	float x, y, z;
-	float vx, vy,vz;
-	float angle;
-}
-particles[MAX_PARTICLES] = {0};
+ParticleParams parParams = parDefault;
+Particle particles[MAX_PARTICLES] = {0};
+ParticleCollider parCollider;
+RandGen parGen;
 FileDialog fd;
 Directory dir;
 bool bEditor = false, bInterface = false, bTest = false;
-const int nBrickCount = LEVEL_WIDTH * LEVEL_HEIGHT;
-struct Brick
-{
-	int type;
-	float x, y;
-} bricks[ nBrickCount ] = {};
-float pfWayPath[nBrickCount] = {0};
+World world;
+SimEventQueue simEvents;
+LevelGrid &level = world.level;
+PathField wayField;
+unsigned int uWayVersion = 0; // level version the costs of wayField are from
+// Cells set since uWayVersion, as long as the level only changed through SimStep and the brush: uWayKnown is then
+// its version. Otherwise the level is ahead of uWayKnown and the repair of wayField sets every cell.
+std::vector<int> vWayChanges;
+unsigned int uWayKnown = 0;
 float fJumpEffectZ = 0;
 int nSelectedBrick = -1;
 std::string strCurrentLevel;
 bool bSortDraw = true;
+#ifdef SIM_PROFILE
+bool bProfile = false; // last tick and the peaks of the profile ring on screen
+const char *pchProfilePath = "profile.tsv";
+#endif
 const bool bManhatDist = true;
 
-#define rc fBrickRadiusCube
-#define rb fBallR
-const float fBoxSeg[4][5][2] = {
-	{ { 0,-1}, { -rc,      -rc - rb }, {  rc,      -rc - rb }, { -rc, -rc }, {  0,   rb } }, // bottom side
-	{ { 1, 0}, {  rc + rb, -rc      }, {  rc + rb,  rc      }, {  rc, -rc }, { -rb,   0 } }, // right side
-	{ { 0, 1}, { -rc,       rc + rb }, {  rc,       rc + rb }, {  rc,  rc }, {   0, -rb } }, // top side
-	{ {-1, 0}, { -rc - rb, -rc      }, { -rc - rb,  rc      }, { -rc,  rc }, {  rb,   0 } }, // left side
-};
-#undef rc
-#undef rb
-
 const char *pchServerIP = "localhost";
 int nServerPort = 12345;
 std::string strSend, strReceive;
@@ -260,10 +206,29 @@ void ToggleTest()
 	UpdateUI();
 }
 
+// Sets a brick from the editor, keeping the cell for the repair of wayField
+void SetBrick(int o, int type)
+{
+	const bool bKnown = uWayKnown == level.GetVersion();
+	level.Set(o, type);
+	if( !bKnown )
+		return;
+	vWayChanges.push_back(o);
+	uWayKnown = level.GetVersion();
+}
+
 void SetBrickType()
 {
 	if ( nSelectedBrick != -1 )
-		bricks[nSelectedBrick].type = Round(c_sBrick.m_slider.m_fValue);
+		SetBrick(nSelectedBrick, Round(c_sBrick.m_slider.m_fValue));
+}
+
+// Walls follow the level size
+void DestroyWalls()
+{
+	dlBack.Destroy();
+	dlSides.Destroy();
+	dlBottom.Destroy();
 }
 
 bool LoadLevel(const char *pchPath)
@@ -278,28 +243,18 @@ bool LoadLevel(const char *pchPath)
 		Print("Cannot open %s for reading!", pchPath);
 		return false;
 	}
-	int index = 0;
-	int types[nBrickCount] = {};
-	for (int i = 0; i < nBrickCount; i++)
-	{
-		int type = -1;
-		if (fscanf(f, "%d,", &type) <= 0 || type < 0 || type >= MAX_TYPE)
-		{
-			Print("Corrupted level file: %s", pchPath);
-			return false;
-		}
-		types[i] = type;
-	}
-	for (int i = 0; i < nBrickCount; i++)
+	LevelGrid newLevel;
+	ErrorCode err = newLevel.Read(f);
+	if( err )
 	{
-		bricks[i].type = types[i];
+		Print("Error reading level %s: %s\n", pchPath, err);
+		return false;
 	}
+	level = newLevel;
 	nSelectedBrick = -1;
-	fBallX = fBallXStart;
-	fBallY = fBallYStart;
+	SimCreate(world);
+	DestroyWalls();
 	fBallZ = fBallZStart;
-	fBallDirX = 0;
-	fBallDirY = 0;
 	return true;
 }
 
@@ -319,8 +274,12 @@ bool SaveLevel(const char *pchPath)
 		Print("Cannot open %s for writing!", pchPath);
 		return false;
 	}
-	for (int i = 0; i < nBrickCount; i++)
-		fprintf(f, "%d,", bricks[i].type);
+	ErrorCode err = level.Write(f);
+	if( err )
+	{
+		Print("Error writing level %s: %s\n", pchPath, err);
+		return false;
+	}
 	return true;
 }
 
@@ -339,6 +298,20 @@ void ToggleParticlesDlg()
 	c_pParticles.m_bVisible = !c_pParticles.m_bVisible;
 }
 
+#ifdef SIM_PROFILE
+void DumpProfile()
+{
+	File f;
+	if( !f.Open(pchProfilePath, "wt") )
+	{
+		Print("Cannot open %s for writing!\n", pchProfilePath);
+		return;
+	}
+	profiler.Dump(f);
+	Print("Profile of %d ticks written to %s\n", profiler.GetCount(), pchProfilePath);
+}
+#endif
+
 BOOL ReadImage(Image &image, const char *pchFilename)
 {
 	ErrorCode err = image.ReadTGA(pchFilename);
@@ -384,18 +357,6 @@ void ScreenToScene(const int &x0, const int &y0, float &x, float &y, float &z)
 	z = (float)dZ;
 }
 
-float SetNewDir(float dx, float dy)
-{
-	float fDist2 = dx*dx + dy*dy;
-	if( fDist2 > 0 )
-	{
-		float fDistRec = FastInvSqrt(fDist2);
-		fBallDirX = dx * fDistRec;
-		fBallDirY = dy * fDistRec;
-	}
-	return fDist2;
-}
-
 void Draw2D()
 {
 	char buff[128];
@@ -427,18 +388,81 @@ void Draw2D()
 		font.Print(buff, 5, (float)app.nWinHeight, 0xffffffff, ALIGN_LEFT, ALIGN_TOP);
 	}
 
+#ifdef SIM_PROFILE
+	if( bProfile && profiler.GetCount() )
+	{
+		ProfTick peak;
+		profiler.GetPeak(peak);
+		const ProfTick &last = profiler.GetTick(0);
+		char name[32];
+		float y = (float)app.nWinHeight - 40;
+		for(int i = 0; i < MAX_PROF_COUNTER; i++, y -= 20)
+		{
+			FORMAT(buff, "%s: %d, peak %d", Profiler::GetCounterName(i, name, sizeof(name)), last.nCounters[i], peak.nCounters[i]);
+			font.Print(buff, 5, y, 0xffffffff, ALIGN_LEFT, ALIGN_TOP);
+		}
+		for(int i = 0; i < MAX_PROF_TIMER; i++, y -= 20)
+		{
+			FORMAT(buff, "%s: %.0f us, peak %.0f us", Profiler::GetTimerName((ProfTimer)i), 1e6f * last.fTimes[i], 1e6f * peak.fTimes[i]);
+			font.Print(buff, 5, y, 0xffffffff, ALIGN_LEFT, ALIGN_TOP);
+		}
+	}
+#endif
+
 	if( bTest )
 	{
 	}
 	else if(bEditor)
 	{
 	}
-	else if( bInterface && imgBall2D )
+	else
 	{
-		imgBall2D->Draw(0, 0);
+		int nHard = 0;
+		for(int type = 1; type < MAX_TYPE; type++)
+			if( brickTypes[type].nHitPoints > 1 )
+				nHard += level.GetCount(type);
+		FORMAT(buff, "Bricks: %d, Hard: %d", level.GetCount(), nHard);
+		font.Print(buff, (float)app.nWinWidth/2, (float)app.nWinHeight - 20, 0xffffffff, ALIGN_CENTER, ALIGN_TOP);
+		if( bInterface && imgBall2D )
+			imgBall2D->Draw(0, 0);
 	}
 }
 
+void DrawBrick(int x, int y, int type)
+{
+	bool bSelected = y * level.GetWidth() + x == nSelectedBrick;
+	float z = 0;
+	glPushAttrib(GL_ENABLE_BIT);
+	if( bEditor && bSelected )
+	{
+		z = 0.1f + 0.1f*sinf(fJumpEffectZ);
+		glDisable(GL_FOG);
+	}
+	glPushMatrix();
+	glTranslatef((float)level.GetX(x), (float)level.GetY(y), z);
+	if( type )
+	{
+		texBricks[type].Bind();
+		dlBricks[brickTypes[type].eMesh].Execute();
+	}
+	else if( bEditor )
+	{
+		texParticle.Bind();
+		dlBricks[ShapeBall].Execute();
+	}
+	glPopMatrix();
+	glPopAttrib();
+}
+
+void DrawMover(const SimMover &mover)
+{
+	glPushMatrix();
+	glTranslatef((float)mover.fX, (float)mover.fY, 0);
+	texBricks[mover.nType].Bind();
+	dlBricks[brickTypes[mover.nType].eMesh].Execute();
+	glPopMatrix();
+}
+
 void Draw3D()
 {
 	glTranslatef(0, 0, fPlaneZ);
@@ -453,23 +477,23 @@ void Draw3D()
 			bNewClick = true;
 		}
 		ScreenToScene(nNewWinX, nNewWinY, fSelX, fSelY, fSelZ);
-		bValidSpeed = SetNewDir(fSelX - fBallX, fSelY - fBallY) > 0;
+		bNewAim = true;
 	}
 	
-	if( !dlBrickBall )
+	if( !dlBricks[ShapeBall] )
 	{
-		CompileDisplayList cds(dlBrickBall);
-		DrawSphere(fBrickRadiusBall, 4);
+		CompileDisplayList cds(dlBricks[ShapeBall]);
+		DrawSphere((float)fBrickRadiusBall, 4);
 	}
-	if( !dlBrickCube )
+	if( !dlBricks[ShapeCube] )
 	{
-		CompileDisplayList cds(dlBrickCube);
-		DrawCube(2 * fBrickRadiusCube);
+		CompileDisplayList cds(dlBricks[ShapeCube]);
+		DrawCube(2 * (float)fBrickRadiusCube);
 	}
 	if( !dlBack )
 	{
 		CompileDisplayList cds(dlBack);
-		const float depth = fLevelDepth, spanx = fLevelSpanX, spany = fLevelSpanY;
+		const float depth = fLevelDepth, spanx = (float)world.fSpanX, spany = (float)world.fSpanY;
 		glBegin(GL_QUADS);
 		// background
 		glNormal3f(0.0f, 0.0f, 1.0f);
@@ -483,7 +507,7 @@ void Draw3D()
 	if( !dlSides )
 	{
 		CompileDisplayList cds(dlSides);
-		const float depth = fLevelDepth, spanx = fLevelSpanX, spany = fLevelSpanY;
+		const float depth = fLevelDepth, spanx = (float)world.fSpanX, spany = (float)world.fSpanY;
 		glBegin(GL_QUADS);
 		// left side
 		glNormal3f(1.0f, 0.0f, 0.0f);
@@ -509,7 +533,7 @@ void Draw3D()
 	if( !dlBottom )
 	{
 		CompileDisplayList cds(dlBottom);
-		const float depth = fLevelDepth, spanx = fLevelSpanX, spany = fLevelSpanY;
+		const float depth = fLevelDepth, spanx = (float)world.fSpanX, spany = (float)world.fSpanY;
 		glBegin(GL_QUADS);
 		// bottom side
 		glNormal3f(0.0f, 1.0f, 0.0f);
@@ -523,7 +547,7 @@ void Draw3D()
 	if( !dlPlatform )
 	{
 		CompileDisplayList cds(dlPlatform);
-		const float hw = fPlatW / 2, hh = 0.25f;
+		const float hw = (float)fPlatW / 2, hh = 0.25f;
 		glBegin(GL_QUADS);
 		glNormal3f(0.0f, 1.0f, 0.0f);
 		glTexCoord2f(0.0f, 0.0f); glVertex3f(-hw, 0, hh);
@@ -536,7 +560,7 @@ void Draw3D()
 	if( !dlBall || bNewBall )
 	{
 		CompileDisplayList cds(dlBall);
-		DrawSphere(fBallR, nBallN);
+		DrawSphere((float)fBallR, nBallN);
 		bNewBall = false;
 	}
 
@@ -567,6 +591,7 @@ void Draw3D()
 	}
 	else
 	{
+		float fBallX = (float)world.fBallX, fBallY = (float)world.fBallY;
 		GLfloat pGlowPos[] = {fBallX, fBallY, fBallZ, 1.0f};
 		glLightfv(GL_LIGHT2, GL_POSITION, pGlowPos);
 
@@ -578,13 +603,15 @@ void Draw3D()
 
 		glPushMatrix();
 		glTranslatef(fBallX, fBallY, fBallZ);
-		glRotatef(fBallA, fBallRotX, fBallRotY, fBallRotZ);
+		float pBallMatrix[16];
+		qBall.GetMatrix4(pBallMatrix);
+		glMultMatrixf(pBallMatrix);
 		texBall.Bind();
 		dlBall.Execute();
 		glPopMatrix();
 
 		glPushMatrix();
-		glTranslatef(fPlatX, fPlatY, 0);
+		glTranslatef((float)world.fPlatX, (float)world.fPlatY, 0);
 		texPlatform.Bind();
 		dlPlatform.Execute();
 		glPopMatrix();
@@ -592,48 +619,29 @@ void Draw3D()
 	}
 	for(int k = 0; k < MAX_TYPE; k++)
 	{
-		for(int i = 0; i < nBrickCount; i++)
+		if( bEditor && (!k || !bSortDraw) )
 		{
-			const Brick &brick = bricks[i];
-			if( bSortDraw && brick.type != k )
-				continue;
-			bool bSelected = i == nSelectedBrick;
-			float z = 0;
-			glPushAttrib(GL_ENABLE_BIT);
-			if( bEditor && bSelected )
-			{
-				z = 0.1f + 0.1f*sinf(fJumpEffectZ);
-				glDisable(GL_FOG);
-			}
-			glPushMatrix();
-			glTranslatef(brick.x, brick.y, z);
-			switch( brick.type )
+			// the editor shows the empty cells too
+			for(int y = 0; y < level.GetHeight(); y++)
 			{
-			case 1:
-				texSmile.Bind();
-				dlBrickBall.Execute();
-				break;
-			case 2:
-				texWood.Bind();
-				dlBrickCube.Execute();
-				break;
-			case 3:
-				texClock.Bind();
-				dlBrickBall.Execute();
-				break;
-			default:
-				if( bEditor )
+				for(int x = 0; x < level.GetWidth(); x++)
 				{
-					texParticle.Bind();
-					dlBrickBall.Execute();
+					int type = level.Get(x, y);
+					if( !bSortDraw || !type )
+						DrawBrick(x, y, type);
 				}
 			}
-			glPopMatrix();
-			glPopAttrib();
 		}
+		else if( !bSortDraw )
+			level.ForEach(DrawBrick);
+		else if( k )
+			level.ForEach(k, DrawBrick);
 		if( !bSortDraw )
 			break;
 	}
+	for(int i = 0; i < world.movers.GetCount(); i++)
+		if( world.movers[i].nType )
+			DrawMover(world.movers[i]);
 	glPopAttrib();
 	DbgDraw();
 }
@@ -643,18 +651,26 @@ void DrawPar()
 	bool bShow = c_cbParticles.m_bChecked;
 	if( !bShow )
 		return;
-	glTranslatef(0, 0, fParPlaneZ);
-	ScreenToScene(200, 300, fParX0, fParY0, fParZ0);
+	// sparks live in the level plane and are emitted where the ball hits, the others float in front
+	const bool bSparks = c_cbSparks.m_bChecked;
+	if( bSparks )
+		glTranslatef(0, 0, fPlaneZ);
+	else
+	{
+		glTranslatef(0, 0, fParPlaneZ);
+		ScreenToScene(200, 300, parParams.fX0, parParams.fY0, parParams.fZ0);
+	}
+	const float fScale = bSparks ? 0.1f : 1.0f;
 	texParticle.Bind();
 	for (int loop = 0; loop < MAX_PARTICLES; loop++)                   // Loop Through All The Particles
 	{
 		auto &par = particles[loop];
 		glColor4f(par.r, par.g, par.b, par.alpha); // Material color
 		glPushMatrix();
-		glTranslatef(par.x, par.y, par.z);
+		glTranslatef(par.x, par.y, bSparks ? 0 : par.z);
 		glRotatef(par.angle, 0, 0, 1);
 		glBegin(GL_TRIANGLE_STRIP);
-			float s = par.size;
+			float s = par.size * fScale;
 			glTexCoord2d(1, 1); glVertex3f(s, s, 0); // Top Right
 			glTexCoord2d(0, 1); glVertex3f(-s, s, 0); // Top Left
 			glTexCoord2d(1, 0); glVertex3f(s, -s, 0); // Bottom Right
@@ -666,8 +682,8 @@ void DrawPar()
 
 void Randomize()
 {
-	for (int i = 0; i < nBrickCount; i++)
-		bricks[i].type = Random(MAX_TYPE);
+	for (int i = 0; i < level.GetCells(); i++)
+		level.Set(i, Random(MAX_TYPE));
 }
 
 bool LoadNextLevel()
@@ -822,6 +838,14 @@ void Application::OnInput(const Input &input)
 				case VK_F7:
 					fPlaneZ = fPlaneZDef;
 					break;
+#ifdef SIM_PROFILE
+				case VK_F8:
+					bProfile = !bProfile;
+					break;
+				case VK_F9:
+					DumpProfile();
+					break;
+#endif
 				case VK_UP:
 					if(keyboard.alt && nBallN < 10000)
 					{
@@ -858,92 +882,15 @@ void Application::OnInput(const Input &input)
 
 int FindSelectedBrick()
 {
-	int nNewSelectedBrick = -1;
-	float fMinDist2 = 0;
-	for(int i = 0; i < nBrickCount; i++)
-	{
-		const Brick &brick = bricks[i];
-		float dx = fSelX - brick.x, dy = fSelY - brick.y;
-		float fDist2 = dx * dx + dy * dy;
-		if( fDist2 < fMaxSelDist2 && (nNewSelectedBrick < 0 || fDist2 < fMinDist2 ) )
-		{
-			fMinDist2 = fDist2;
-			nNewSelectedBrick = i;
-		}
-	}
-	return nNewSelectedBrick;
-}
-
-static inline int PosPack(int x, int y)
-{
-	return x | (y << 16);
-}
-
-static inline void PosUnpack(int a, int& x, int& y)
-{
-	x = a & 0xFFFF;
-	y = a >> 16;
-}
-
-static const int directions[][2] = {
-	{ 0, -1 }, { -1, 0 }, { 1, 0 }, { 0, 1 },
-	{ -1, -1 }, { 1, 1 }, { -1, 1 }, { 1, -1 },
-};
-
-void Wave(const float *pfWayCost, int x, int y, int width, int height, float *pfWayPath, bool manhat)
-{
-	if( x < 0 || x >= width || y < 0 || y >= height )
-		return;
-	int o = y * width + x;
-	if( IsFloatZero(pfWayCost + o) )
-		return;
-
-	std::fill(pfWayPath, pfWayPath + width * height, FLT_MAX);
-	
-	std::vector<int> vWave[2];
-	size_t uCapacity = width * height / 8;
-	vWave[0].reserve(uCapacity);
-	vWave[1].reserve(uCapacity);
-
-	vWave[0].push_back(PosPack(x, y));
-	pfWayPath[o] = 0;
-	
-	int t = 0;
-	for(;;)
-	{
-		std::vector<int> &pWaveRead = vWave[t];
-		size_t uWaveSize = pWaveRead.size();
-		if( !uWaveSize )
-			break;
-		std::vector<int> &pWaveWrite = vWave[!t];
-		pWaveWrite.clear();
-		t = !t;
-		int *pWavePos = &pWaveRead[0];
-		const int dircount = manhat ? 4 : 8;
-		for( size_t i = 0; i < uWaveSize; i++ )
-		{
-			int x1, y1;
-			PosUnpack(pWavePos[i], x1, y1);
-			const int o1 = y1 * width + x1;
-			const float dist0 = pfWayPath[o1];
-			for( int j = 0; j < dircount; j++ )
-			{
-				int dx = directions[j][0], dy = directions[j][1];
-				if( (y1 == 0 && dy < 0) || (y1 == height-1 && dy > 0) || (x1 == 0 && dx < 0) || (x1 == width-1 && dx > 0) )
-					continue;
-				int o = o1 + dy * width + dx;
-				float cost = pfWayCost[o];
-				if( IsFloatZero(cost) )
-					continue;
-				float step = dx && dy ? SQRT2 : 1;
-				float *fPath = pfWayPath + o, dist = dist0 + step * cost;
-				if( dist >= *fPath )
-					continue;
-				pWaveWrite.push_back(PosPack(x1 + dx, y1 + dy));
-				*fPath = dist;
-			}
-		}
-	}
+	// the nearest cell center is in the rounded cell
+	float fMaxSelDist = (float)fBrickSize;
+	int x = level.GetCellX(fSelX), y = level.GetCellY(fSelY);
+	if( !level.IsValid(x, y) )
+		return -1;
+	float dx = fSelX - (float)level.GetX(x), dy = fSelY - (float)level.GetY(y);
+	if( dx * dx + dy * dy >= fMaxSelDist * fMaxSelDist )
+		return -1;
+	return y * level.GetWidth() + x;
 }
 
 void Application::Update()
@@ -963,26 +910,31 @@ void Application::Update()
 		{
 			DbgClear();
 			int nSel = FindSelectedBrick();
-			if( nSel != -1 && !bricks[nSel].type )
+			const int nWidth = level.GetWidth(), nHeight = level.GetHeight();
+			const float fMaxDist = (float)level.GetCells();
+			if( nSel != -1 && !level.Get(nSel) )
 			{
-				int nSelY = nSel / LEVEL_WIDTH, nSelX = nSel % LEVEL_WIDTH;
+				int nSelY = nSel / nWidth, nSelX = nSel % nWidth;
 				static int nIdx = 0;
 				if( !nIdx && bUpdateClick )
 				{
-					DbgAddCircle(Point(bricks[nSel].x, bricks[nSel].y), 0.03f);
+					DbgAddCircle(Point((float)level.GetX(nSelX), (float)level.GetY(nSelY)), 0.03f);
 					nIdx = 1;
-					float pfWayCost[nBrickCount] = {0};
-					for(int y = 0, o = 0; y < LEVEL_HEIGHT; y++)
-						for(int x = 0; x < LEVEL_WIDTH; x++, o++)
-							pfWayCost[o] = !bricks[o].type;
-					ASSERT(pfWayCost[nSel]);
-					Wave(pfWayCost, nSelX, nSelY, LEVEL_WIDTH, LEVEL_HEIGHT, pfWayPath, bManhatDist);
-					for(int y = 0, o = 0; y < LEVEL_HEIGHT; y++)
+					std::vector<float> vWayCost(level.GetCells(), 1.0f);
+					level.ForEach([&](int x, int y, int) {
+						vWayCost[y * nWidth + x] = 0;
+					});
+					ASSERT(vWayCost[nSel]);
+					wayField.Create(&vWayCost[0], nSelX, nSelY, nWidth, nHeight, bManhatDist);
+					uWayVersion = uWayKnown = level.GetVersion();
+					vWayChanges.clear();
+					const float *pfWayPath = wayField.GetDist();
+					for(int y = 0, o = 0; y < nHeight; y++)
 					{
-						for(int x = 0; x < LEVEL_WIDTH; x++, o++)
+						for(int x = 0; x < nWidth; x++, o++)
 						{
 							float dist = pfWayPath[o];
-							if( dist < MAX_DIST )
+							if( dist < fMaxDist )
 							{
 								Print("%6.2f |", dist);
 							}
@@ -997,21 +949,40 @@ void Application::Update()
 				else
 				{
 					nIdx = 0;
-					float fMinDist = pfWayPath[nSel];
-					if( fMinDist < MAX_DIST )
+					const bool bField = wayField.GetWidth() == nWidth && wayField.GetHeight() == nHeight;
+					// bricks changed since, only the distances they affect are repaired
+					if( bField && uWayVersion != level.GetVersion() )
 					{
-						Point p0(bricks[nSel].x, bricks[nSel].y);
+						if( uWayKnown == level.GetVersion() )
+						{
+							for(size_t i = 0; i < vWayChanges.size(); i++)
+								wayField.SetCost(vWayChanges[i], level.Get(vWayChanges[i]) ? 0.0f : 1.0f);
+						}
+						else // loaded, generated or rolled back
+						{
+							for(int o = 0; o < level.GetCells(); o++)
+								wayField.SetCost(o, level.Get(o) ? 0.0f : 1.0f);
+						}
+						wayField.Update();
+						uWayVersion = uWayKnown = level.GetVersion();
+						vWayChanges.clear();
+					}
+					const float *pfWayPath = wayField.GetDist();
+					float fMinDist = bField ? pfWayPath[nSel] : FLT_MAX;
+					if( fMinDist < fMaxDist )
+					{
+						Point p0((float)level.GetX(nSelX), (float)level.GetY(nSelY));
 						while( fMinDist > 0 )
 						{
 							int nNextIdx = -1;
 							int dircount = bManhatDist ? 4 : 8;
 							for( int j = 0; j < dircount; j++ )
 							{
-								int dx = directions[j][0], dy = directions[j][1];
+								int dx = pathDirections[j][0], dy = pathDirections[j][1];
 								int y = nSelY + dy, x = nSelX + dx;
-								if( y < 0 || y >= LEVEL_HEIGHT || x < 0 || x >= LEVEL_WIDTH)
+								if( !level.IsValid(x, y) )
 									continue;
-								int o = LEVEL_WIDTH * y + x;
+								int o = nWidth * y + x;
 								float fDist = pfWayPath[o];
 								if( fDist < fMinDist )
 								{
@@ -1022,9 +993,9 @@ void Application::Update()
 							ASSERT(nNextIdx != -1);
 							if(nNextIdx == -1)
 								break;
-							nSelY = nNextIdx / LEVEL_WIDTH;
-							nSelX = nNextIdx % LEVEL_WIDTH;
-							Point p1(bricks[nNextIdx].x, bricks[nNextIdx].y);
+							nSelY = nNextIdx / nWidth;
+							nSelX = nNextIdx % nWidth;
+							Point p1((float)level.GetX(nSelX), (float)level.GetY(nSelY));
 							DbgAddVector(p0, p1 - p0); 
 							p0 = p1;
 						}
@@ -1045,9 +1016,9 @@ void Application::Update()
 				if (nSelectedBrick != -1)
 				{
 					if( c_cbBrush.m_bChecked )
-						bricks[nSelectedBrick].type = Round(c_sBrick.GetValue());
+						SetBrick(nSelectedBrick, Round(c_sBrick.GetValue()));
 					else
-						c_sBrick.SetValue((float)bricks[nSelectedBrick].type);
+						c_sBrick.SetValue((float)level.Get(nSelectedBrick));
 				}
 			}
 		}
@@ -1055,209 +1026,82 @@ void Application::Update()
 	}
 	else
 	{
-		float fPlatX0 = fPlatX;
-		if (bKeys[VK_RIGHT])
-			fPlatX = min(fLevelSpanX - fPlatW / 2, fPlatX + fPlatV * dt);
-		else if (bKeys[VK_LEFT])
-			fPlatX = max(-fLevelSpanX + fPlatW / 2, fPlatX - fPlatV * dt);
-		fBallA += fBallRotation * dt;
-		int nLastCollision = -1;
-		float d = fBallSpeed * dt, fNewBallX, fNewBallY;
-		for (;;)
+		qBall = (Quaternion(Point(fBallRotX, fBallRotY, fBallRotZ), fBallRotation * dt) * qBall).Normalize();
+
+		SimInput input = {};
+		input.bRight = !!bKeys[VK_RIGHT];
+		input.bLeft = !!bKeys[VK_LEFT];
+		SimEvent lastHit;
+		bool bHit = false;
+		bool bCleared = world.IsCleared();
+		fSimTimeAcc += dt;
+		for(int nTicks = 0; fSimTimeAcc >= (float)fSimTick; nTicks++)
 		{
-			float dx = fBallDirX * d, dy = fBallDirY * d;
-			float fBallXc = fBallX + 0.5f * dx, fBallYc = fBallY + 0.5f * dy;
-			fNewBallX = fBallX + dx;
-			fNewBallY = fBallY + dy;
-			if (!bValidSpeed)
+			if( nTicks == nMaxTicksPerFrame )
+			{
+				fSimTimeAcc = 0; // too slow to catch up, drop the time
 				break;
-			float fMinDist = fMinDistBase + 0.5f * d, fMinDist2 = fMinDist * fMinDist, colk, coll, colx, coly;
-			bool bNewCollision = false;
-			int i = 0;
-			for(; i < nBrickCount && !bNewCollision; i++)
+			}
+			input.bAim = bNewAim;
+			input.fAimX = fSelX;
+			input.fAimY = fSelY;
+			bNewAim = false;
+			const unsigned int uVersion = level.GetVersion();
+			SimStep(world, input, fSimTick);
+			// the bricks hit are the cells the step set, unless some of the hits were not kept
+			if( uWayKnown == uVersion && !simEvents.nLost )
 			{
-				Brick &brick = bricks[i];
-				if( !brick.type || nLastCollision == i )
-					continue;
-				float dxc = fBallXc - brick.x, dyc = fBallYc - brick.y;
-				if( dxc * dxc + dyc * dyc > fMinDist2 )
-					continue;
-				switch( brick.type )
+				for(int i = 0; i < simEvents.nCount; i++)
+					if( simEvents.events[i].nBrick >= 0 )
+						vWayChanges.push_back(simEvents.events[i].nBrick);
+				uWayKnown = level.GetVersion();
+				// a full pass costs no more than that
+				if( (int)vWayChanges.size() > level.GetCells() )
 				{
-				case 1:
-				case 3:
-					if( dx * (fBallX - brick.x) + dy * (fBallY - brick.y) < 0 && IntersectSegmentCircle2D(fBallX, fBallY, fNewBallX, fNewBallY, brick.x, brick.y, fMinDistBall, &colk) )
-					{
-						colx = brick.x;
-						coly = brick.y;
-						bNewCollision = true;
-						brick.type = 0;
-					}
-					break;
-				case 2:
-					{
-						const float xc = brick.x, yc = brick.y;
-						// first test collision with each box side
-						for(int j = 0; j < 4; j++)
-						{
-							auto fSeg = fBoxSeg[j];
-							if( dx * fSeg[0][0] + dy * fSeg[0][1] > 0 )
-								continue;
-							float
-								fSegX1 = xc + fSeg[1][0],
-								fSegY1 = yc + fSeg[1][1],
-								fSegX2 = xc + fSeg[2][0],
-								fSegY2 = yc + fSeg[2][1];
-							if( IntersectSegmentSegment2D(
-								fBallX, fBallY, fNewBallX, fNewBallY,
-								fSegX1, fSegY1, fSegX2, fSegY2,
-								&colk, &coll) )
-							{
-								colx = fSegX1 + fSeg[4][0] + (fSegX2 - fSegX1) * coll;
-								coly = fSegY1 + fSeg[4][1] + (fSegY2 - fSegY1) * coll;
-								bNewCollision = true;
-								brick.type = 3;
-								break;
-							}
-						}
-						// if no side is hit, test collision with each box corner
-						if( !bNewCollision )
-						{
-							for(int j = 0; j < 4; j++)
-							{
-								auto fCenter = fBoxSeg[j][3];
-								float xco = xc + fCenter[0], yco = yc + fCenter[1];
-								if( dx * (fBallX - xco) + dy * (fBallY - yco) >= 0 )
-									continue;
-								if( IntersectSegmentCircle2D(
-									fBallX, fBallY, fNewBallX, fNewBallY,
-									xco, yco,
-									fBallR, &colk) )
-								{
-									colx = xco;
-									coly = yco;
-									bNewCollision = true;
-									brick.type = 3;
-									break;
-								}
-							}
-						}
-					}
-					break;
+					vWayChanges.clear();
+					uWayKnown = uVersion;
 				}
 			}
-			if (!bNewCollision && nLastCollision != i && dy < 0)
+			fSimTimeAcc -= (float)fSimTick;
+			if( simEvents.nCount )
 			{
-				float fPlatSpan = (fPlatW + abs(fPlatX - fPlatX0)) / 2;
-				float fMinPlatDist = fBallR + 0.5f * d + fPlatSpan;
-				float fPlatXc = (fPlatX + fPlatX0) / 2;
-				float dxc = fBallXc - fPlatXc, dyc = fBallYc - fPlatY;
-				if (dxc * dxc + dyc * dyc <= fMinPlatDist * fMinPlatDist)
-				{
-					if (IntersectSegmentSegment2D(
-						fBallX, fBallY, fNewBallX, fNewBallY,
-						fPlatXc - fPlatSpan, fPlatY + fBallR, fPlatXc + fPlatSpan, fPlatY + fBallR,
-						&colk, &coll))
-					{
-						colx = fPlatXc - fPlatSpan + 2 * fPlatSpan * coll;
-						coly = fPlatY;
-						bNewCollision = true;
-					}
-					else if (IntersectSegmentCircle2D(
-						fBallX, fBallY, fNewBallX, fNewBallY,
-						fPlatXc - fPlatSpan, fPlatY,
-						fBallR, &colk))
-					{
-						colx = fPlatXc - fPlatSpan;
-						coly = fPlatY;
-						bNewCollision = true;
-					}
-					else if (IntersectSegmentCircle2D(
-						fBallX, fBallY, fNewBallX, fNewBallY,
-						fPlatXc + fPlatSpan, fPlatY,
-						fBallR, &colk))
-					{
-						colx = fPlatXc + fPlatSpan;
-						coly = fPlatY;
-						bNewCollision = true;
-					}
-				}
+				lastHit = simEvents.events[simEvents.nCount - 1];
+				bHit = true;
 			}
-			if( !bNewCollision )
-				break;
-			nLastCollision = i;
-			fBallX += dx * colk;
-			fBallY += dy * colk;
+		}
+		if( bHit )
+		{
 			DbgClear();
 
-			Point ptBall(fBallX, fBallY, fBallZ), ptColl(colx, coly, fBallZ);
+			Point ptColl((float)lastHit.fX, (float)lastHit.fY, fBallZ);
+			Point ptBall(ptColl.x + (float)lastHit.fNormX, ptColl.y + (float)lastHit.fNormY, fBallZ);
 			DbgAddVector(ptBall, ptColl - ptBall, 0xffffffff, 0xff0000ff);
-			DbgAddCircle(ptBall, fBallR, 0xff00ffff);
+			DbgAddCircle(ptBall, (float)fBallR, 0xff00ffff);
 
 			Point
-				ptA(fBallX, fBallY, fBallZ),
-				ptB(fBallSpeed * fBallDirX, fBallSpeed * fBallDirY, 0),
+				ptA = ptBall,
+				ptB((float)(fBallSpeed * world.fBallDirX), (float)(fBallSpeed * world.fBallDirY), 0),
 				ptC(fSelX, fSelY, fSelZ),
-				ptD((fBallX - fSelX), (fBallY - fSelY), 0);
+				ptD((ptBall.x - fSelX), (ptBall.y - fSelY), 0);
 			DbgAddVector(ptA, ptB, 0xffffffff);
 			DbgAddVector(ptC, -ptD, 0xffffffff);
 			DbgAddSpline(ptA, ptB, ptC, ptD, 0xffffff00, 1.0f, 0.001f);
-
-			float xn = fBallX - colx, yn = fBallY - coly;
-			float dot = fBallDirX * xn + fBallDirY * yn;
-			float len = -2 * dot / (xn * xn + yn * yn);
-			SetNewDir(fBallDirX + len * xn, fBallDirY + len * yn);
-			d *= 1 - colk;
 		}
-		fBallX = fNewBallX;
-		fBallY = fNewBallY;
-		if( fBallDirX < 0 && fBallX - fBallR <= -fLevelSpanX || fBallDirX > 0 && fBallX + fBallR >= fLevelSpanX  )
-			fBallDirX = -fBallDirX;
-		if( fBallDirY < 0 && fBallY - fBallR <= -fLevelSpanY || fBallDirY > 0 && fBallY + fBallR >= fLevelSpanY  )
-			fBallDirY = -fBallDirY;
+		if( !bCleared && world.IsCleared() )
+			LoadNextLevel();
 
 		// Particles
-		for (int loop = 0; loop < MAX_PARTICLES; loop++)                   // Loop Through All The Particles
+		parParams.fFriction = c_sFriction.m_slider.m_fValue;
+		parParams.fSlowdown = c_sSlowdown.m_slider.m_fValue;
+		if( c_cbSparks.m_bChecked && bHit )
 		{
-			auto &par = particles[loop];
-			if (par.alpha <= 0 || par.age > fParMaxAge)
-			{
-				par.age = 0;
-				par.alpha = Random(0.0f, 1.0f);
-				par.fade = Random(fParFadeMin, fParFadeMax);
-				par.resize = Random(fParResizeMin, fParResizeMax);
-				par.rotate = Random(fParRotateMin, fParRotateMax);
-				par.size = Random(fParSizeMin, fParSizeMax);
-				par.x = fParX0;
-				par.y = fParY0;
-				par.z = fParZ0;
-				float fAngle = Random(0.0f, 2*PI);
-				float fParSpeedInit = Random(fParSpeedInitMin, fParSpeedInitMax);
-				par.vx = fParSpeedX + fParSpeedInit * cosf(fAngle);
-				par.vy = fParSpeedY + fParSpeedInit * sinf(fAngle);
-				par.vz = Random(-fParSpeedInit, fParSpeedInit);
-				float *fColor = pfParColors[(loop / 100) % 12];
-				par.r = fColor[0];
-				par.g = fColor[1];
-				par.b = fColor[2];
-			}
-
-			float fSlowdown = expf(0.69314718056f * c_sSlowdown.m_slider.m_fValue);
-			float dt = fFrameInterval / fSlowdown;
-			par.x += par.vx * dt;
-			par.y += par.vy * dt;
-			par.z += par.vz * dt;
-
-			float fFriction = c_sFriction.m_slider.m_fValue;
-			par.vx += (fParAccelX - fFriction * par.vx) * dt;
-			par.vy += (fParAccelY - fFriction * par.vy) * dt;
-			par.vz += (fParAccelZ - fFriction * par.vz) * dt;
-
-			par.alpha -= par.fade * dt;
-			par.size += par.resize * dt;
-			par.angle += par.rotate * dt;
-			par.age += dt;
+			parParams.fX0 = (float)lastHit.fX;
+			parParams.fY0 = (float)lastHit.fY;
+			parParams.fZ0 = 0;
 		}
+		ParticlesUpdate(particles, MAX_PARTICLES, parParams, fFrameInterval, parGen);
+		if( c_cbSparks.m_bChecked )
+			parCollider.Collide(particles, MAX_PARTICLES, world, 0.5f);
 	}
 }
 
@@ -1465,7 +1309,7 @@ BOOL Application::Create()
 	c_sFriction.m_slider.SetBounds(200, 5, 100, 20);
 	c_sFriction.m_slider.m_nBorderColor = 0xff000000;
 	c_sFriction.m_slider.m_nBackColor = 0xffffffff;
-	c_sFriction.m_slider.m_fValue = fParFriction;
+	c_sFriction.m_slider.m_fValue = parParams.fFriction;
 	c_sFriction.m_slider.m_fMax = 1;
 	c_sFriction.m_slider.m_fMin = 0;
 
@@ -1476,6 +1320,12 @@ BOOL Application::Create()
 	c_sSlowdown.m_slider.m_fMax = 3.0f;
 	c_sSlowdown.m_slider.m_fMin = -3.0f;
 
+	c_cbParticles.CopyTo(c_cbSparks);
+	c_cbSparks.m_strText = "Sparks";
+	c_cbSparks.m_nBottom = 70;
+	c_cbSparks.m_nLeft = 10;
+	c_cbSparks.m_pOnClick = NULL;
+
 	c_cbParticles.CopyTo(c_cbBrush);
 	c_cbBrush.m_strText = "Brush";
 	c_cbBrush.m_nBottom = 90;
@@ -1490,12 +1340,13 @@ BOOL Application::Create()
 	c_sBrick.m_slider.m_nAnchorRight = 5;
 	c_sBrick.m_slider.m_fValue = 0;
 	c_sBrick.m_slider.m_fMin = 0.0f;
-	c_sBrick.m_slider.m_fMax = 2.0f;
+	c_sBrick.m_slider.m_fMax = MAX_TYPE - 1.0f;
 	c_sBrick.m_pchFormat = "%.0f";
 	c_sBrick.m_slider.OnValueChanged = SetBrickType;
 
 	c_pParticles.Add(&c_sFriction);
 	c_pParticles.Add(&c_sSlowdown);
+	c_pParticles.Add(&c_cbSparks);
 
 	c_pControls.SetBounds(320, 10, 400, 150);
 	c_pControls.m_nBorderColor = 0xff0000ff;
@@ -1529,17 +1380,12 @@ BOOL Application::Create()
 	c_container.Add(&c_pTest);
 	c_container._Invalidate();
 
-	for(int y = 0, o = 0; y < LEVEL_HEIGHT; y++)
-	{
-		float fPosY = fLevelMinY + (fLevelMaxY - fLevelMinY) * y / (LEVEL_HEIGHT - 1);
-		for(int x = 0; x < LEVEL_WIDTH; x++, o++)
-		{
-			float fPosX = fLevelMinX + (fLevelMaxX - fLevelMinX) * x / (LEVEL_WIDTH - 1);
-			Brick &brick = bricks[o];
-			brick.x = fPosX;
-			brick.y = fPosY;
-		}
-	}
+	level.Create(LEVEL_WIDTH, LEVEL_HEIGHT);
+	world.pEvents = &simEvents;
+	SimCreate(world);
+#ifdef SIM_PROFILE
+	profiler.Enable(true);
+#endif
 	pchCurrentDir = dir.GetCurrent();
 	Print("Main directory: %s\n", pchCurrentDir);
 	dir.Set("Data", "txt");
@@ -1601,13 +1447,12 @@ BOOL Application::glCreate()
 
 	CreateTexture(texBall,        "ball3d");
 	CreateTexture(texParticle,    "star");
-	CreateTexture(texWood,        "crate");
 	CreateTexture(texStation,     "station");
 	CreateTexture(texElectronics, "electronics");
-	CreateTexture(texSmile,       "smile");
 	CreateTexture(texLava,        "lava");
-	CreateTexture(texClock,       "clock");
 	CreateTexture(texPlatform,    "platform");
+	for(int type = 1; type < MAX_TYPE; type++)
+		CreateTexture(texBricks[type], brickTypes[type].pchTexture);
 
 	fd.m_hWnd = hWnd;
 
@@ -1617,8 +1462,8 @@ BOOL Application::glCreate()
 void Application::glDestroy()
 {
 	dlBall.Destroy();
-	dlBrickBall.Destroy();
-	dlBrickCube.Destroy();
+	for(int i = 0; i < MAX_SHAPE; i++)
+		dlBricks[i].Destroy();
 	dlBack.Destroy();
 	dlSides.Destroy();
 	dlBottom.Destroy();
@@ -0,0 +1,230 @@
+#include <vector>
+
+#include "Utils.h"
+#include "Simulation.h"
+#include "Script.h"
+#include "ThreadPool.h"
+
+// Runs many independent games faster than real time, for AI training and regression tests.
+// Batch [-n games] [-t threads] [-ticks limit] [-seed first] [-script file] [-record file] [-gen WxH:density] [-q] [level files...]
+// Game i uses seed + i and the level files in turn. Without levels every game gets its own generated level.
+// -record saves the input of the first game tick by tick, as a script that replays it without the seed.
+
+int nGames = 1000, nThreads = 0, nMaxTicks = 120 * 60 * 5;
+unsigned int uFirstSeed = 1;
+int nGenWidth = LEVEL_WIDTH, nGenHeight = LEVEL_HEIGHT, nGenDensity = 50;
+bool bQuiet = false;
+const char *pchScript = NULL, *pchRecord = NULL;
+
+struct Game
+{
+	// setup
+	unsigned int uSeed;
+	const LevelGrid *pLevel; // NULL to generate one from the seed
+	const char *pchLevel;
+	const InputScript *pScript;
+	InputScript *pRecord; // NULL to not record
+	// results
+	int nTicks, nBricks, nLeft, nCollisions, nMisses;
+	bool bCleared;
+	float fTime;
+};
+
+static void RunGame(void *param)
+{
+	Game &game = *(Game*)param;
+	Timer timer;
+	RandGen gen(game.uSeed);
+	World world;
+	if( game.pLevel )
+		world.level = *game.pLevel;
+	else
+		world.level.Generate(nGenWidth, nGenHeight, nGenDensity, game.uSeed);
+	SimCreate(world);
+
+	ScriptPlayer player;
+	player.Start(game.pScript);
+	game.nBricks = world.level.GetCount();
+	game.nMisses = 0;
+	for(game.nTicks = 0; game.nTicks < nMaxTicks && !world.IsCleared(); game.nTicks++)
+	{
+		SimInput input;
+		player.Next(world, input);
+		if( !game.nTicks && !input.bAim )
+		{
+			// the script does not launch the ball, the seed does
+			input.bAim = true;
+			input.fAimX = world.fBallX + gen.Next(-1.0f, 1.0f);
+			input.fAimY = world.fBallY + 1;
+		}
+		if( game.pRecord )
+			game.pRecord->Record(game.nTicks, input);
+		Real fDirY = world.fBallDirY;
+		SimStep(world, input, fSimTick);
+		if( fDirY < 0 && world.fBallDirY > 0 )
+		{
+			// bounced back up, off the bottom wall if it is below the platform
+			if( world.fBallY < world.fPlatY )
+				game.nMisses++;
+			player.SetAutoOffset(gen.Next(-0.3f, 0.3f) * fPlatW);
+		}
+	}
+	game.nLeft = world.level.GetCount();
+	game.nCollisions = world.nCollisions;
+	game.bCleared = world.IsCleared();
+	game.fTime = timer.Time();
+}
+
+static bool ReadLevel(LevelGrid &level, const char *pchPath)
+{
+	File f;
+	if( !f.Open(pchPath, "rt") )
+	{
+		Print("Cannot open %s for reading!\n", pchPath);
+		return false;
+	}
+	ErrorCode err = level.Read(f);
+	if( err )
+	{
+		Print("Error reading level %s: %s\n", pchPath, err);
+		return false;
+	}
+	return true;
+}
+
+static bool ReadScript(InputScript &script, const char *pchPath)
+{
+	File f;
+	if( !f.Open(pchPath, "rt") )
+	{
+		Print("Cannot open %s for reading!\n", pchPath);
+		return false;
+	}
+	ErrorCode err = script.Read(f);
+	if( err )
+	{
+		Print("Error reading script %s: %s\n", pchPath, err);
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[], char *envp[])
+{
+	std::vector<const char*> vLevelPaths;
+	for(int i = 1; i < argc; i++)
+	{
+		const char *arg = argv[i], *next = i + 1 < argc ? argv[i + 1] : "";
+		if( !strcmp(arg, "-n") )
+			nGames = atoi(next), i++;
+		else if( !strcmp(arg, "-t") )
+			nThreads = atoi(next), i++;
+		else if( !strcmp(arg, "-ticks") )
+			nMaxTicks = atoi(next), i++;
+		else if( !strcmp(arg, "-seed") )
+			uFirstSeed = (unsigned int)atoi(next), i++;
+		else if( !strcmp(arg, "-script") )
+			pchScript = next, i++;
+		else if( !strcmp(arg, "-record") )
+			pchRecord = next, i++;
+		else if( !strcmp(arg, "-gen") )
+		{
+			if( sscanf(next, "%dx%d:%d", &nGenWidth, &nGenHeight, &nGenDensity) != 3 || nGenWidth <= 0 || nGenHeight <= 0 )
+			{
+				Print("Invalid level generator %s, expected WxH:density\n", next);
+				return -1;
+			}
+			i++;
+		}
+		else if( !strcmp(arg, "-q") )
+			bQuiet = true;
+		else if( arg[0] == '-' )
+		{
+			Print("Unknown option %s\n", arg);
+			return -1;
+		}
+		else
+			vLevelPaths.push_back(arg);
+	}
+	if( nGames <= 0 )
+	{
+		Print("Nothing to run\n");
+		return -1;
+	}
+
+	std::vector<LevelGrid> vLevels(vLevelPaths.size());
+	for(size_t i = 0; i < vLevelPaths.size(); i++)
+		if( !ReadLevel(vLevels[i], vLevelPaths[i]) )
+			return -1;
+
+	// without a script the platform follows the ball
+	InputScript script;
+	if( pchScript )
+	{
+		if( !ReadScript(script, pchScript) )
+			return -1;
+	}
+	else
+		script.Add(0, ScriptAuto);
+
+	ThreadPool pool;
+	ErrorCode err = pool.Start(nThreads);
+	if( err )
+	{
+		Print("Error starting the thread pool: %s\n", err);
+		return -1;
+	}
+
+	std::vector<Game> vGames(nGames);
+	InputScript record;
+	Timer timer;
+	for(int i = 0; i < nGames; i++)
+	{
+		Game &game = vGames[i];
+		ZeroMemory(&game, sizeof(game));
+		game.uSeed = uFirstSeed + i;
+		if( !vLevels.empty() )
+		{
+			game.pLevel = &vLevels[i % vLevels.size()];
+			game.pchLevel = vLevelPaths[i % vLevelPaths.size()];
+		}
+		else
+			game.pchLevel = "generated";
+		game.pScript = &script;
+		game.pRecord = i || !pchRecord ? NULL : &record;
+		pool.Add(RunGame, &game);
+	}
+	pool.Wait();
+	float fTime = timer.Time();
+
+	if( pchRecord )
+	{
+		File f;
+		if( !f.Open(pchRecord, "wt") )
+		{
+			Print("Cannot open %s for writing!\n", pchRecord);
+			return -1;
+		}
+		fprintf(f, "# %s, seed %u, %d ticks\n", vGames[0].pchLevel, vGames[0].uSeed, vGames[0].nTicks);
+		record.Write(f);
+	}
+
+	__int64 nTotalTicks = 0;
+	int nCleared = 0;
+	if( !bQuiet )
+		Print("game\tseed\tlevel\tticks\tbricks\tleft\tcollisions\tmisses\tcleared\tms\n");
+	for(int i = 0; i < nGames; i++)
+	{
+		const Game &game = vGames[i];
+		nTotalTicks += game.nTicks;
+		nCleared += game.bCleared;
+		if( !bQuiet )
+			Print("%d\t%u\t%s\t%d\t%d\t%d\t%d\t%d\t%d\t%.2f\n", i, game.uSeed, game.pchLevel, game.nTicks,
+				game.nBricks, game.nLeft, game.nCollisions, game.nMisses, game.bCleared, 1000 * game.fTime);
+	}
+	Print("Games: %d, cleared: %d, threads: %d, stolen tasks: %d\n", nGames, nCleared, pool.GetThreads(), pool.GetStolen());
+	Print("Ticks: %lld in %.3f s, %.0f ticks/s, %.1f games/s\n", (long long)nTotalTicks, fTime,
+		fTime > 0 ? nTotalTicks / fTime : 0.0f, fTime > 0 ? nGames / fTime : 0.0f);
+	pool.Stop();
+	return 0;
+}
@@ -0,0 +1,1381 @@
+#include <algorithm>
+#include <vector>
+#include <string>
+
+#include "Utils.h"
+#include "Simulation.h"
+#include "Script.h"
+#include "Particles.h"
+#include "Profile.h"
+#include "Path.h"
+#include "FlowField.h"
+#include "ThreadPool.h"
+#include "SplineTree.h"
+
+// Measures the simulation step and the particle update, to compare builds and changes.
+// Bench [-reps n] [-ticks limit] [-traces dir] [-gen WxH:density] [-movers n] [-rollback depth] [-particles n] [-paths WxH:density]
+//       [-threads n] [-o file] [-profile file] [level files...]
+// Every level file is played with the recorded input <traces dir>/<file name>, or with the platform
+// following the ball when there is no trace. Generated levels always use the latter, and so do
+// the -movers cases: n moving bricks on an empty level sized to them, to see the mover tree scale.
+// The first case is then played again with rollbacks: every tick the world goes back -rollback ticks
+// and steps them again, like on a late input from a peer. Depth 0 only saves the snapshots.
+// Then come -particles particles, flying freely and then as sparks bouncing in the world of the first case.
+// The fastmath rows run the FastMath functions and their scalar versions over a million values: trunc and
+// round must match theirs, the rsqrt rows give their largest relative error in left, per billion, and the
+// zero rows check the bit test against the pointer cast it replaced. The estimates differ between processors.
+// The batch rows test a segment against 32 segments or circles per tick with the scalar kernels and the SIMD
+// ones the processor has: shape tests are the targets, collisions the hits, and the checksums must match.
+// The spline rows run DistSplineSpline2 on random pairs of splines at the same levels, with the same checksums:
+// collisions are the pairs within a tenth of a brick, left the ones farther than the sampled nearest points.
+// The rotate rows turn points by slerped quaternions, one by one, with RotatePoints and with TransformPoints
+// at the SIMD levels, the last ones with the same checksums.
+// The splinearc row builds a SplineArc for each of them and places points at even distances along it.
+// The splinetree rows find the nearest splines to points and the pairs of splines near each other through
+// SplineTree, the splinebrute rows by trying them all; their checksums must match, the build is in the timing.
+// Last the path solvers run on -paths grids of random costs with density percent of the cells blocked:
+// a tick is a query, cell tests are the cells expanded and shape tests the cells queued. Wave and Dijkstra
+// fill the distances from a start and must have the same checksum, A* goes from the start to a goal.
+// The delta rows fill them too with PathDeltaStep on -threads threads, with the same checksum; by default on
+// 1, 2, 4 and so on up to the processors or 64.
+// The pathfield row repairs the field of the first start after each of a few cells is blocked or opened.
+// The pathhpa row runs the A* queries over PathHierarchy with the cells of the paths; its paths may be a little
+// longer, the left column says by how much per thousand and the checksum differs. pathhpa-build times building
+// it, left is its entrances; pathhpa-repair times the rebuild of the clusters after each of a few cells changes.
+// Last Wave with only side steps and the BFS run on the same cells all costing 1, again with the same checksum.
+// A* and the jump point search then go between the starts and goals of these cells with diagonals. They add
+// the steps in another order, so their checksums differ and the distances are checked against each other.
+// The pathjump row opens or blocks a cell before each query to time the repair of the jump tables.
+// The flow rows walk agents to a few targets over a level generated like the grid, with a brick put in and
+// taken out again while they go: flow gets the fields from FlowFields, solved counting as cell tests and
+// kept as shape tests, flow-solo solves a field for every agent at every tick. The checksums must match.
+// The results are a tab separated table, one case per line. Everything but ns/tick must match
+// between builds of the same simulation, the checksum covers the final ball and level state.
+// Builds with SIM_PROFILE can write the profile of the last ticks of every case to the -profile file.
+
+int nReps = 5, nMaxTicks = 120 * 60;
+std::vector<int> vDepths, vMovers, vParticles, vThreads;
+std::vector<std::string> vPaths;
+const char *pchTraces = "Traces", *pchOutput = NULL, *pchProfile = NULL;
+
+struct BenchCase
+{
+	std::string strName;
+	LevelGrid level;
+	SimMovers movers;
+	InputScript script;
+};
+
+struct BenchResult
+{
+	int nTicks, nCollisions, nLeft;
+	SimStats stats;
+	unsigned int uChecksum;
+	float fTime; // fastest of the repetitions
+};
+
+static unsigned int Checksum(unsigned int uHash, const void *pData, int nSize)
+{
+	// FNV-1a
+	for(int i = 0; i < nSize; i++)
+		uHash = (uHash ^ ((const BYTE*)pData)[i]) * 16777619;
+	return uHash;
+}
+
+static unsigned int WorldChecksum(const World &world)
+{
+	unsigned int uHash = 2166136261u;
+	uHash = Checksum(uHash, &world.fBallX, sizeof(world.fBallX));
+	uHash = Checksum(uHash, &world.fBallY, sizeof(world.fBallY));
+	uHash = Checksum(uHash, &world.fPlatX, sizeof(world.fPlatX));
+	for(int i = 0; i < world.level.GetCells(); i++)
+	{
+		BYTE type = (BYTE)world.level.Get(i);
+		uHash = Checksum(uHash, &type, 1);
+	}
+	for(int i = 0; i < world.movers.GetCount(); i++)
+	{
+		const SimMover &mover = world.movers[i];
+		uHash = Checksum(uHash, &mover.nType, sizeof(mover.nType));
+		uHash = Checksum(uHash, &mover.fX, sizeof(mover.fX));
+		uHash = Checksum(uHash, &mover.fY, sizeof(mover.fY));
+	}
+	return uHash;
+}
+
+static void RunCase(const BenchCase &bench, BenchResult &result)
+{
+	result.fTime = -1;
+	for(int rep = 0; rep < nReps; rep++)
+	{
+		World world;
+		world.level = bench.level;
+		world.movers = bench.movers;
+		SimCreate(world);
+		ScriptPlayer player;
+		player.Start(&bench.script);
+		int nTicks = 0;
+		Timer timer;
+		for(; nTicks < nMaxTicks && !world.IsCleared(); nTicks++)
+		{
+			SimInput input;
+			player.Next(world, input);
+			SimStep(world, input, fSimTick);
+		}
+		float fTime = timer.Time();
+		if( result.fTime < 0 || fTime < result.fTime )
+			result.fTime = fTime;
+
+		result.nTicks = nTicks;
+		result.nCollisions = world.nCollisions;
+		result.nLeft = world.level.GetCount() + world.movers.GetLive();
+		result.stats = world.stats;
+		result.uChecksum = WorldChecksum(world);
+	}
+}
+
+// The input the script gives in every tick of the case
+static void RecordInput(const BenchCase &bench, std::vector<SimInput> &vInput)
+{
+	vInput.clear();
+	World world;
+	world.level = bench.level;
+	world.movers = bench.movers;
+	SimCreate(world);
+	ScriptPlayer player;
+	player.Start(&bench.script);
+	while( (int)vInput.size() < nMaxTicks && !world.IsCleared() )
+	{
+		SimInput input;
+		player.Next(world, input);
+		SimStep(world, input, fSimTick);
+		vInput.push_back(input);
+	}
+}
+
+// Ends with the same world as RunCase, but every tick is stepped nDepth more times
+static void RunRollback(const BenchCase &bench, const std::vector<SimInput> &vInput, int nDepth, BenchResult &result)
+{
+	result.fTime = -1;
+	const int nTicks = (int)vInput.size();
+	for(int rep = 0; rep < nReps; rep++)
+	{
+		World world;
+		world.level = bench.level;
+		world.movers = bench.movers;
+		SimCreate(world);
+		SimSnapshots snapshots;
+		snapshots.Create(world, nDepth + 1);
+		Timer timer;
+		for(int nTick = 0; nTick < nTicks; nTick++)
+		{
+			snapshots.Save(world, nTick);
+			SimStep(world, vInput[nTick], fSimTick);
+			if( nDepth && nTick + 1 >= nDepth )
+			{
+				int nFrom = nTick + 1 - nDepth;
+				if( !snapshots.Restore(world, nFrom) )
+					Print("Snapshot of tick %d is lost\n", nFrom);
+				for(int i = nFrom; i <= nTick; i++)
+				{
+					snapshots.Save(world, i);
+					SimStep(world, vInput[i], fSimTick);
+				}
+			}
+		}
+		float fTime = timer.Time();
+		if( result.fTime < 0 || fTime < result.fTime )
+			result.fTime = fTime;
+
+		result.nTicks = nTicks;
+		result.nCollisions = world.nCollisions;
+		result.nLeft = world.level.GetCount() + world.movers.GetLive();
+		result.stats = world.stats;
+		result.uChecksum = WorldChecksum(world);
+	}
+}
+
+// The particles of Application::Update, one update per tick, and with pCase the sparks colliding with its world
+static void RunParticles(BenchResult &result, int nCount, const BenchCase *pCase)
+{
+	ZeroMemory(&result, sizeof(result));
+	result.fTime = -1;
+	std::vector<Particle> vParticles(nCount);
+	World world;
+	ParticleParams params = parDefault;
+	if( pCase )
+	{
+		world.level = pCase->level;
+		world.movers = pCase->movers;
+		SimCreate(world);
+		params.fX0 = (float)world.fBallX;
+		params.fY0 = (float)(world.fBallY + 1);
+	}
+	for(int rep = 0; rep < nReps; rep++)
+	{
+		ZeroMemory(&vParticles[0], sizeof(Particle) * vParticles.size());
+		RandGen gen;
+		ParticleCollider collider;
+		result.stats.nShapeTests = 0;
+		Timer timer;
+		for(int i = 0; i < nMaxTicks; i++)
+		{
+			ParticlesUpdate(&vParticles[0], (int)vParticles.size(), params, (float)fSimTick, gen);
+			if( pCase )
+			{
+				collider.Collide(&vParticles[0], (int)vParticles.size(), world, 0.5f);
+				result.stats.nShapeTests += collider.GetTests();
+			}
+		}
+		float fTime = timer.Time();
+		if( result.fTime < 0 || fTime < result.fTime )
+			result.fTime = fTime;
+		result.nTicks = nMaxTicks;
+		result.uChecksum = Checksum(2166136261u, &vParticles[0], (int)(sizeof(Particle) * vParticles.size()));
+	}
+}
+
+#define BATCH_CALLS 65536
+#define BATCH_TARGETS 32
+
+// One segment against BATCH_TARGETS segments, or circles with bCircles, per call at the SIMD level set
+static void RunBatch(BenchResult &result, bool bCircles)
+{
+	ZeroMemory(&result, sizeof(result));
+	result.fTime = -1;
+	// segments of about a brick in a box of a few bricks, so that a good part of them cross
+	RandGen gen(BATCH_CALLS);
+	std::vector<float> vQueries(4 * BATCH_CALLS), vTargets(4 * BATCH_TARGETS * 16);
+	for(size_t i = 0; i < vQueries.size(); i++)
+		vQueries[i] = gen.Next(-4.0f, 4.0f);
+	for(size_t i = 0; i < vTargets.size(); i++)
+		vTargets[i] = i % (4 * BATCH_TARGETS) < 3 * BATCH_TARGETS || !bCircles ? gen.Next(-4.0f, 4.0f) : gen.Next(0.1f, 1.0f);
+	for(int rep = 0; rep < nReps; rep++)
+	{
+		unsigned int uHash = 2166136261u;
+		int nHits = 0;
+		Timer timer;
+		for(int i = 0; i < BATCH_CALLS; i++)
+		{
+			const float *q = &vQueries[4 * i], *t = &vTargets[4 * BATCH_TARGETS * (i & 15)];
+			float k = -1;
+			int nFirst = -1;
+			const DWORD mask = bCircles ?
+				IntersectSegmentCircles2D(q[0], q[1], q[2], q[3], t, t + BATCH_TARGETS, t + 3 * BATCH_TARGETS, BATCH_TARGETS, &k, &nFirst) :
+				IntersectSegmentSegments2D(q[0], q[1], q[2], q[3], t, t + BATCH_TARGETS, t + 2 * BATCH_TARGETS, t + 3 * BATCH_TARGETS, BATCH_TARGETS, &k, &nFirst);
+			nHits += BitCount(mask);
+			uHash = Checksum(uHash, &mask, sizeof(mask));
+			uHash = Checksum(uHash, &k, sizeof(k));
+			uHash = Checksum(uHash, &nFirst, sizeof(nFirst));
+		}
+		float fTime = timer.Time();
+		if( result.fTime < 0 || fTime < result.fTime )
+			result.fTime = fTime;
+		result.nTicks = BATCH_CALLS;
+		result.nCollisions = nHits;
+		result.stats.nShapeTests = BATCH_CALLS * BATCH_TARGETS;
+		result.uChecksum = uHash;
+	}
+}
+
+#define SPLINE_CALLS 4096
+#define SPLINE_SAMPLES 100
+
+// DistSplineSpline2 between random pairs of splines at the SIMD level set. The distances are checked against
+// the nearest of SPLINE_SAMPLES squared points of each pair, out of the timing: left counts those missed by
+// more than a twentieth of a brick.
+static void RunSplines(BenchResult &result)
+{
+	ZeroMemory(&result, sizeof(result));
+	result.fTime = -1;
+	// splines within a box of a few bricks, so that some of them cross
+	RandGen gen(SPLINE_CALLS);
+	std::vector<Point> vSplines(8 * SPLINE_CALLS);
+	for(size_t i = 0; i < vSplines.size(); i++)
+	{
+		const float x = gen.Next(-4.0f, 4.0f), y = gen.Next(-4.0f, 4.0f);
+		vSplines[i] = Point(x, y, gen.Next(-4.0f, 4.0f));
+	}
+	std::vector<float> vDists(SPLINE_CALLS);
+	for(int rep = 0; rep < nReps; rep++)
+	{
+		unsigned int uHash = 2166136261u;
+		int nHits = 0;
+		Timer timer;
+		for(int i = 0; i < SPLINE_CALLS; i++)
+		{
+			float k1, k2;
+			vDists[i] = DistSplineSpline2(&vSplines[8 * i], &vSplines[8 * i + 4], -1, &k1, &k2);
+			if( vDists[i] <= 0.01f )
+				nHits++;
+			uHash = Checksum(uHash, &vDists[i], sizeof(vDists[i]));
+			uHash = Checksum(uHash, &k1, sizeof(k1));
+			uHash = Checksum(uHash, &k2, sizeof(k2));
+		}
+		float fTime = timer.Time();
+		if( result.fTime < 0 || fTime < result.fTime )
+			result.fTime = fTime;
+		result.nTicks = SPLINE_CALLS;
+		result.nCollisions = nHits;
+		result.stats.nShapeTests = SPLINE_CALLS;
+		result.uChecksum = uHash;
+	}
+	for(int i = 0; i < SPLINE_CALLS; i++)
+	{
+		Point c1[4], c2[4], pt2[SPLINE_SAMPLES];
+		SplineCoefs(&vSplines[8 * i], c1);
+		SplineCoefs(&vSplines[8 * i + 4], c2);
+		for(int j = 0; j < SPLINE_SAMPLES; j++)
+			pt2[j] = SplinePos(c2, (float)j / (SPLINE_SAMPLES - 1));
+		float fMinDist2 = FLT_MAX;
+		for(int j = 0; j < SPLINE_SAMPLES; j++)
+		{
+			const Point pt1 = SplinePos(c1, (float)j / (SPLINE_SAMPLES - 1));
+			for(int k = 0; k < SPLINE_SAMPLES; k++)
+				fMinDist2 = min(fMinDist2, pt1.Dist2(pt2[k]));
+		}
+		if( sqrtf(vDists[i]) > sqrtf(fMinDist2) + 0.05f )
+			result.nLeft++;
+	}
+}
+
+#define ARC_QUERIES 64
+#define ARC_STEPS 2048
+
+// SplineArc on the splines of RunSplines: the table is built and then ARC_QUERIES points are placed at even
+// distances along it, a tick for each spline. Left counts the points off by more than a thousandth of the
+// length from a polyline of ARC_STEPS steps, measured out of the timing.
+static void RunSplineArcs(BenchResult &result)
+{
+	ZeroMemory(&result, sizeof(result));
+	result.fTime = -1;
+	RandGen gen(SPLINE_CALLS);
+	std::vector<Point> vSplines(4 * SPLINE_CALLS);
+	for(size_t i = 0; i < vSplines.size(); i++)
+	{
+		const float x = gen.Next(-4.0f, 4.0f), y = gen.Next(-4.0f, 4.0f);
+		vSplines[i] = Point(x, y, gen.Next(-4.0f, 4.0f));
+	}
+	std::vector<float> vT(ARC_QUERIES * SPLINE_CALLS);
+	for(int rep = 0; rep < nReps; rep++)
+	{
+		unsigned int uHash = 2166136261u;
+		Timer timer;
+		for(int i = 0; i < SPLINE_CALLS; i++)
+		{
+			SplineArc arc(&vSplines[4 * i]);
+			for(int j = 0; j < ARC_QUERIES; j++)
+			{
+				float &t = vT[ARC_QUERIES * i + j];
+				t = arc.GetT(arc.GetLen() * j / (ARC_QUERIES - 1));
+				const Point pt = SplinePos(arc.GetCoefs(), t);
+				uHash = Checksum(uHash, &pt, sizeof(pt));
+			}
+		}
+		float fTime = timer.Time();
+		if( result.fTime < 0 || fTime < result.fTime )
+			result.fTime = fTime;
+		result.nTicks = SPLINE_CALLS;
+		result.stats.nShapeTests = SPLINE_CALLS * ARC_QUERIES;
+		result.uChecksum = uHash;
+	}
+	std::vector<double> vLens(ARC_STEPS + 1);
+	for(int i = 0; i < SPLINE_CALLS; i++)
+	{
+		Point c[4];
+		SplineCoefs(&vSplines[4 * i], c);
+		Point ptLast = c[0];
+		vLens[0] = 0;
+		for(int k = 1; k <= ARC_STEPS; k++)
+		{
+			const Point pt = SplinePos(c, (float)k / ARC_STEPS);
+			vLens[k] = vLens[k - 1] + sqrt((double)pt.Dist2(ptLast));
+			ptLast = pt;
+		}
+		for(int j = 0; j < ARC_QUERIES; j++)
+		{
+			const float t = vT[ARC_QUERIES * i + j] * ARC_STEPS;
+			const int k = min(Trunc(t), ARC_STEPS - 1);
+			const double fDist = vLens[k] + (vLens[k + 1] - vLens[k]) * (t - k);
+			if( fabs(fDist - vLens[ARC_STEPS] * j / (ARC_QUERIES - 1)) > vLens[ARC_STEPS] * 0.001 )
+				result.nLeft++;
+		}
+	}
+}
+
+#define ROTATE_TICKS 1024
+#define ROTATE_POINTS 4096
+
+// ROTATE_POINTS points turned every tick by the slerp between two rotations: with Quaternion * Point
+// (nMode 0), RotatePoints (1), or TransformPoints on their coordinates at the SIMD level set (2). The
+// checksum covers the points of the last tick.
+static void RunRotate(BenchResult &result, int nMode)
+{
+	ZeroMemory(&result, sizeof(result));
+	result.fTime = -1;
+	RandGen gen(ROTATE_POINTS);
+	std::vector<Point> vPoints(ROTATE_POINTS), vOut(ROTATE_POINTS);
+	std::vector<float> vCoords(3 * ROTATE_POINTS), vCoordsOut(3 * ROTATE_POINTS);
+	for(int i = 0; i < ROTATE_POINTS; i++)
+	{
+		const float x = gen.Next(-1.0f, 1.0f), y = gen.Next(-1.0f, 1.0f);
+		vPoints[i] = Point(x, y, gen.Next(-1.0f, 1.0f));
+		vCoords[i] = vPoints[i].x;
+		vCoords[ROTATE_POINTS + i] = vPoints[i].y;
+		vCoords[2 * ROTATE_POINTS + i] = vPoints[i].z;
+	}
+	const Quaternion q1(Point(0, 1, 0), 10), q2(Point(1, 2, 3), 170);
+	for(int rep = 0; rep < nReps; rep++)
+	{
+		Timer timer;
+		for(int i = 0; i < ROTATE_TICKS; i++)
+		{
+			const Quaternion q = Slerp(q1, q2, (float)i / (ROTATE_TICKS - 1));
+			if( nMode == 0 )
+			{
+				for(int j = 0; j < ROTATE_POINTS; j++)
+					vOut[j] = q * vPoints[j];
+			}
+			else if( nMode == 1 )
+				RotatePoints(q, &vPoints[0], &vOut[0], ROTATE_POINTS);
+			else
+			{
+				float pfMatrix[16];
+				q.GetMatrix4(pfMatrix);
+				const float *pfIn = &vCoords[0];
+				float *pfOut = &vCoordsOut[0];
+				TransformPoints(pfMatrix, pfIn, pfIn + ROTATE_POINTS, pfIn + 2 * ROTATE_POINTS,
+					pfOut, pfOut + ROTATE_POINTS, pfOut + 2 * ROTATE_POINTS, ROTATE_POINTS);
+			}
+		}
+		float fTime = timer.Time();
+		if( result.fTime < 0 || fTime < result.fTime )
+			result.fTime = fTime;
+		result.nTicks = ROTATE_TICKS;
+		result.stats.nShapeTests = ROTATE_TICKS * ROTATE_POINTS;
+		result.uChecksum = nMode == 2 ?
+			Checksum(2166136261u, &vCoordsOut[0], (int)(sizeof(float) * vCoordsOut.size())) :
+			Checksum(2166136261u, &vOut[0], (int)(sizeof(Point) * vOut.size()));
+	}
+}
+
+static bool SplinePairLess(const SplinePair &pair1, const SplinePair &pair2)
+{
+	return pair1.n1 != pair2.n1 ? pair1.n1 < pair2.n1 : pair1.n2 < pair2.n2;
+}
+
+#define TREE_SPLINES 512
+#define TREE_QUERIES 4096
+#define TREE_RADIUS 0.5f
+
+// Nearest splines to random points, or every pair of splines within TREE_RADIUS, among TREE_SPLINES short
+// splines over a level sized area, through SplineTree or by trying them all with bBrute. A tick is a query,
+// or a pass over all the pairs; shape tests are the solver calls and node tests the tree nodes tested.
+static void RunSplineTree(BenchResult &result, bool bPairs, bool bBrute)
+{
+	ZeroMemory(&result, sizeof(result));
+	result.fTime = -1;
+	RandGen gen(TREE_SPLINES);
+	std::vector<Point> vSplines(4 * TREE_SPLINES), vQueries(TREE_QUERIES);
+	for(int i = 0; i < TREE_SPLINES; i++)
+	{
+		const float x = gen.Next(0.0f, 32.0f), y = gen.Next(0.0f, 32.0f);
+		const Point ptStart(x, y, gen.Next(0.0f, 4.0f));
+		for(int j = 0; j < 4; j++)
+		{
+			const float dx = gen.Next(-1.0f, 1.0f), dy = gen.Next(-1.0f, 1.0f);
+			vSplines[4 * i + j] = ptStart + Point(dx, dy, gen.Next(-1.0f, 1.0f));
+		}
+	}
+	for(int i = 0; i < TREE_QUERIES; i++)
+	{
+		const float x = gen.Next(0.0f, 32.0f), y = gen.Next(0.0f, 32.0f);
+		vQueries[i] = Point(x, y, gen.Next(0.0f, 4.0f));
+	}
+	SplineTree tree;
+	std::vector<SplinePair> vPairs;
+	for(int rep = 0; rep < nReps; rep++)
+	{
+		unsigned int uHash = 2166136261u;
+		ZeroMemory(&result.stats, sizeof(result.stats));
+		Timer timer;
+		if( !bBrute )
+			tree.Build(&vSplines[0], TREE_SPLINES);
+		if( bPairs && bBrute )
+		{
+			vPairs.clear();
+			for(int i = 0; i < TREE_SPLINES; i++)
+				for(int j = i + 1; j < TREE_SPLINES; j++)
+				{
+					SplinePair pair = { i, j };
+					pair.fDist2 = DistSplineSpline2(&vSplines[4 * i], &vSplines[4 * j], -1, &pair.t1, &pair.t2);
+					result.stats.nShapeTests++;
+					if( pair.fDist2 <= TREE_RADIUS * TREE_RADIUS )
+						vPairs.push_back(pair);
+				}
+		}
+		else if( bPairs )
+			tree.Pairs(TREE_RADIUS, vPairs, result.stats.nNodeTests, result.stats.nShapeTests);
+		else
+		{
+			for(int i = 0; i < TREE_QUERIES; i++)
+			{
+				float fDist2 = 0, t = 0;
+				int nNearest = -1;
+				if( bBrute )
+				{
+					fDist2 = FLT_MAX;
+					for(int j = 0; j < TREE_SPLINES; j++)
+					{
+						float tj;
+						const float fDist2j = DistSplinePoint2(&vSplines[4 * j], vQueries[i], -1, &tj);
+						result.stats.nShapeTests++;
+						if( fDist2j < fDist2 )
+						{
+							fDist2 = fDist2j;
+							t = tj;
+							nNearest = j;
+						}
+					}
+				}
+				else
+					nNearest = tree.Nearest(vQueries[i], FLT_MAX, &fDist2, &t, result.stats.nNodeTests, result.stats.nShapeTests);
+				uHash = Checksum(uHash, &nNearest, sizeof(nNearest));
+				uHash = Checksum(uHash, &fDist2, sizeof(fDist2));
+				uHash = Checksum(uHash, &t, sizeof(t));
+			}
+		}
+		float fTime = timer.Time();
+		if( result.fTime < 0 || fTime < result.fTime )
+			result.fTime = fTime;
+		result.nTicks = bPairs ? 1 : TREE_QUERIES;
+		if( bPairs )
+		{
+			// in the order of the brute force
+			std::sort(vPairs.begin(), vPairs.end(), SplinePairLess);
+			for(size_t i = 0; i < vPairs.size(); i++)
+				uHash = Checksum(uHash, &vPairs[i], sizeof(vPairs[i]));
+			result.nCollisions = (int)vPairs.size();
+		}
+		result.uChecksum = uHash;
+	}
+}
+
+static bool ReadLevel(LevelGrid &level, const char *pchPath)
+{
+	File f;
+	if( !f.Open(pchPath, "rt") )
+	{
+		Print("Cannot open %s for reading!\n", pchPath);
+		return false;
+	}
+	ErrorCode err = level.Read(f);
+	if( err )
+	{
+		Print("Error reading level %s: %s\n", pchPath, err);
+		return false;
+	}
+	return true;
+}
+
+// Without a trace the platform follows the ball, launched up and to the right
+static void DefaultScript(InputScript &script)
+{
+	script.Clear();
+	script.Add(0, ScriptAim, fBallXStart + 1, 0);
+	script.Add(0, ScriptAuto);
+}
+
+// Movers spread over an empty level with about four cells for each: half slide sideways, half go round
+static void GenMovers(BenchCase &bench, int nMovers)
+{
+	const int nSize = max(LEVEL_WIDTH, Round(2 * sqrtf((float)nMovers)));
+	bench.level.Create(nSize, nSize);
+	bench.movers.Clear();
+	const Real fPitch = fBrickSize + fBrickMargin;
+	RandGen gen(nMovers);
+	for(int i = 0; i < nMovers; i++)
+	{
+		SimMover mover = SimMover();
+		mover.nType = 1 + gen.Next(MAX_TYPE - 1);
+		mover.fX = bench.level.GetX(gen.Next(nSize));
+		mover.fY = bench.level.GetY(gen.Next(nSize));
+		if( i & 1 )
+		{
+			const float fAngle = gen.Next(0.5f, 2.0f) * PI / 180;
+			mover.fCX = mover.fX - fPitch;
+			mover.fCY = mover.fY;
+			mover.fCos = cosf(fAngle);
+			mover.fSin = sinf(fAngle);
+		}
+		else
+		{
+			mover.fVX = gen.Next(0.2f, 1.0f);
+			mover.fMinX = mover.fX - 3 * fPitch;
+			mover.fMaxX = mover.fX + 3 * fPitch;
+			mover.fMinY = mover.fMaxY = mover.fY;
+		}
+		bench.movers.Add(mover);
+	}
+	char pchName[64];
+	bench.strName = FORMAT(pchName, "movers:%d", nMovers);
+}
+
+static const char *FileName(const char *pchPath)
+{
+	const char *pchName = pchPath;
+	for(const char *pch = pchPath; *pch; pch++)
+		if( *pch == '/' || *pch == '\\' )
+			pchName = pch + 1;
+	return pchName;
+}
+
+static void PrintResult(FILE *fp, const char *pchName, const BenchResult &result)
+{
+	const float fTicks = (float)max(result.nTicks, 1);
+	fprintf(fp, "%s\t%d\t%.1f\t%.3f\t%.3f\t%.3f\t%.3f\t%d\t%d\t%08x\n", pchName, result.nTicks, 1e9f * result.fTime / fTicks,
+		result.stats.nCellTests / fTicks, result.stats.nShapeTests / fTicks, result.stats.nNodeTests / fTicks, result.stats.nSubSteps / fTicks,
+		result.nCollisions, result.nLeft, result.uChecksum);
+}
+
+#define FASTMATH_VALUES (1 << 20)
+
+// One of the FastMath functions over the values, the results go into the checksum
+template<class T, class Proc>
+static void RunFastMath(BenchResult &result, const std::vector<float> &vIn, std::vector<T> &vOut, Proc proc)
+{
+	ZeroMemory(&result, sizeof(result));
+	result.fTime = -1;
+	vOut.resize(vIn.size());
+	for(int rep = 0; rep < nReps; rep++)
+	{
+		Timer timer;
+		for(size_t i = 0; i < vIn.size(); i++)
+			vOut[i] = proc(vIn[i]);
+		float fTime = timer.Time();
+		if( result.fTime < 0 || fTime < result.fTime )
+			result.fTime = fTime;
+	}
+	result.nTicks = (int)vIn.size();
+	result.uChecksum = Checksum(2166136261u, &vOut[0], (int)(sizeof(T) * vOut.size()));
+}
+
+// The zero test FastMath replaced, reading the float through an int pointer
+static inline bool IsFloatZeroPun(float x)
+{
+	return !(*(const __int32 *)&x) || (unsigned int)(*(const __int32 *)&x) == 0x80000000u;
+}
+
+static void RunFastMaths(FILE *fp)
+{
+	RandGen gen(FASTMATH_VALUES);
+	std::vector<float> vInts(FASTMATH_VALUES), vRoots(FASTMATH_VALUES), vZeros(FASTMATH_VALUES), vFloats;
+	std::vector<int> vOut;
+	std::vector<BYTE> vFlags;
+	for(int i = 0; i < FASTMATH_VALUES; i++)
+	{
+		vInts[i] = gen.Next(-1e6f, 1e6f);
+		vRoots[i] = expf(gen.Next(-10.0f, 10.0f));
+		// zeros of both signs, denormals and numbers
+		const int n = gen.Next(4);
+		vZeros[i] = n == 0 ? 0.0f : n == 1 ? -0.0f : n == 2 ? BitsFloat(gen.Next() + 1) : gen.Next(-1.0f, 1.0f);
+	}
+	BenchResult result;
+	char pchName[256];
+	RunFastMath(result, vInts, vOut, [](float x) { return TruncScalar(x); });
+	PrintResult(fp, "fastmath:trunc:scalar", result);
+	RunFastMath(result, vInts, vOut, [](float x) { return Trunc(x); });
+	PrintResult(fp, "fastmath:trunc", result);
+	RunFastMath(result, vInts, vOut, [](float x) { return RoundScalar(x); });
+	PrintResult(fp, "fastmath:round:scalar", result);
+	RunFastMath(result, vInts, vOut, [](float x) { return Round(x); });
+	PrintResult(fp, "fastmath:round", result);
+
+	// left is the largest error relative to the square root in double, per billion
+	static const char *pchRoots[] = { "scalar", "estimate", "newton" };
+	for(int i = 0; i < 3; i++)
+	{
+		if( i == 0 )
+			RunFastMath(result, vRoots, vFloats, [](float x) { return InvSqrtScalar(x); });
+		else if( i == 1 )
+			RunFastMath(result, vRoots, vFloats, [](float x) { return FastInvSqrt(x); });
+		else
+			RunFastMath(result, vRoots, vFloats, [](float x) { return FastInvSqrtNewton(x); });
+		double fMaxError = 0;
+		for(int j = 0; j < FASTMATH_VALUES; j++)
+			fMaxError = max(fMaxError, fabs(vFloats[j] * sqrt((double)vRoots[j]) - 1));
+		result.nLeft = (int)(1e9 * fMaxError + 0.5);
+		PrintResult(fp, FORMAT(pchName, "fastmath:rsqrt:%s", pchRoots[i]), result);
+	}
+
+	// collisions count the zeros
+	RunFastMath(result, vZeros, vFlags, [](float x) { return (BYTE)IsFloatZeroPun(x); });
+	for(int i = 0; i < FASTMATH_VALUES; i++)
+		result.nCollisions += vFlags[i];
+	PrintResult(fp, "fastmath:zero:pun", result);
+	RunFastMath(result, vZeros, vFlags, [](float x) { return (BYTE)IsFloatZero(x); });
+	for(int i = 0; i < FASTMATH_VALUES; i++)
+		result.nCollisions += vFlags[i];
+	PrintResult(fp, "fastmath:zero", result);
+	fflush(fp);
+}
+
+#define PATH_QUERIES 8
+#define PATH_CHANGES 64
+
+// Runs the queries of one solver, the goal distances are kept for A* to match
+static void RunPathSolver(BenchResult &result, PathProc pProc, const std::vector<float> &vCost, int nWidth, int nHeight, bool manhat,
+	const std::vector<int> &vStarts, const std::vector<int> &vGoals, std::vector<float> &vGoalDists)
+{
+	ZeroMemory(&result, sizeof(result));
+	result.fTime = -1;
+	std::vector<float> vPath(vCost.size());
+	for(int rep = 0; rep < nReps; rep++)
+	{
+		PathStats stats = {};
+		unsigned int uHash = 2166136261u;
+		Timer timer;
+		for(size_t i = 0; i < vStarts.size(); i++)
+		{
+			const int x = vStarts[i] % nWidth, y = vStarts[i] / nWidth;
+			if( pProc )
+				pProc(&vCost[0], x, y, nWidth, nHeight, &vPath[0], manhat, &stats);
+			else
+			{
+				const float fDist = PathAStar(&vCost[0], x, y, vGoals[i] % nWidth, vGoals[i] / nWidth, nWidth, nHeight, &vPath[0], false, 1.0f, &stats);
+				if( fDist != vGoalDists[i] )
+					Print("A* distance %f differs from %f of Dijkstra\n", fDist, vGoalDists[i]);
+				uHash = Checksum(uHash, &fDist, sizeof(fDist));
+				continue;
+			}
+			vGoalDists[i] = vPath[vGoals[i]];
+			uHash = Checksum(uHash, &vPath[0], (int)(sizeof(float) * vPath.size()));
+		}
+		float fTime = timer.Time();
+		if( result.fTime < 0 || fTime < result.fTime )
+			result.fTime = fTime;
+		result.nTicks = (int)vStarts.size();
+		result.stats.nCellTests = stats.nExpanded;
+		result.stats.nShapeTests = stats.nPushed;
+		result.uChecksum = uHash;
+	}
+}
+
+// PathDeltaStep as a PathProc, on the threads of pDeltaPool
+static ThreadPool *pDeltaPool = NULL;
+static void PathDeltaProc(const float *pfWayCost, int x, int y, int width, int height, float *pfWayPath, bool manhat, PathStats *pStats)
+{
+	PathDeltaStep(pfWayCost, x, y, width, height, pfWayPath, manhat, pDeltaPool, pStats);
+}
+
+// PathBfs as a PathProc, it only takes side steps
+static void PathBfsProc(const float *pfWayCost, int x, int y, int width, int height, float *pfWayPath, bool manhat, PathStats *pStats)
+{
+	ASSERT(manhat);
+	PathBfs(pfWayCost, x, y, width, height, pfWayPath, pStats);
+}
+
+// A* and PathJump between the starts and goals of a grid of unit costs
+static void RunJumps(FILE *fp, const std::vector<float> &vUnit, int nWidth, int nHeight, int nDensity,
+	const std::vector<int> &vStarts, const std::vector<int> &vGoals)
+{
+	std::vector<float> vPath(vUnit.size()), vDists(vStarts.size());
+	PathJump jump;
+	jump.Create(&vUnit[0], nWidth, nHeight);
+	char pchName[256];
+	for(int i = 0; i < 2; i++)
+	{
+		BenchResult result;
+		ZeroMemory(&result, sizeof(result));
+		result.fTime = -1;
+		for(int rep = 0; rep < nReps; rep++)
+		{
+			PathStats stats = {};
+			unsigned int uHash = 2166136261u;
+			Timer timer;
+			for(size_t q = 0; q < vStarts.size(); q++)
+			{
+				const int x = vStarts[q] % nWidth, y = vStarts[q] / nWidth, xGoal = vGoals[q] % nWidth, yGoal = vGoals[q] / nWidth;
+				float fDist;
+				if( i )
+				{
+					fDist = jump.Find(x, y, xGoal, yGoal, NULL, &stats);
+					if( fabsf(fDist - vDists[q]) > 1e-4f * vDists[q] )
+						Print("Jump point distance %f differs from %f of A*\n", fDist, vDists[q]);
+				}
+				else
+					vDists[q] = fDist = PathAStar(&vUnit[0], x, y, xGoal, yGoal, nWidth, nHeight, &vPath[0], false, 1.0f, &stats);
+				uHash = Checksum(uHash, &fDist, sizeof(fDist));
+			}
+			float fTime = timer.Time();
+			if( result.fTime < 0 || fTime < result.fTime )
+				result.fTime = fTime;
+			result.nTicks = (int)vStarts.size();
+			result.stats.nCellTests = stats.nExpanded;
+			result.stats.nShapeTests = stats.nPushed;
+			result.uChecksum = uHash;
+		}
+		PrintResult(fp, FORMAT(pchName, "path:%s:%dx%d:%d", i ? "jps" : "astar8", nWidth, nHeight, nDensity), result);
+		fflush(fp);
+	}
+
+	// a cell opened or blocked before each query, the tables are repaired by the query
+	BenchResult result;
+	ZeroMemory(&result, sizeof(result));
+	result.fTime = -1;
+	for(int rep = 0; rep < nReps; rep++)
+	{
+		PathJump changed;
+		changed.Create(&vUnit[0], nWidth, nHeight);
+		std::vector<float> vCosts = vUnit;
+		RandGen changes(vStarts[0]);
+		PathStats stats = {};
+		unsigned int uHash = 2166136261u;
+		float fTime = 0;
+		for(int i = 0; i < PATH_CHANGES; i++)
+		{
+			const int o = (changes.Next() << 15 | changes.Next()) % (int)vCosts.size(), q = i % (int)vStarts.size();
+			if( o == vStarts[q] || o == vGoals[q] )
+				continue;
+			vCosts[o] = vCosts[o] ? 0 : 1.0f;
+			Timer timer;
+			changed.SetOpen(o, vCosts[o] != 0);
+			const float fDist = changed.Find(vStarts[q] % nWidth, vStarts[q] / nWidth, vGoals[q] % nWidth, vGoals[q] / nWidth, NULL, &stats);
+			fTime += timer.Time();
+			uHash = Checksum(uHash, &fDist, sizeof(fDist));
+		}
+		if( result.fTime < 0 || fTime < result.fTime )
+			result.fTime = fTime;
+		result.nTicks = PATH_CHANGES;
+		result.stats.nCellTests = stats.nExpanded;
+		result.stats.nShapeTests = stats.nPushed;
+		result.uChecksum = uHash;
+
+		jump.Create(&vCosts[0], nWidth, nHeight);
+		if( memcmp(changed.GetJumps(), jump.GetJumps(), sizeof(int) * 8 * vCosts.size()) )
+			Print("The repaired jump tables differ from new ones\n");
+	}
+	PrintResult(fp, FORMAT(pchName, "pathjump:%dx%d:%d", nWidth, nHeight, nDensity), result);
+	fflush(fp);
+}
+
+// Wave, Dijkstra and A* on a grid of random costs from 1 to 4 with nDensity percent of the cells blocked
+static void RunPaths(FILE *fp, int nWidth, int nHeight, int nDensity)
+{
+	RandGen gen(nWidth * nHeight + nDensity);
+	std::vector<float> vCost(nWidth * nHeight);
+	std::vector<int> vOpen;
+	for(int i = 0; i < (int)vCost.size(); i++)
+	{
+		vCost[i] = gen.Next(100) < nDensity ? 0 : gen.Next(1.0f, 4.0f);
+		if( vCost[i] )
+			vOpen.push_back(i);
+	}
+	if( vOpen.empty() )
+		return;
+	std::vector<int> vStarts, vGoals;
+	for(int i = 0; i < PATH_QUERIES; i++)
+	{
+		vStarts.push_back(vOpen[(gen.Next() << 15 | gen.Next()) % vOpen.size()]);
+		vGoals.push_back(vOpen[(gen.Next() << 15 | gen.Next()) % vOpen.size()]);
+	}
+	std::vector<float> vGoalDists(PATH_QUERIES);
+	static const PathProc procs[] = { Wave, PathDijkstra, NULL };
+	static const char *pchProcs[] = { "wave", "dijkstra", "astar" };
+	for(int i = 0; i < 3; i++)
+	{
+		BenchResult result;
+		char pchName[256];
+		RunPathSolver(result, procs[i], vCost, nWidth, nHeight, false, vStarts, vGoals, vGoalDists);
+		PrintResult(fp, FORMAT(pchName, "path:%s:%dx%d:%d", pchProcs[i], nWidth, nHeight, nDensity), result);
+		fflush(fp);
+	}
+	// a single thread runs without the pool
+	for(size_t i = 0; i < vThreads.size(); i++)
+	{
+		ThreadPool pool;
+		if( vThreads[i] > 1 )
+		{
+			ErrorCode error = pool.Start(vThreads[i]);
+			if( error )
+			{
+				Print("%s\n", error);
+				continue;
+			}
+		}
+		pDeltaPool = vThreads[i] > 1 ? &pool : NULL;
+		BenchResult result;
+		char pchName[256];
+		RunPathSolver(result, PathDeltaProc, vCost, nWidth, nHeight, false, vStarts, vGoals, vGoalDists);
+		PrintResult(fp, FORMAT(pchName, "path:delta%d:%dx%d:%d", vThreads[i], nWidth, nHeight, nDensity), result);
+		fflush(fp);
+		pDeltaPool = NULL;
+	}
+
+	// the field of the first start repaired after one cell at a time is blocked or opened
+	BenchResult result;
+	ZeroMemory(&result, sizeof(result));
+	result.fTime = -1;
+	std::vector<float> vChanged;
+	for(int rep = 0; rep < nReps; rep++)
+	{
+		PathField field;
+		const int nStart = vStarts[0];
+		field.Create(&vCost[0], nStart % nWidth, nStart / nWidth, nWidth, nHeight, false);
+		RandGen changes(nStart);
+		PathStats stats = {};
+		float fTime = 0;
+		for(int i = 0; i < PATH_CHANGES; i++)
+		{
+			int o = (changes.Next() << 15 | changes.Next()) % (int)vCost.size();
+			if( o == nStart )
+				continue;
+			const float fCost = field.GetCost(o) ? 0 : changes.Next(1.0f, 4.0f);
+			Timer timer;
+			field.SetCost(o, fCost);
+			field.Update(&stats);
+			fTime += timer.Time();
+		}
+		if( result.fTime < 0 || fTime < result.fTime )
+			result.fTime = fTime;
+		result.nTicks = PATH_CHANGES;
+		result.stats.nCellTests = stats.nExpanded;
+		result.stats.nShapeTests = stats.nPushed;
+		const int nSize = (int)(sizeof(float) * vCost.size());
+		result.uChecksum = Checksum(2166136261u, field.GetDist(), nSize);
+
+		std::vector<float> vCosts(vCost.size()), vPath(vCost.size());
+		for(int o = 0; o < (int)vCost.size(); o++)
+			vCosts[o] = field.GetCost(o);
+		PathDijkstra(&vCosts[0], nStart % nWidth, nStart / nWidth, nWidth, nHeight, &vPath[0], false);
+		if( memcmp(&vPath[0], field.GetDist(), nSize) )
+			Print("The repaired path field differs from Dijkstra\n");
+	}
+	char pchName[256];
+	PrintResult(fp, FORMAT(pchName, "pathfield:%dx%d:%d", nWidth, nHeight, nDensity), result);
+	fflush(fp);
+
+	// the same queries over the clusters, built outside the timing; left is how much longer the paths are, per thousand
+	PathHierarchy hierarchy;
+	hierarchy.Create(&vCost[0], nWidth, nHeight, false);
+	ZeroMemory(&result, sizeof(result));
+	result.fTime = -1;
+	std::vector<int> vCells;
+	for(int rep = 0; rep < nReps; rep++)
+	{
+		PathStats stats = {};
+		unsigned int uHash = 2166136261u;
+		double fLength = 0, fOptimal = 0;
+		Timer timer;
+		for(size_t q = 0; q < vStarts.size(); q++)
+		{
+			const float fDist = hierarchy.Find(vStarts[q] % nWidth, vStarts[q] / nWidth, vGoals[q] % nWidth, vGoals[q] / nWidth, &vCells, &stats);
+			if( (fDist == FLT_MAX) != (vGoalDists[q] == FLT_MAX) || fDist < vGoalDists[q] * (1 - 1e-4f) )
+				Print("Hierarchical distance %f does not fit %f of Dijkstra\n", fDist, vGoalDists[q]);
+			if( fDist != FLT_MAX )
+			{
+				fLength += fDist;
+				fOptimal += vGoalDists[q];
+			}
+			uHash = Checksum(uHash, &fDist, sizeof(fDist));
+		}
+		float fTime = timer.Time();
+		if( result.fTime < 0 || fTime < result.fTime )
+			result.fTime = fTime;
+		result.nTicks = (int)vStarts.size();
+		result.nLeft = fOptimal > 0 ? (int)(1000 * (fLength / fOptimal - 1) + 0.5) : 0;
+		result.stats.nCellTests = stats.nExpanded;
+		result.stats.nShapeTests = stats.nPushed;
+		result.uChecksum = uHash;
+	}
+	PrintResult(fp, FORMAT(pchName, "pathhpa:%dx%d:%d", nWidth, nHeight, nDensity), result);
+	fflush(fp);
+
+	// building the clusters, then repairing them after one cell at a time is blocked or opened
+	ZeroMemory(&result, sizeof(result));
+	result.fTime = -1;
+	for(int rep = 0; rep < nReps; rep++)
+	{
+		Timer timer;
+		hierarchy.Create(&vCost[0], nWidth, nHeight, false);
+		const float fTime = timer.Time();
+		if( result.fTime < 0 || fTime < result.fTime )
+			result.fTime = fTime;
+		result.nTicks = 1;
+		result.nLeft = hierarchy.GetNodeCount();
+		result.uChecksum = Checksum(2166136261u, &result.nLeft, sizeof(result.nLeft));
+	}
+	PrintResult(fp, FORMAT(pchName, "pathhpa-build:%dx%d:%d", nWidth, nHeight, nDensity), result);
+	fflush(fp);
+
+	ZeroMemory(&result, sizeof(result));
+	result.fTime = -1;
+	for(int rep = 0; rep < nReps; rep++)
+	{
+		hierarchy.Create(&vCost[0], nWidth, nHeight, false);
+		RandGen changes(vStarts[0]);
+		unsigned int uHash = 2166136261u;
+		float fTime = 0;
+		for(int i = 0; i < PATH_CHANGES; i++)
+		{
+			const int o = (changes.Next() << 15 | changes.Next()) % (int)vCost.size();
+			const float fCost = hierarchy.GetCost(o) ? 0 : changes.Next(1.0f, 4.0f);
+			Timer timer;
+			hierarchy.SetCost(o, fCost);
+			const int nNodes = hierarchy.GetNodeCount();
+			fTime += timer.Time();
+			uHash = Checksum(uHash, &nNodes, sizeof(nNodes));
+		}
+		// built again from the changed costs it has to be the same
+		const float fDist = hierarchy.Find(vStarts[0] % nWidth, vStarts[0] / nWidth, vGoals[0] % nWidth, vGoals[0] / nWidth);
+		std::vector<float> vCosts(vCost.size());
+		for(int o = 0; o < (int)vCost.size(); o++)
+			vCosts[o] = hierarchy.GetCost(o);
+		PathHierarchy fresh;
+		fresh.Create(&vCosts[0], nWidth, nHeight, false);
+		if( fresh.GetNodeCount() != hierarchy.GetNodeCount() ||
+			fresh.Find(vStarts[0] % nWidth, vStarts[0] / nWidth, vGoals[0] % nWidth, vGoals[0] / nWidth) != fDist )
+			Print("The repaired hierarchy differs from a new one\n");
+		if( result.fTime < 0 || fTime < result.fTime )
+			result.fTime = fTime;
+		result.nTicks = PATH_CHANGES;
+		result.nLeft = hierarchy.GetNodeCount();
+		result.uChecksum = Checksum(uHash, &fDist, sizeof(fDist));
+	}
+	PrintResult(fp, FORMAT(pchName, "pathhpa-repair:%dx%d:%d", nWidth, nHeight, nDensity), result);
+	fflush(fp);
+
+	// the same blocked cells with the open ones all costing 1, like the bricks of a level
+	std::vector<float> vUnit(vCost.size());
+	for(size_t i = 0; i < vCost.size(); i++)
+		vUnit[i] = vCost[i] ? 1.0f : 0;
+	static const PathProc unitProcs[] = { Wave, PathBfsProc };
+	static const char *pchUnitProcs[] = { "wave4", "bfs" };
+	for(int i = 0; i < 2; i++)
+	{
+		RunPathSolver(result, unitProcs[i], vUnit, nWidth, nHeight, true, vStarts, vGoals, vGoalDists);
+		PrintResult(fp, FORMAT(pchName, "path:%s:%dx%d:%d", pchUnitProcs[i], nWidth, nHeight, nDensity), result);
+		fflush(fp);
+	}
+	RunJumps(fp, vUnit, nWidth, nHeight, nDensity, vStarts, vGoals);
+}
+
+#define FLOW_AGENTS 32
+#define FLOW_TARGETS 4
+#define FLOW_TICKS 12
+
+// Agents stepping down the fields to their targets, shared or solved by each agent.
+// Solving for each agent takes long on big levels and is only there to compare with, it runs once.
+static void RunFlow(BenchResult &result, const LevelGrid &start, bool bShared)
+{
+	ZeroMemory(&result, sizeof(result));
+	result.fTime = -1;
+	const int nWidth = start.GetWidth(), nHeight = start.GetHeight(), nCells = start.GetCells();
+	std::vector<float> vCost(nCells), vDist(nCells);
+	for(int rep = 0; rep < (bShared ? nReps : 1); rep++)
+	{
+		LevelGrid level = start;
+		RandGen gen(nCells);
+		std::vector<int> vOpen;
+		for(int o = 0; o < nCells; o++)
+			if( !level.Get(o) )
+				vOpen.push_back(o);
+		if( vOpen.empty() )
+			return;
+		int targets[FLOW_TARGETS], agents[FLOW_AGENTS];
+		for(int i = 0; i < FLOW_TARGETS; i++)
+			targets[i] = vOpen[(gen.Next() << 15 | gen.Next()) % vOpen.size()];
+		for(int i = 0; i < FLOW_AGENTS; i++)
+			agents[i] = vOpen[(gen.Next() << 15 | gen.Next()) % vOpen.size()];
+		FlowFields fields;
+		unsigned int uHash = 2166136261u;
+		int nBrick = -1;
+		Timer timer;
+		for(int tick = 0; tick < FLOW_TICKS; tick++)
+		{
+			// a brick for two ticks out of four, the layout without it comes back
+			if( tick % 4 == 0 )
+				level.Set(nBrick = vOpen[(gen.Next() << 15 | gen.Next()) % vOpen.size()], 1);
+			else if( tick % 4 == 2 )
+				level.Set(nBrick, 0);
+			for(int i = 0; i < FLOW_AGENTS; i++)
+			{
+				const int nTarget = targets[i % FLOW_TARGETS];
+				int nNext;
+				if( bShared )
+					nNext = fields.Get(level, nTarget, true).Next(agents[i]);
+				else
+				{
+					std::fill(vCost.begin(), vCost.end(), 1.0f);
+					level.ForEach([&](int x, int y, int) {
+						vCost[y * nWidth + x] = 0;
+					});
+					std::fill(vDist.begin(), vDist.end(), FLT_MAX);
+					PathSolve(&vCost[0], nTarget % nWidth, nTarget / nWidth, nWidth, nHeight, &vDist[0], true);
+					const int nDir = vDist[agents[i]] == FLT_MAX ? FLOW_NONE : FlowStep(&vDist[0], agents[i], nWidth, nHeight, true);
+					nNext = nDir == FLOW_NONE ? -1 : agents[i] + pathDirections[nDir][1] * nWidth + pathDirections[nDir][0];
+					result.stats.nCellTests++;
+				}
+				if( nNext >= 0 )
+					agents[i] = nNext;
+			}
+			uHash = Checksum(uHash, agents, sizeof(agents));
+		}
+		float fTime = timer.Time();
+		if( result.fTime < 0 || fTime < result.fTime )
+			result.fTime = fTime;
+		result.nTicks = FLOW_TICKS;
+		if( bShared )
+		{
+			result.stats.nCellTests = fields.GetSolves();
+			result.stats.nShapeTests = fields.GetHits();
+		}
+		result.uChecksum = uHash;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<const char*> vLevelPaths;
+	std::vector<std::string> vGens;
+	for(int i = 1; i < argc; i++)
+	{
+		const char *arg = argv[i], *next = i + 1 < argc ? argv[i + 1] : "";
+		if( !strcmp(arg, "-reps") )
+			nReps = max(atoi(next), 1), i++;
+		else if( !strcmp(arg, "-ticks") )
+			nMaxTicks = atoi(next), i++;
+		else if( !strcmp(arg, "-traces") )
+			pchTraces = next, i++;
+		else if( !strcmp(arg, "-gen") )
+			vGens.push_back(next), i++;
+		else if( !strcmp(arg, "-movers") )
+			vMovers.push_back(max(atoi(next), 1)), i++;
+		else if( !strcmp(arg, "-particles") )
+			vParticles.push_back(max(atoi(next), 1)), i++;
+		else if( !strcmp(arg, "-paths") )
+			vPaths.push_back(next), i++;
+		else if( !strcmp(arg, "-threads") )
+			vThreads.push_back(max(atoi(next), 1)), i++;
+		else if( !strcmp(arg, "-rollback") )
+			vDepths.push_back(max(atoi(next), 0)), i++;
+		else if( !strcmp(arg, "-o") )
+			pchOutput = next, i++;
+		else if( !strcmp(arg, "-profile") )
+			pchProfile = next, i++;
+		else if( arg[0] == '-' )
+		{
+			Print("Unknown option %s\n", arg);
+			return -1;
+		}
+		else
+			vLevelPaths.push_back(arg);
+	}
+	if( vGens.empty() )
+	{
+		vGens.push_back("20x10:100");
+		vGens.push_back("100x50:100");
+		vGens.push_back("1000x1000:5");
+	}
+	if( vMovers.empty() )
+	{
+		vMovers.push_back(100);
+		vMovers.push_back(10000);
+	}
+	if( vParticles.empty() )
+	{
+		vParticles.push_back(MAX_PARTICLES);
+		vParticles.push_back(100000);
+	}
+	if( vPaths.empty() )
+	{
+		vPaths.push_back("256x256:20");
+		vPaths.push_back("1024x1024:20");
+	}
+	if( vThreads.empty() )
+	{
+		for(int nThreads = 1; nThreads <= min(ThreadPool::GetProcessors(), 64); nThreads *= 2)
+			vThreads.push_back(nThreads);
+	}
+	if( vDepths.empty() )
+	{
+		vDepths.push_back(0);
+		vDepths.push_back(1);
+		vDepths.push_back(4);
+		vDepths.push_back(16);
+	}
+
+	std::vector<BenchCase> vCases(vLevelPaths.size() + vGens.size() + vMovers.size());
+	for(size_t i = 0; i < vLevelPaths.size(); i++)
+	{
+		BenchCase &bench = vCases[i];
+		bench.strName = FileName(vLevelPaths[i]);
+		if( !ReadLevel(bench.level, vLevelPaths[i]) )
+			return -1;
+		char pchTrace[MAX_PATH];
+		File f;
+		if( f.Open(FORMAT(pchTrace, "%s/%s", pchTraces, bench.strName.c_str()), "rt") )
+		{
+			ErrorCode err = bench.script.Read(f);
+			if( err )
+			{
+				Print("Error reading trace %s: %s\n", pchTrace, err);
+				return -1;
+			}
+			bench.strName += "+trace";
+		}
+		else
+			DefaultScript(bench.script);
+	}
+	for(size_t i = 0; i < vGens.size(); i++)
+	{
+		BenchCase &bench = vCases[vLevelPaths.size() + i];
+		int nWidth, nHeight, nDensity;
+		if( sscanf(vGens[i].c_str(), "%dx%d:%d", &nWidth, &nHeight, &nDensity) != 3 || nWidth <= 0 || nHeight <= 0 )
+		{
+			Print("Invalid level generator %s, expected WxH:density\n", vGens[i].c_str());
+			return -1;
+		}
+		bench.strName = "gen:" + vGens[i];
+		bench.level.Generate(nWidth, nHeight, nDensity, 1);
+		DefaultScript(bench.script);
+	}
+	for(size_t i = 0; i < vMovers.size(); i++)
+	{
+		BenchCase &bench = vCases[vLevelPaths.size() + vGens.size() + i];
+		GenMovers(bench, vMovers[i]);
+		DefaultScript(bench.script);
+	}
+
+	File out;
+	if( pchOutput && !out.Open(pchOutput, "wt") )
+	{
+		Print("Cannot open %s for writing!\n", pchOutput);
+		return -1;
+	}
+	FILE *fp = pchOutput ? (FILE*)out : stdout;
+	File profile;
+	if( pchProfile )
+	{
+#ifndef SIM_PROFILE
+		Print("-profile needs a build with SIM_PROFILE\n");
+		return -1;
+#endif
+		if( !profile.Open(pchProfile, "wt") )
+		{
+			Print("Cannot open %s for writing!\n", pchProfile);
+			return -1;
+		}
+		profiler.Enable(true);
+	}
+#ifdef SIM_FIXED_POINT
+	fprintf(fp, "# simulation: fixed, reps: %d, ticks: %d\n", nReps, nMaxTicks);
+#else
+	fprintf(fp, "# simulation: float, reps: %d, ticks: %d\n", nReps, nMaxTicks);
+#endif
+	fprintf(fp, "case\tticks\tns/tick\tcell tests/tick\tshape tests/tick\tnode tests/tick\tsubsteps/tick\tcollisions\tleft\tchecksum\n");
+	for(size_t i = 0; i < vCases.size(); i++)
+	{
+		BenchResult result;
+		profiler.Clear();
+		RunCase(vCases[i], result);
+		PrintResult(fp, vCases[i].strName.c_str(), result);
+		fflush(fp);
+		if( pchProfile )
+		{
+			fprintf(profile, "# %s\n", vCases[i].strName.c_str());
+			profiler.Dump(profile);
+		}
+	}
+	std::vector<SimInput> vInput;
+	RecordInput(vCases[0], vInput);
+	for(size_t i = 0; i < vDepths.size(); i++)
+	{
+		BenchResult result;
+		RunRollback(vCases[0], vInput, vDepths[i], result);
+		char pchName[256];
+		PrintResult(fp, FORMAT(pchName, "rollback:%d:%s", vDepths[i], vCases[0].strName.c_str()), result);
+		fflush(fp);
+	}
+	for(size_t i = 0; i < vParticles.size(); i++)
+	{
+		BenchResult result;
+		char pchName[256];
+		RunParticles(result, vParticles[i], NULL);
+		PrintResult(fp, FORMAT(pchName, "particles:%d", vParticles[i]), result);
+		RunParticles(result, vParticles[i], &vCases[0]);
+		PrintResult(fp, FORMAT(pchName, "sparks:%d:%s", vParticles[i], vCases[0].strName.c_str()), result);
+		fflush(fp);
+	}
+	RunFastMaths(fp);
+	static const char *pchSimd[] = { "scalar", "sse", "avx" };
+	const int nSimd = GetMathSimd();
+	for(int i = 0; i < 2; i++)
+	{
+		for(int nLevel = MATH_SIMD_SCALAR; nLevel <= nSimd; nLevel++)
+		{
+			BenchResult result;
+			char pchName[256];
+			SetMathSimd(nLevel);
+			RunBatch(result, i != 0);
+			PrintResult(fp, FORMAT(pchName, "batch:%s:%s", i ? "circles" : "segments", pchSimd[nLevel]), result);
+			fflush(fp);
+		}
+	}
+	for(int nLevel = MATH_SIMD_SCALAR; nLevel <= nSimd; nLevel++)
+	{
+		BenchResult result;
+		char pchName[256];
+		SetMathSimd(nLevel);
+		RunSplines(result);
+		PrintResult(fp, FORMAT(pchName, "spline:%s", pchSimd[nLevel]), result);
+		fflush(fp);
+	}
+	for(int nLevel = -2; nLevel <= nSimd; nLevel++)
+	{
+		BenchResult result;
+		char pchName[256];
+		if( nLevel >= MATH_SIMD_SCALAR )
+			SetMathSimd(nLevel);
+		RunRotate(result, nLevel < 0 ? nLevel + 2 : 2);
+		PrintResult(fp, FORMAT(pchName, "rotate:%s", nLevel == -2 ? "quaternion" : nLevel == -1 ? "points" : pchSimd[nLevel]), result);
+		fflush(fp);
+	}
+	SetMathSimd(nSimd);
+	{
+		BenchResult result;
+		RunSplineArcs(result);
+		PrintResult(fp, "splinearc", result);
+		fflush(fp);
+	}
+	for(int i = 0; i < 4; i++)
+	{
+		BenchResult result;
+		char pchName[256];
+		RunSplineTree(result, i >= 2, (i & 1) != 0);
+		PrintResult(fp, FORMAT(pchName, "%s:%s", i & 1 ? "splinebrute" : "splinetree", i >= 2 ? "pairs" : "nearest"), result);
+		fflush(fp);
+	}
+	for(size_t i = 0; i < vPaths.size(); i++)
+	{
+		int nWidth, nHeight, nDensity;
+		if( sscanf(vPaths[i].c_str(), "%dx%d:%d", &nWidth, &nHeight, &nDensity) != 3 || nWidth <= 0 || nHeight <= 0 )
+		{
+			Print("Invalid path grid %s, expected WxH:density\n", vPaths[i].c_str());
+			return -1;
+		}
+		RunPaths(fp, nWidth, nHeight, nDensity);
+
+		LevelGrid level;
+		level.Generate(nWidth, nHeight, nDensity, nWidth * nHeight + nDensity);
+		for(int j = 0; j < 2; j++)
+		{
+			BenchResult result;
+			char pchName[256];
+			RunFlow(result, level, !j);
+			PrintResult(fp, FORMAT(pchName, "%s:%dx%d:%d", j ? "flow-solo" : "flow", nWidth, nHeight, nDensity), result);
+			fflush(fp);
+		}
+	}
+	return 0;
+}
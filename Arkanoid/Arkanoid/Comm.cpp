@@ -1,4 +1,4 @@
-#include "comm.h"
+#include "Comm.h"
 
 #pragma comment(lib, "ws2_32.lib" )
 
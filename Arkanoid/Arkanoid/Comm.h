@@ -1,7 +1,7 @@
 #ifndef __COMM_H__
 #define __COMM_H__
 
-#include "utils.h"
+#include "Utils.h"
 
 #define IP_BROADCAST "255.255.255.255"
 #define IP_LOCALHOST "127.0.0.1"
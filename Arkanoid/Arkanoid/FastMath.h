@@ -0,0 +1,132 @@
+#ifndef __FASTMATH_H_
+#define __FASTMATH_H_
+
+#include <string.h>
+#include <math.h>
+
+// Float to int, reciprocal square root and float classes with the SSE instructions on x86 and x64,
+// NEON on ARM and plain C++ elsewhere. The simulation checksums depend on Trunc, Round and FastInvSqrt,
+// so on x86 they give what cvttss2si and rsqrtss give, as the inline assembly did.
+// FAST_MATH_SSE also selects the SSE and AVX code of the other files, which all have plain C++ versions.
+// Building with FAST_MATH_PORTABLE leaves out the intrinsics on any processor, to try the plain C++ ones.
+#if defined(FAST_MATH_PORTABLE)
+#elif defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define FAST_MATH_SSE
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <xmmintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM) || defined(_M_ARM64)
+#define FAST_MATH_NEON
+#include <arm_neon.h>
+#endif
+
+// Visual Studio 2013 has no constexpr
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define FAST_CONSTEXPR inline
+#else
+#define FAST_CONSTEXPR constexpr
+#endif
+
+// SCALAR VERSIONS, usable in constant expressions where the compiler has constexpr:
+// x must be in the range of int
+FAST_CONSTEXPR int TruncScalar(float x)
+{
+	return (int)x;
+}
+// Halves away from zero
+FAST_CONSTEXPR int RoundScalar(float x)
+{
+	return TruncScalar(x < 0.0f ? (x - 0.5f) : (x + 0.5f));
+}
+inline float InvSqrtScalar(float x)
+{
+	return 1.0f / sqrtf(x);
+}
+
+// FLOAT TO INT OPERATIONS:
+// Out of the range of int x gives 0x80000000 on x86
+inline int Trunc(float x)
+{
+#if defined(FAST_MATH_SSE)
+	return _mm_cvtt_ss2si(_mm_set_ss(x));
+#elif defined(FAST_MATH_NEON)
+	return vget_lane_s32(vcvt_s32_f32(vdup_n_f32(x)), 0);
+#else
+	return TruncScalar(x);
+#endif
+}
+inline int Round(float x)
+{
+	return Trunc(x < 0.0f ? (x - 0.5f) : (x + 0.5f));
+}
+
+// RECIPROCAL SQUARE ROOT:
+// The estimate of the processor, 12 bits on x86 and 8 on ARM
+inline float FastInvSqrt(float x)
+{
+#if defined(FAST_MATH_SSE)
+	return _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+#elif defined(FAST_MATH_NEON)
+	return vget_lane_f32(vrsqrte_f32(vdup_n_f32(x)), 0);
+#else
+	return InvSqrtScalar(x);
+#endif
+}
+// The estimate refined by a Newton step, which about doubles its bits
+inline float FastInvSqrtNewton(float x)
+{
+#if defined(FAST_MATH_SSE)
+	const float y = FastInvSqrt(x);
+	return y * (1.5f - 0.5f * x * y * y);
+#elif defined(FAST_MATH_NEON)
+	const float32x2_t v = vdup_n_f32(x), y = vrsqrte_f32(v);
+	return vget_lane_f32(vmul_f32(y, vrsqrts_f32(vmul_f32(v, y), y)), 0);
+#else
+	return InvSqrtScalar(x);
+#endif
+}
+
+// FLOAT CLASSES:
+// The bits of x without breaking strict aliasing, compilers turn the copy into a move
+inline unsigned int FloatBits(float x)
+{
+	unsigned int bits;
+	memcpy(&bits, &x, sizeof(bits));
+	return bits;
+}
+inline float BitsFloat(unsigned int bits)
+{
+	float x;
+	memcpy(&x, &bits, sizeof(x));
+	return x;
+}
+// +0 or -0, and not a denormal even where the processor flushes them
+inline bool IsFloatZero(float x)
+{
+	return !(FloatBits(x) << 1);
+}
+inline bool IsFloatZero(const float *x)
+{
+	return IsFloatZero(*x);
+}
+inline bool IsFloatNan(float x)
+{
+	return (FloatBits(x) << 1) > 0xff000000u;
+}
+inline bool IsFloatInf(float x)
+{
+	return (FloatBits(x) << 1) == 0xff000000u;
+}
+inline bool IsFloatFinite(float x)
+{
+	return (FloatBits(x) << 1) < 0xff000000u;
+}
+inline bool IsFloatDenormal(float x)
+{
+	const unsigned int bits = FloatBits(x) << 1;
+	return bits && bits < 0x01000000u;
+}
+
+#endif __FASTMATH_H_
@@ -0,0 +1,111 @@
+#ifndef __FIXED_H_
+#define __FIXED_H_
+
+// 32.32 fixed point number.
+// Every operation is done with integers, so the results are bit-identical on all CPUs and compilers.
+// Define SIM_FIXED_POINT to run the simulation (Real) in fixed point, e.g. for lockstep multiplayer.
+
+#define FIXED_SHIFT 32
+#define FIXED_ONE ((__int64)1 << FIXED_SHIFT)
+#define FIXED_MAX 0x7fffffffffffffffLL
+
+// unsigned 32.32 product, rounded down
+inline unsigned __int64 FixedMulU(unsigned __int64 a, unsigned __int64 b)
+{
+	unsigned __int64
+		a1 = a >> 32, a0 = a & 0xffffffff,
+		b1 = b >> 32, b0 = b & 0xffffffff;
+	return ((a1 * b1) << 32) + a1 * b0 + a0 * b1 + ((a0 * b0) >> 32);
+}
+
+inline __int64 FixedMul(__int64 a, __int64 b)
+{
+	bool neg = (a < 0) != (b < 0);
+	unsigned __int64 r = FixedMulU(
+		a < 0 ? 0 - (unsigned __int64)a : (unsigned __int64)a,
+		b < 0 ? 0 - (unsigned __int64)b : (unsigned __int64)b);
+	return neg ? -(__int64)r : (__int64)r;
+}
+
+inline __int64 FixedDiv(__int64 a, __int64 b)
+{
+	bool neg = (a < 0) != (b < 0);
+	if( !b )
+		return neg ? -FIXED_MAX : FIXED_MAX; // saturate
+	unsigned __int64
+		ua = a < 0 ? 0 - (unsigned __int64)a : (unsigned __int64)a,
+		ub = b < 0 ? 0 - (unsigned __int64)b : (unsigned __int64)b,
+		q = ua / ub, r = ua % ub;
+	// long division for the fractional bits
+	for(int i = 0; i < FIXED_SHIFT; i++)
+	{
+		r <<= 1;
+		q <<= 1;
+		if( r >= ub )
+		{
+			r -= ub;
+			q |= 1;
+		}
+	}
+	return neg ? -(__int64)q : (__int64)q;
+}
+
+struct Fixed
+{
+	__int64 v;
+	Fixed():v(0){}
+	Fixed(int n):v(n * FIXED_ONE){}
+	Fixed(float f):v((__int64)((double)f * FIXED_ONE)){}
+	Fixed(double d):v((__int64)(d * FIXED_ONE)){}
+	static Fixed Raw(__int64 v) { Fixed f; f.v = v; return f; }
+	explicit operator float() const { return (float)((double)v / FIXED_ONE); }
+	explicit operator double() const { return (double)v / FIXED_ONE; }
+	Fixed operator -() const { return Raw(-v); }
+	Fixed& operator +=(Fixed f) { v += f.v; return *this; }
+	Fixed& operator -=(Fixed f) { v -= f.v; return *this; }
+	Fixed& operator *=(Fixed f) { v = FixedMul(v, f.v); return *this; }
+	Fixed& operator /=(Fixed f) { v = FixedDiv(v, f.v); return *this; }
+};
+
+inline Fixed operator +(Fixed a, Fixed b) { return Fixed::Raw(a.v + b.v); }
+inline Fixed operator -(Fixed a, Fixed b) { return Fixed::Raw(a.v - b.v); }
+inline Fixed operator *(Fixed a, Fixed b) { return Fixed::Raw(FixedMul(a.v, b.v)); }
+inline Fixed operator /(Fixed a, Fixed b) { return Fixed::Raw(FixedDiv(a.v, b.v)); }
+inline bool operator ==(Fixed a, Fixed b) { return a.v == b.v; }
+inline bool operator !=(Fixed a, Fixed b) { return a.v != b.v; }
+inline bool operator <(Fixed a, Fixed b) { return a.v < b.v; }
+inline bool operator <=(Fixed a, Fixed b) { return a.v <= b.v; }
+inline bool operator >(Fixed a, Fixed b) { return a.v > b.v; }
+inline bool operator >=(Fixed a, Fixed b) { return a.v >= b.v; }
+
+inline Fixed Abs(Fixed x) { return x.v < 0 ? -x : x; }
+inline int Floor(Fixed x) { return (int)(x.v >> FIXED_SHIFT); }
+
+inline Fixed Sqrt(Fixed x)
+{
+	if( x.v <= 0 )
+		return Fixed();
+	// bit by bit, the largest r with r*r <= x
+	unsigned __int64 r = 0;
+	for(int b = 47; b >= 0; b--)
+	{
+		unsigned __int64 t = r | ((unsigned __int64)1 << b);
+		if( FixedMulU(t, t) <= (unsigned __int64)x.v )
+			r = t;
+	}
+	return Fixed::Raw((__int64)r);
+}
+
+inline Fixed InvSqrt(Fixed x)
+{
+	return 1 / Sqrt(x);
+}
+
+// Simulation number type
+#ifdef SIM_FIXED_POINT
+typedef Fixed Real;
+#else
+typedef float Real;
+#endif
+
+#endif __FIXED_H_
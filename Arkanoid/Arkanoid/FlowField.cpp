@@ -0,0 +1,119 @@
+#include "FlowField.h"
+
+int FlowStep(const float *pfDist, int o, int width, int height, bool manhat)
+{
+	const int x1 = o % width, y1 = o / width;
+	const int dircount = manhat ? 4 : 8;
+	float fMinDist = pfDist[o];
+	int nDir = FLOW_NONE;
+	for( int j = 0; j < dircount; j++ )
+	{
+		int dx = pathDirections[j][0], dy = pathDirections[j][1];
+		if( (y1 == 0 && dy < 0) || (y1 == height-1 && dy > 0) || (x1 == 0 && dx < 0) || (x1 == width-1 && dx > 0) )
+			continue;
+		const float fDist = pfDist[o + dy * width + dx];
+		if( fDist < fMinDist )
+		{
+			fMinDist = fDist;
+			nDir = j;
+		}
+	}
+	return nDir;
+}
+
+bool FlowFields::Key::operator<(const Key &key) const
+{
+	if( uHash != key.uHash )
+		return uHash < key.uHash;
+	if( nTarget != key.nTarget )
+		return nTarget < key.nTarget;
+	if( nWidth != key.nWidth )
+		return nWidth < key.nWidth;
+	if( nHeight != key.nHeight )
+		return nHeight < key.nHeight;
+	return bManhat < key.bManhat;
+}
+
+FlowFields::FlowFields(size_t uMaxBytes):m_uMaxBytes(uMaxBytes), m_uBytes(0), m_nHits(0), m_nSolves(0)
+{
+}
+
+FlowFields::Key FlowFields::GetKey(const FlowField &field)
+{
+	const Key key = { field.uHash, field.nWidth, field.nHeight, field.nTarget, field.bManhat };
+	return key;
+}
+
+void FlowFields::Trim(size_t uNeed, FieldList &spare)
+{
+	while( !m_fields.empty() && m_uBytes + uNeed > m_uMaxBytes )
+	{
+		m_uBytes -= m_fields.back().GetBytes();
+		m_index.erase(GetKey(m_fields.back()));
+		spare.clear();
+		spare.splice(spare.begin(), m_fields, --m_fields.end());
+	}
+}
+
+const FlowField &FlowFields::Get(const LevelGrid &level, int nTarget, bool manhat)
+{
+	ASSERT(nTarget >= 0 && nTarget < level.GetCells());
+	const int nWidth = level.GetWidth(), nHeight = level.GetHeight(), nCells = level.GetCells();
+	const Key key = { level.GetHash(), nWidth, nHeight, nTarget, manhat };
+	std::map<Key, FieldList::iterator>::iterator it = m_index.find(key);
+	if( it != m_index.end() )
+	{
+		m_nHits++;
+		m_fields.splice(m_fields.begin(), m_fields, it->second);
+		return *it->second;
+	}
+
+	// a field dropped for the room keeps its buffers for the new one, unless they are far larger than needed
+	m_nSolves++;
+	FieldList spare;
+	Trim(sizeof(FlowField) + nCells * (sizeof(float) + sizeof(BYTE)), spare);
+	if( spare.empty() )
+		spare.push_back(FlowField());
+	else if( spare.front().vDist.capacity() > 2 * (size_t)nCells )
+	{
+		std::vector<float>().swap(spare.front().vDist);
+		std::vector<BYTE>().swap(spare.front().vDir);
+	}
+	m_fields.splice(m_fields.begin(), spare);
+	FlowField &field = m_fields.front();
+	field.uHash = key.uHash;
+	field.nWidth = nWidth;
+	field.nHeight = nHeight;
+	field.nTarget = nTarget;
+	field.bManhat = manhat;
+
+	m_vCost.assign(nCells, 1.0f);
+	std::vector<float> &vCost = m_vCost;
+	level.ForEach([&](int x, int y, int) {
+		vCost[y * nWidth + x] = 0;
+	});
+	// the solvers leave the distances alone when the target is a brick
+	field.vDist.assign(nCells, FLT_MAX);
+	PathSolve(&m_vCost[0], nTarget % nWidth, nTarget / nWidth, nWidth, nHeight, &field.vDist[0], manhat);
+	field.vDir.resize(nCells);
+	for(int o = 0; o < nCells; o++)
+		field.vDir[o] = field.vDist[o] == FLT_MAX ? FLOW_NONE : (BYTE)FlowStep(&field.vDist[0], o, nWidth, nHeight, manhat);
+
+	m_index[key] = m_fields.begin();
+	m_uBytes += field.GetBytes();
+	return field;
+}
+
+void FlowFields::SetMaxBytes(size_t uMaxBytes)
+{
+	m_uMaxBytes = uMaxBytes;
+	FieldList spare;
+	Trim(0, spare);
+}
+
+void FlowFields::Clear()
+{
+	m_fields.clear();
+	m_index.clear();
+	m_uBytes = 0;
+}
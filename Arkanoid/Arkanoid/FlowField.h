@@ -0,0 +1,81 @@
+#ifndef __FLOWFIELD_H_
+#define __FLOWFIELD_H_
+
+#include <vector>
+#include <list>
+#include <map>
+
+#include "Utils.h"
+#include "Level.h"
+#include "Path.h"
+
+// bytes the kept fields may take by default, a 1024x1024 field takes 5M
+#define FLOW_CACHE_BYTES (32 << 20)
+// direction of the cells with nowhere to go: the target and the cells that cannot reach it
+#define FLOW_NONE 0xff
+
+// Index in pathDirections of the step from cell o to its nearest neighbour when that is nearer than o itself,
+// the first of them on ties, FLOW_NONE otherwise
+int FlowStep(const float *pfDist, int o, int width, int height, bool manhat);
+
+// Distances to a target cell and the step to take from every cell, for one layout of the bricks of a level.
+// Bricks block and every other cell costs 1, as for the waypoints of the test mode.
+struct FlowField
+{
+	unsigned __int64 uHash; // LevelGrid::GetHash of the layout
+	int nWidth, nHeight, nTarget;
+	bool bManhat;
+	std::vector<float> vDist; // FLT_MAX for the cells that cannot reach the target
+	std::vector<BYTE> vDir;   // FlowStep of every cell
+
+	// The cell one step nearer the target, -1 at the target and for the cells that cannot reach it
+	int Next(int o) const
+	{
+		const int dir = vDir[o];
+		return dir == FLOW_NONE ? -1 : o + pathDirections[dir][1] * nWidth + pathDirections[dir][0];
+	}
+	// what the buffers hold, a reused field may have more room than its cells
+	size_t GetBytes() const { return sizeof(*this) + vDist.capacity() * sizeof(float) + vDir.capacity(); }
+};
+
+// Flow fields shared by all the agents heading for a cell: bots, homing power-ups, path overlays.
+// A field is solved once for each level hash, target and manhat and kept in a least recently used cache
+// bounded in bytes, so N agents going to the same cell cost one solve. Since the key is the layout and not
+// the level version, the layouts a rollback comes back to find their fields again.
+class FlowFields
+{
+	struct Key
+	{
+		unsigned __int64 uHash;
+		int nWidth, nHeight, nTarget;
+		bool bManhat;
+		bool operator<(const Key &key) const;
+	};
+	typedef std::list<FlowField> FieldList;
+	FieldList m_fields; // most recently used first
+	std::map<Key, FieldList::iterator> m_index;
+	std::vector<float> m_vCost;
+	size_t m_uMaxBytes, m_uBytes;
+	int m_nHits, m_nSolves;
+
+	static Key GetKey(const FlowField &field);
+	// Drops the least recently used fields until uNeed more bytes fit, the last one dropped is kept in spare
+	void Trim(size_t uNeed, FieldList &spare);
+public:
+	FlowFields(size_t uMaxBytes = FLOW_CACHE_BYTES);
+
+	// The field to cell nTarget for the bricks of the level as they are now, solved unless kept.
+	// A field got stays valid until it is dropped to make room for a solve or the fields are cleared.
+	// The newest field is kept even when it alone takes more than the bound.
+	const FlowField &Get(const LevelGrid &level, int nTarget, bool manhat);
+	void SetMaxBytes(size_t uMaxBytes);
+	void Clear();
+
+	int GetCount() const { return (int)m_fields.size(); }
+	size_t GetBytes() const { return m_uBytes; }
+	// Gets answered with a kept field, and the others
+	int GetHits() const { return m_nHits; }
+	int GetSolves() const { return m_nSolves; }
+};
+
+#endif __FLOWFIELD_H_
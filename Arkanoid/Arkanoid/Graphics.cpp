@@ -1,4 +1,4 @@
-#include "graphics.h"
+#include "Graphics.h"
 #include <algorithm>
 
 #pragma comment( lib, "opengl32.lib" )				// Search For OpenGL32.lib While Linking
@@ -94,20 +94,12 @@ void Image::FlipC()
 		return;
 	const int m=m_uComps;
 	const int s=m_uWidth*m_uHeight;
-	const void *d=GetDataPtr();
-	__asm							// Assembler Code To Follow
+	BYTE *p=(BYTE*)GetDataPtr();
+	for(int i = 0; i < s; i++, p += m)
 	{
-		mov ecx, s					// Counter Set To Dimensions Of Our Memory Block
-		mov ebx, d					// Points ebx To Our Data (b)
-		label:						// Label Used For Looping
-		mov al,[ebx+0]				// Loads Value At ebx Into al
-		mov ah,[ebx+2]				// Loads Value At ebx+2 Into ah
-		mov [ebx+2],al				// Stores Value In al At ebx+2
-		mov [ebx+0],ah				// Stores Value In ah At ebx
-		
-		add ebx,m					// Moves Through The Data
-		dec ecx						// Decreases Our Loop Counter
-		jnz label					// If Not Zero Jump Back To Label
+		const BYTE r = p[0];
+		p[0] = p[2];
+		p[2] = r;
 	}
 }
 
@@ -688,8 +680,8 @@ struct DbgSpline: DbgObject
 		Point pt[] = {ptPos1, ptPos1 + ptDir1, ptPos2 - ptDir2, ptPos2};
 		if( fStep )
 		{
-			float len = SplineLenEst(pt);
-			m_nDivs = 1 + Trunc(len / fStep);
+			SplineArc arc(pt);
+			m_nDivs = 1 + Trunc(arc.GetLen() / fStep);
 		}
 		SplineCoefs(pt, m_coefs);
 	}
@@ -7,8 +7,8 @@
 #include <gl/gl.h>									// Header File For The OpenGL32 Library
 #include <gl/glu.h>									// Header File For The GLu32 Library
 
-#include "utils.h"
-#include "math.h"
+#include "Utils.h"
+#include "Math.h"
 
 enum RGB_COMPS
 {
@@ -0,0 +1,179 @@
+#include "Level.h"
+#include "Simulation.h"
+
+#define MAX_LEVEL_CELLS (1 << 26)
+
+unsigned int LevelVersion::Next()
+{
+	static volatile LONG nVersion = 0;
+	return (unsigned int)InterlockedIncrement(&nVersion);
+}
+
+LevelGrid::LevelGrid():m_nWidth(0), m_nHeight(0), m_nChunksX(0), m_nChunksY(0), m_nCount(0), m_uHash(0),
+	m_fMinX(0), m_fMinY(0), m_fPitch(0), m_fInvPitch(0)
+{
+}
+
+void LevelGrid::Create(int nWidth, int nHeight)
+{
+	ASSERT(nWidth > 0 && nHeight > 0);
+	m_nWidth = nWidth;
+	m_nHeight = nHeight;
+	m_nChunksX = (nWidth + CHUNK_MASK) >> CHUNK_BITS;
+	m_nChunksY = (nHeight + CHUNK_MASK) >> CHUNK_BITS;
+	m_fPitch = fBrickSize + fBrickMargin;
+	m_fInvPitch = 1 / m_fPitch;
+	m_fMinX = fLevelOffsetX - GetSpanX();
+	m_fMinY = fLevelOffsetY - GetSpanY();
+	Clear();
+}
+
+void LevelGrid::Clear()
+{
+	m_vChunkIds.assign(m_nChunksX * m_nChunksY, -1);
+	m_vChunks.clear();
+	m_nCount = 0;
+	m_version.u = LevelVersion::Next();
+	m_uHash = 0;
+}
+
+unsigned __int64 LevelGrid::CellKey(int x, int y)
+{
+	// splitmix64 of the position, no table to keep for every level size
+	unsigned __int64 u = ((unsigned __int64)(DWORD)y << 32 | (DWORD)x) + 0x9e3779b97f4a7c15ull;
+	u = (u ^ (u >> 30)) * 0xbf58476d1ce4e5b9ull;
+	u = (u ^ (u >> 27)) * 0x94d049bb133111ebull;
+	return u ^ (u >> 31);
+}
+
+Chunk *LevelGrid::AllocChunk(int cx, int cy)
+{
+	int &id = m_vChunkIds[cy * m_nChunksX + cx];
+	if( id < 0 )
+	{
+		id = (int)m_vChunks.size();
+		m_vChunks.resize(id + 1);
+		Chunk &chunk = m_vChunks.back();
+		ZeroMemory(&chunk, sizeof(chunk));
+		chunk.cx = cx;
+		chunk.cy = cy;
+	}
+	return &m_vChunks[id];
+}
+
+void LevelGrid::LoadBricks(const void *pData)
+{
+	if( !m_vChunks.empty() )
+		memcpy(&m_vChunks[0], pData, GetBricksSize());
+	m_nCount = 0;
+	m_uHash = 0;
+	for(size_t i = 0; i < m_vChunks.size(); i++)
+	{
+		m_nCount += m_vChunks[i].nCount;
+		m_uHash ^= m_vChunks[i].uHash;
+	}
+	m_version.u = LevelVersion::Next();
+}
+
+void LevelGrid::Set(int x, int y, int type)
+{
+	ASSERT(IsValid(x, y) && type >= 0 && type < MAX_TYPE);
+	if( !IsValid(x, y) )
+		return;
+	const int cx = x >> CHUNK_BITS, cy = y >> CHUNK_BITS, lx = x & CHUNK_MASK, ly = y & CHUNK_MASK;
+	Chunk *chunk = type ? AllocChunk(cx, cy) : const_cast<Chunk*>(GetChunk(cx, cy));
+	if( !chunk )
+		return;
+	const DWORD bit = (DWORD)1 << lx;
+	m_version.u = LevelVersion::Next();
+	const bool bWasLive = (chunk->Row(ly) & bit) != 0;
+	for(int b = 0; b < TYPE_BITS; b++)
+	{
+		if( (type >> b) & 1 )
+			chunk->planes[b][ly] |= bit;
+		else
+			chunk->planes[b][ly] &= ~bit;
+	}
+	if( bWasLive != (type != 0) )
+	{
+		int delta = type ? 1 : -1;
+		chunk->nCount += delta;
+		m_nCount += delta;
+		const unsigned __int64 uKey = CellKey(x, y);
+		chunk->uHash ^= uKey;
+		m_uHash ^= uKey;
+		chunk->used = SET_BIT(chunk->used, ly, chunk->Row(ly) != 0);
+	}
+}
+
+int LevelGrid::GetCount(int type) const
+{
+	ASSERT(type > 0 && type < MAX_TYPE);
+	int nCount = 0;
+	for(size_t i = 0; i < m_vChunks.size(); i++)
+	{
+		const Chunk &chunk = m_vChunks[i];
+		for(DWORD rows = chunk.used; rows; rows &= rows - 1)
+			nCount += BitCount(chunk.Row(LowBit(rows), type));
+	}
+	return nCount;
+}
+
+ErrorCode LevelGrid::Read(FILE *fp)
+{
+	int nWidth = LEVEL_WIDTH, nHeight = LEVEL_HEIGHT;
+	long pos = ftell(fp);
+	if( fscanf(fp, " %d x %d :", &nWidth, &nHeight) != 2 )
+	{
+		// no header, the original 20x10 format
+		nWidth = LEVEL_WIDTH;
+		nHeight = LEVEL_HEIGHT;
+		fseek(fp, pos, SEEK_SET);
+	}
+	if( nWidth <= 0 || nHeight <= 0 || nWidth > MAX_LEVEL_CELLS / nHeight )
+		return "Invalid level size";
+	Create(nWidth, nHeight);
+	for(int y = 0; y < nHeight; y++)
+	{
+		for(int x = 0; x < nWidth; x++)
+		{
+			int type = -1;
+			if( fscanf(fp, "%d,", &type) <= 0 || type < 0 || type >= MAX_TYPE )
+				return "Corrupted level file";
+			if( type )
+				Set(x, y, type);
+		}
+	}
+	return NO_ERROR;
+}
+
+ErrorCode LevelGrid::Write(FILE *fp) const
+{
+	// the default size keeps the original headerless format
+	bool bHeader = m_nWidth != LEVEL_WIDTH || m_nHeight != LEVEL_HEIGHT;
+	if( bHeader )
+		fprintf(fp, "%dx%d:\n", m_nWidth, m_nHeight);
+	for(int y = 0; y < m_nHeight; y++)
+	{
+		for(int x = 0; x < m_nWidth; x++)
+			fprintf(fp, "%d,", Get(x, y));
+		if( bHeader )
+			fprintf(fp, "\n");
+	}
+	return ferror(fp) ? "Write error" : NO_ERROR;
+}
+
+void LevelGrid::Generate(int nWidth, int nHeight, int nDensity, unsigned int uSeed)
+{
+	Create(nWidth, nHeight);
+	RandGen gen(uSeed);
+	for(int y = 0; y < nHeight; y++)
+	{
+		for(int x = 0; x < nWidth; x++)
+		{
+			int r = gen.Next();
+			if( r % 100 < nDensity )
+				Set(x, y, 1 + (r / 100) % (MAX_TYPE - 1));
+		}
+	}
+}
@@ -0,0 +1,260 @@
+#ifndef __LEVEL_H_
+#define __LEVEL_H_
+
+#include <vector>
+
+#include "Utils.h"
+#include "Math.h"
+
+// Levels are stored sparsely in square chunks of CHUNK_SIZE x CHUNK_SIZE cells.
+// Only chunks that ever held a brick are allocated, so a mostly empty 1000x1000 level costs little more than its bricks.
+#define CHUNK_BITS 5
+#define CHUNK_SIZE (1 << CHUNK_BITS)
+#define CHUNK_MASK (CHUNK_SIZE - 1)
+
+// Brick types are packed in TYPE_BITS bit planes, type 0 is an empty cell
+#define TYPE_BITS 2
+#define MAX_TYPE (1 << TYPE_BITS)
+// Bit of the type in a set of types
+#define TYPE_BIT(type) ((DWORD)1 << (type))
+
+// Bits [0, n) set, n <= 32
+#define LOW_BITS(n) ((n) >= 32 ? 0xffffffff : ((DWORD)1 << (n)) - 1)
+
+struct Chunk
+{
+	DWORD planes[TYPE_BITS][CHUNK_SIZE]; // bit x of planes[b][y] is bit b of the type of cell (x, y)
+	DWORD used; // bit y is set if row y holds a brick
+	int cx, cy; // chunk coordinates
+	int nCount; // live bricks
+	unsigned __int64 uHash; // xor of the cell keys of the live bricks, see LevelGrid::GetHash
+
+	// Cells of row y holding a brick
+	DWORD Row(int y) const
+	{
+		DWORD bits = 0;
+		for(int b = 0; b < TYPE_BITS; b++)
+			bits |= planes[b][y];
+		return bits;
+	}
+	// Cells of row y holding the type
+	DWORD Row(int y, int type) const
+	{
+		DWORD bits = 0xffffffff;
+		for(int b = 0; b < TYPE_BITS; b++)
+			bits &= (type >> b) & 1 ? planes[b][y] : ~planes[b][y];
+		return bits;
+	}
+	// Cells of row y holding one of the types, a set of TYPE_BITs
+	DWORD RowOf(int y, DWORD types) const
+	{
+		DWORD bits = 0;
+		for(int type = 1; type < MAX_TYPE; type++)
+			if( types & TYPE_BIT(type) )
+				bits |= Row(y, type);
+		return bits;
+	}
+	int Get(int x, int y) const
+	{
+		int type = 0;
+		for(int b = 0; b < TYPE_BITS; b++)
+			type |= ((planes[b][y] >> x) & 1) << b;
+		return type;
+	}
+};
+
+// Version of a level, taken from a counter shared by all the levels. A copy takes a new one too, so a level
+// loaded over another one never has the version of a layout something was computed from before.
+struct LevelVersion
+{
+	unsigned int u;
+	LevelVersion():u(Next()){}
+	LevelVersion(const LevelVersion &):u(Next()){}
+	LevelVersion &operator=(const LevelVersion &) { u = Next(); return *this; }
+	static unsigned int Next();
+};
+
+class LevelGrid
+{
+	int m_nWidth, m_nHeight, m_nChunksX, m_nChunksY, m_nCount;
+	LevelVersion m_version; // changes with every Set, Clear, LoadBricks and copy
+	unsigned __int64 m_uHash;
+	Real m_fMinX, m_fMinY, m_fPitch, m_fInvPitch;
+	std::vector<int> m_vChunkIds; // index into m_vChunks for each chunk slot, -1 if not allocated
+	std::vector<Chunk> m_vChunks;
+
+	const Chunk *GetChunk(int cx, int cy) const
+	{
+		if( cx < 0 || cx >= m_nChunksX || cy < 0 || cy >= m_nChunksY )
+			return NULL;
+		int id = m_vChunkIds[cy * m_nChunksX + cx];
+		return id < 0 ? NULL : &m_vChunks[id];
+	}
+	Chunk *AllocChunk(int cx, int cy);
+public:
+	LevelGrid();
+
+	// Empty level of the given size, centered on fLevelOffsetX/Y
+	void Create(int nWidth, int nHeight);
+	void Clear();
+	// Level file: "W x H:" header (optional for the default size) followed by W*H comma separated types
+	ErrorCode Read(FILE *fp);
+	ErrorCode Write(FILE *fp) const;
+	// nDensity is the percentage of filled cells
+	void Generate(int nWidth, int nHeight, int nDensity, unsigned int uSeed);
+
+	int GetWidth() const { return m_nWidth; }
+	int GetHeight() const { return m_nHeight; }
+	int GetCells() const { return m_nWidth * m_nHeight; }
+	int GetCount() const { return m_nCount; }
+	int GetCount(int type) const;
+	bool IsCleared() const { return !m_nCount; }
+	unsigned int GetVersion() const { return m_version.u; }
+	// Zobrist hash of the cells holding a brick, whatever their types: unlike the version it comes back
+	// when the bricks do, so it can key things computed from the layout. Kept up to date by every change.
+	unsigned __int64 GetHash() const { return m_uHash; }
+	// Random key of a cell, the hash of a layout is the xor of the keys of its bricks
+	static unsigned __int64 CellKey(int x, int y);
+	// Bricks as one block of GetBricksSize() bytes, for snapshots. A block only fits back into the level
+	// it came from while no brick is put into an empty chunk, which a game never does.
+	int GetBricksSize() const { return (int)(m_vChunks.size() * sizeof(Chunk)); }
+	void SaveBricks(void *pData) const
+	{
+		if( !m_vChunks.empty() )
+			memcpy(pData, &m_vChunks[0], GetBricksSize());
+	}
+	void LoadBricks(const void *pData);
+	bool IsValid(int x, int y) const { return x >= 0 && x < m_nWidth && y >= 0 && y < m_nHeight; }
+
+	int Get(int x, int y) const
+	{
+		const Chunk *chunk = GetChunk(x >> CHUNK_BITS, y >> CHUNK_BITS);
+		return chunk ? chunk->Get(x & CHUNK_MASK, y & CHUNK_MASK) : 0;
+	}
+	int Get(int o) const { return Get(o % m_nWidth, o / m_nWidth); }
+	void Set(int x, int y, int type);
+	void Set(int o, int type) { Set(o % m_nWidth, o / m_nWidth, type); }
+
+	// Occupancy of the cells [x, x + 32) in row y, bit i for cell x + i
+	DWORD GetRow(int x, int y) const
+	{
+		const int cx = x >> CHUNK_BITS, cy = y >> CHUNK_BITS, lx = x & CHUNK_MASK, ly = y & CHUNK_MASK;
+		const Chunk *chunk = GetChunk(cx, cy);
+		DWORD bits = chunk ? chunk->Row(ly) >> lx : 0;
+		if( lx && (chunk = GetChunk(cx + 1, cy)) != NULL )
+			bits |= chunk->Row(ly) << (CHUNK_SIZE - lx);
+		return bits;
+	}
+	// Same for the cells holding one of the types
+	DWORD GetRow(int x, int y, DWORD types) const
+	{
+		const int cx = x >> CHUNK_BITS, cy = y >> CHUNK_BITS, lx = x & CHUNK_MASK, ly = y & CHUNK_MASK;
+		const Chunk *chunk = GetChunk(cx, cy);
+		DWORD bits = chunk ? chunk->RowOf(ly, types) >> lx : 0;
+		if( lx && (chunk = GetChunk(cx + 1, cy)) != NULL )
+			bits |= chunk->RowOf(ly, types) << (CHUNK_SIZE - lx);
+		return bits;
+	}
+
+	// Cell centers
+	Real GetX(int x) const { return m_fMinX + m_fPitch * x; }
+	Real GetY(int y) const { return m_fMinY + m_fPitch * y; }
+	Real GetSpanX() const { return m_fPitch * (m_nWidth - 1) / 2; }
+	Real GetSpanY() const { return m_fPitch * (m_nHeight - 1) / 2; }
+	// Cell (not clamped) whose center is nearest to the position
+	int GetCellX(Real x) const { return Floor((x - m_fMinX) * m_fInvPitch + Real(0.5f)); }
+	int GetCellY(Real y) const { return Floor((y - m_fMinY) * m_fInvPitch + Real(0.5f)); }
+
+	// Calls f(x, y, type) for every live brick, type by type
+	template<class F>
+	void ForEach(F f) const
+	{
+		for(int type = 1; type < MAX_TYPE; type++)
+			ForEach(type, f);
+	}
+	// Calls f(x, y, type) for every brick of the type
+	template<class F>
+	void ForEach(int type, F f) const
+	{
+		ASSERT(type > 0 && type < MAX_TYPE);
+		for(size_t i = 0; i < m_vChunks.size(); i++)
+		{
+			const Chunk &chunk = m_vChunks[i];
+			for(DWORD rows = chunk.used; rows; rows &= rows - 1)
+			{
+				const int ly = LowBit(rows);
+				for(DWORD bits = chunk.Row(ly, type); bits; bits &= bits - 1)
+					f((chunk.cx << CHUNK_BITS) + LowBit(bits), (chunk.cy << CHUNK_BITS) + ly, type);
+			}
+		}
+	}
+};
+
+// Brick changes kept aside from a level, to look ahead without copying or changing it.
+// Has the part of the LevelGrid interface the ball step uses; meant for a few changes, every access searches them all.
+class LevelOverlay
+{
+	struct Change
+	{
+		int x, y, type;
+	};
+	const LevelGrid *m_pLevel;
+	std::vector<Change> m_vChanges;
+public:
+	LevelOverlay():m_pLevel(NULL){}
+	void Reset(const LevelGrid &level) { m_pLevel = &level; m_vChanges.clear(); }
+
+	int GetWidth() const { return m_pLevel->GetWidth(); }
+	int GetHeight() const { return m_pLevel->GetHeight(); }
+	Real GetX(int x) const { return m_pLevel->GetX(x); }
+	Real GetY(int y) const { return m_pLevel->GetY(y); }
+	int GetCellX(Real x) const { return m_pLevel->GetCellX(x); }
+	int GetCellY(Real y) const { return m_pLevel->GetCellY(y); }
+
+	int Get(int x, int y) const
+	{
+		for(size_t i = 0; i < m_vChanges.size(); i++)
+			if( m_vChanges[i].x == x && m_vChanges[i].y == y )
+				return m_vChanges[i].type;
+		return m_pLevel->Get(x, y);
+	}
+	void Set(int x, int y, int type)
+	{
+		for(size_t i = 0; i < m_vChanges.size(); i++)
+			if( m_vChanges[i].x == x && m_vChanges[i].y == y )
+			{
+				m_vChanges[i].type = type;
+				return;
+			}
+		Change change = { x, y, type };
+		m_vChanges.push_back(change);
+	}
+	DWORD GetRow(int x, int y) const
+	{
+		DWORD bits = m_pLevel->GetRow(x, y);
+		for(size_t i = 0; i < m_vChanges.size(); i++)
+		{
+			const Change &change = m_vChanges[i];
+			if( change.y != y || change.x < x || change.x >= x + 32 )
+				continue;
+			const DWORD bit = (DWORD)1 << (change.x - x);
+			bits = change.type ? bits | bit : bits & ~bit;
+		}
+		return bits;
+	}
+	DWORD GetRow(int x, int y, DWORD types) const
+	{
+		DWORD bits = m_pLevel->GetRow(x, y, types);
+		for(size_t i = 0; i < m_vChanges.size(); i++)
+		{
+			const Change &change = m_vChanges[i];
+			if( change.y != y || change.x < x || change.x >= x + 32 )
+				continue;
+			const DWORD bit = (DWORD)1 << (change.x - x);
+			bits = types & TYPE_BIT(change.type) ? bits | bit : bits & ~bit;
+		}
+		return bits;
+	}
+};
+
+#endif __LEVEL_H_
@@ -1,39 +1,52 @@
-#include "math.h"
+#include "Math.h"
+// The SSE and AVX kernels are there on x86 and x64 only, elsewhere everything runs the scalar ones
+#ifdef FAST_MATH_SSE
+#include <immintrin.h>
+#ifndef _MSC_VER
+#include <cpuid.h>
+// the AVX kernels are built for AVX alone, they only run when the processor has it
+#define MATH_TARGET_AVX __attribute__((target("avx")))
+#else
+#define MATH_TARGET_AVX
+#endif
+#endif
 
+template<class T>
 bool IntersectSegmentSegment2D(
-	float x1a, float y1a, float x2a, float y2a,
-	float x1b, float y1b, float x2b, float y2b,
-	float *ka, float *kb)
+	T x1a, T y1a, T x2a, T y2a,
+	T x1b, T y1b, T x2b, T y2b,
+	T *ka, T *kb)
 {
-	float dxa = x2a - x1a, dya = y2a - y1a, dxb = x2b - x1b, dyb = y2b - y1b;
-	float c = dxa * dyb - dya * dxb;
-	if( !c )
+	T dxa = x2a - x1a, dya = y2a - y1a, dxb = x2b - x1b, dyb = y2b - y1b;
+	T c = dxa * dyb - dya * dxb;
+	if( c == 0 )
 		return false;
 	bool positive = c > 0;
-	float dx = x1a - x1b, dy = y1a - y1b;
-	float a = dxb * dy - dyb * dx;
-	if( positive && (a < 0 || a > c ) || !positive && (a > 0 || a < c) )
+	T dx = x1a - x1b, dy = y1a - y1b;
+	T a = dxb * dy - dyb * dx;
+	if( (positive && (a < 0 || a > c)) || (!positive && (a > 0 || a < c)) )
 		return false;
-	float b = dxa * dy - dya * dx;
-	if( positive && (b < 0 || b > c ) || !positive && (b > 0 || b < c) )
+	T b = dxa * dy - dya * dx;
+	if( (positive && (b < 0 || b > c)) || (!positive && (b > 0 || b < c)) )
 		return false;
 	if( ka || kb )
 	{
-		float cr = 1 / c;
+		T cr = 1 / c;
 		if( ka ) *ka = a * cr;
 		if( kb ) *kb = b * cr;
 	}
 	return true;
 }
 
+template<class T>
 bool IntersectSegmentCircle2D(
-	float x1, float y1,
-	float x2, float y2,
-	float xc, float yc,
-	float rc,
-	float *k)
+	T x1, T y1,
+	T x2, T y2,
+	T xc, T yc,
+	T rc,
+	T *k)
 {
-	float
+	T
 		u = x2 - x1, v = y2 - y1,
 		dx = x1 - xc, dy = y1 - yc,
 		a = u * u + v * v, b = u * dx + v * dy, c = dx * dx + dy * dy - rc * rc,
@@ -41,20 +54,400 @@ bool IntersectSegmentCircle2D(
 	ASSERT(a != 0);
 	if( d < 0 )
 		return false; // no intersection
-	float ab = a + b, ab2 = ab * ab;
+	T ab = a + b, ab2 = ab * ab;
 	if( -b >= 0 && (-ab < 0 || d >= ab2 ) && d <= b2 )
 	{
-		if( k ) *k = (-b - sqrtf(d)) / a;
+		if( k ) *k = (-b - Sqrt(d)) / a;
 		return true; // root 1 (point 1 outside the circle)
 	}
 	if( ab >= 0 && (  b < 0 || d >= b2  ) && d <= ab2 )
 	{
-		if( k ) *k = (-b + sqrtf(d)) / a;
+		if( k ) *k = (-b + Sqrt(d)) / a;
 		return true; // root 2 (point 1 inside the circle)
 	}
 	return false; // intersection outside the segment
 }
 
+template bool IntersectSegmentSegment2D<float>(float, float, float, float, float, float, float, float, float *, float *);
+template bool IntersectSegmentSegment2D<Fixed>(Fixed, Fixed, Fixed, Fixed, Fixed, Fixed, Fixed, Fixed, Fixed *, Fixed *);
+template bool IntersectSegmentCircle2D<float>(float, float, float, float, float, float, float, float *);
+template bool IntersectSegmentCircle2D<Fixed>(Fixed, Fixed, Fixed, Fixed, Fixed, Fixed, Fixed, Fixed *);
+
+// The batch kernels. Every lane does the operations of the scalar functions in their order, so the hits
+// and the k are the same bit for bit whichever kernel runs; the targets past the last full vector go to the scalar ones.
+
+typedef DWORD (*SegmentsProc)(float x1, float y1, float x2, float y2, const float *pfX1, const float *pfY1, const float *pfX2, const float *pfY2, int nCount, float *pfK);
+typedef DWORD (*CirclesProc)(float x1, float y1, float x2, float y2, const float *pfXc, const float *pfYc, const float *pfRc, int nCount, float *pfK);
+
+static DWORD SegmentsScalar(float x1, float y1, float x2, float y2, const float *pfX1, const float *pfY1, const float *pfX2, const float *pfY2, int nCount, float *pfK)
+{
+	DWORD mask = 0;
+	for(int i = 0; i < nCount; i++)
+		if( IntersectSegmentSegment2D(x1, y1, x2, y2, pfX1[i], pfY1[i], pfX2[i], pfY2[i], pfK + i) )
+			mask |= 1u << i;
+	return mask;
+}
+
+static DWORD CirclesScalar(float x1, float y1, float x2, float y2, const float *pfXc, const float *pfYc, const float *pfRc, int nCount, float *pfK)
+{
+	DWORD mask = 0;
+	for(int i = 0; i < nCount; i++)
+		if( IntersectSegmentCircle2D(x1, y1, x2, y2, pfXc[i], pfYc[i], pfRc[i], pfK + i) )
+			mask |= 1u << i;
+	return mask;
+}
+
+#ifdef FAST_MATH_SSE
+static inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static DWORD SegmentsSse(float x1, float y1, float x2, float y2, const float *pfX1, const float *pfY1, const float *pfX2, const float *pfY2, int nCount, float *pfK)
+{
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+	const __m128 xa = _mm_set1_ps(x1), ya = _mm_set1_ps(y1), dxa = _mm_set1_ps(x2 - x1), dya = _mm_set1_ps(y2 - y1);
+	DWORD mask = 0;
+	int i = 0;
+	for(; i + 4 <= nCount; i += 4)
+	{
+		const __m128 xb = _mm_loadu_ps(pfX1 + i), yb = _mm_loadu_ps(pfY1 + i);
+		const __m128 dxb = _mm_sub_ps(_mm_loadu_ps(pfX2 + i), xb), dyb = _mm_sub_ps(_mm_loadu_ps(pfY2 + i), yb);
+		const __m128 c = _mm_sub_ps(_mm_mul_ps(dxa, dyb), _mm_mul_ps(dya, dxb));
+		const __m128 positive = _mm_cmpgt_ps(c, zero);
+		const __m128 dx = _mm_sub_ps(xa, xb), dy = _mm_sub_ps(ya, yb);
+		const __m128 a = _mm_sub_ps(_mm_mul_ps(dxb, dy), _mm_mul_ps(dyb, dx));
+		const __m128 b = _mm_sub_ps(_mm_mul_ps(dxa, dy), _mm_mul_ps(dya, dx));
+		// out of [0, c] when c is positive, out of [c, 0] otherwise
+		const __m128 outA = _mm_or_ps(
+			_mm_and_ps(positive, _mm_or_ps(_mm_cmplt_ps(a, zero), _mm_cmpgt_ps(a, c))),
+			_mm_andnot_ps(positive, _mm_or_ps(_mm_cmpgt_ps(a, zero), _mm_cmplt_ps(a, c))));
+		const __m128 outB = _mm_or_ps(
+			_mm_and_ps(positive, _mm_or_ps(_mm_cmplt_ps(b, zero), _mm_cmpgt_ps(b, c))),
+			_mm_andnot_ps(positive, _mm_or_ps(_mm_cmpgt_ps(b, zero), _mm_cmplt_ps(b, c))));
+		const __m128 hit = _mm_andnot_ps(_mm_or_ps(outA, outB), _mm_cmpneq_ps(c, zero));
+		const int bits = _mm_movemask_ps(hit);
+		if( !bits )
+			continue;
+		_mm_storeu_ps(pfK + i, _mm_mul_ps(a, _mm_div_ps(one, c)));
+		mask |= (DWORD)bits << i;
+	}
+	if( i < nCount )
+		mask |= SegmentsScalar(x1, y1, x2, y2, pfX1 + i, pfY1 + i, pfX2 + i, pfY2 + i, nCount - i, pfK + i) << i;
+	return mask;
+}
+
+static DWORD CirclesSse(float x1, float y1, float x2, float y2, const float *pfXc, const float *pfYc, const float *pfRc, int nCount, float *pfK)
+{
+	const float fu = x2 - x1, fv = y2 - y1;
+	const __m128 zero = _mm_setzero_ps(), sign = _mm_set1_ps(-0.0f);
+	const __m128 xa = _mm_set1_ps(x1), ya = _mm_set1_ps(y1), u = _mm_set1_ps(fu), v = _mm_set1_ps(fv), a = _mm_set1_ps(fu * fu + fv * fv);
+	DWORD mask = 0;
+	int i = 0;
+	for(; i + 4 <= nCount; i += 4)
+	{
+		const __m128 dx = _mm_sub_ps(xa, _mm_loadu_ps(pfXc + i)), dy = _mm_sub_ps(ya, _mm_loadu_ps(pfYc + i)), rc = _mm_loadu_ps(pfRc + i);
+		const __m128 b = _mm_add_ps(_mm_mul_ps(u, dx), _mm_mul_ps(v, dy));
+		const __m128 c = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(rc, rc));
+		const __m128 b2 = _mm_mul_ps(b, b), d = _mm_sub_ps(b2, _mm_mul_ps(a, c));
+		const __m128 ab = _mm_add_ps(a, b), ab2 = _mm_mul_ps(ab, ab), nb = _mm_xor_ps(b, sign);
+		// root 1 with point 1 outside the circle, else root 2 with point 1 inside
+		const __m128 root1 = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(nb, zero), _mm_cmple_ps(d, b2)),
+			_mm_or_ps(_mm_cmplt_ps(_mm_xor_ps(ab, sign), zero), _mm_cmpge_ps(d, ab2)));
+		const __m128 root2 = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(ab, zero), _mm_cmple_ps(d, ab2)),
+			_mm_or_ps(_mm_cmplt_ps(b, zero), _mm_cmpge_ps(d, b2)));
+		const __m128 hit = _mm_andnot_ps(_mm_cmplt_ps(d, zero), _mm_or_ps(root1, root2));
+		const int bits = _mm_movemask_ps(hit);
+		if( !bits )
+			continue;
+		const __m128 s = _mm_sqrt_ps(d);
+		const __m128 k = _mm_div_ps(Select(root1, _mm_sub_ps(nb, s), _mm_add_ps(nb, s)), a);
+		_mm_storeu_ps(pfK + i, k);
+		mask |= (DWORD)bits << i;
+	}
+	if( i < nCount )
+		mask |= CirclesScalar(x1, y1, x2, y2, pfXc + i, pfYc + i, pfRc + i, nCount - i, pfK + i) << i;
+	return mask;
+}
+
+MATH_TARGET_AVX static inline __m256 Select(__m256 mask, __m256 a, __m256 b)
+{
+	return _mm256_or_ps(_mm256_and_ps(mask, a), _mm256_andnot_ps(mask, b));
+}
+
+MATH_TARGET_AVX static DWORD SegmentsAvx(float x1, float y1, float x2, float y2, const float *pfX1, const float *pfY1, const float *pfX2, const float *pfY2, int nCount, float *pfK)
+{
+	const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+	const __m256 xa = _mm256_set1_ps(x1), ya = _mm256_set1_ps(y1), dxa = _mm256_set1_ps(x2 - x1), dya = _mm256_set1_ps(y2 - y1);
+	DWORD mask = 0;
+	int i = 0;
+	for(; i + 8 <= nCount; i += 8)
+	{
+		const __m256 xb = _mm256_loadu_ps(pfX1 + i), yb = _mm256_loadu_ps(pfY1 + i);
+		const __m256 dxb = _mm256_sub_ps(_mm256_loadu_ps(pfX2 + i), xb), dyb = _mm256_sub_ps(_mm256_loadu_ps(pfY2 + i), yb);
+		const __m256 c = _mm256_sub_ps(_mm256_mul_ps(dxa, dyb), _mm256_mul_ps(dya, dxb));
+		const __m256 positive = _mm256_cmp_ps(c, zero, _CMP_GT_OQ);
+		const __m256 dx = _mm256_sub_ps(xa, xb), dy = _mm256_sub_ps(ya, yb);
+		const __m256 a = _mm256_sub_ps(_mm256_mul_ps(dxb, dy), _mm256_mul_ps(dyb, dx));
+		const __m256 b = _mm256_sub_ps(_mm256_mul_ps(dxa, dy), _mm256_mul_ps(dya, dx));
+		const __m256 outA = Select(positive,
+			_mm256_or_ps(_mm256_cmp_ps(a, zero, _CMP_LT_OQ), _mm256_cmp_ps(a, c, _CMP_GT_OQ)),
+			_mm256_or_ps(_mm256_cmp_ps(a, zero, _CMP_GT_OQ), _mm256_cmp_ps(a, c, _CMP_LT_OQ)));
+		const __m256 outB = Select(positive,
+			_mm256_or_ps(_mm256_cmp_ps(b, zero, _CMP_LT_OQ), _mm256_cmp_ps(b, c, _CMP_GT_OQ)),
+			_mm256_or_ps(_mm256_cmp_ps(b, zero, _CMP_GT_OQ), _mm256_cmp_ps(b, c, _CMP_LT_OQ)));
+		const __m256 hit = _mm256_andnot_ps(_mm256_or_ps(outA, outB), _mm256_cmp_ps(c, zero, _CMP_NEQ_UQ));
+		const int bits = _mm256_movemask_ps(hit);
+		if( !bits )
+			continue;
+		_mm256_storeu_ps(pfK + i, _mm256_mul_ps(a, _mm256_div_ps(one, c)));
+		mask |= (DWORD)bits << i;
+	}
+	if( i < nCount )
+		mask |= SegmentsSse(x1, y1, x2, y2, pfX1 + i, pfY1 + i, pfX2 + i, pfY2 + i, nCount - i, pfK + i) << i;
+	return mask;
+}
+
+MATH_TARGET_AVX static DWORD CirclesAvx(float x1, float y1, float x2, float y2, const float *pfXc, const float *pfYc, const float *pfRc, int nCount, float *pfK)
+{
+	const float fu = x2 - x1, fv = y2 - y1;
+	const __m256 zero = _mm256_setzero_ps(), sign = _mm256_set1_ps(-0.0f);
+	const __m256 xa = _mm256_set1_ps(x1), ya = _mm256_set1_ps(y1), u = _mm256_set1_ps(fu), v = _mm256_set1_ps(fv), a = _mm256_set1_ps(fu * fu + fv * fv);
+	DWORD mask = 0;
+	int i = 0;
+	for(; i + 8 <= nCount; i += 8)
+	{
+		const __m256 dx = _mm256_sub_ps(xa, _mm256_loadu_ps(pfXc + i)), dy = _mm256_sub_ps(ya, _mm256_loadu_ps(pfYc + i)), rc = _mm256_loadu_ps(pfRc + i);
+		const __m256 b = _mm256_add_ps(_mm256_mul_ps(u, dx), _mm256_mul_ps(v, dy));
+		const __m256 c = _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(rc, rc));
+		const __m256 b2 = _mm256_mul_ps(b, b), d = _mm256_sub_ps(b2, _mm256_mul_ps(a, c));
+		const __m256 ab = _mm256_add_ps(a, b), ab2 = _mm256_mul_ps(ab, ab), nb = _mm256_xor_ps(b, sign);
+		const __m256 root1 = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(nb, zero, _CMP_GE_OQ), _mm256_cmp_ps(d, b2, _CMP_LE_OQ)),
+			_mm256_or_ps(_mm256_cmp_ps(_mm256_xor_ps(ab, sign), zero, _CMP_LT_OQ), _mm256_cmp_ps(d, ab2, _CMP_GE_OQ)));
+		const __m256 root2 = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(ab, zero, _CMP_GE_OQ), _mm256_cmp_ps(d, ab2, _CMP_LE_OQ)),
+			_mm256_or_ps(_mm256_cmp_ps(b, zero, _CMP_LT_OQ), _mm256_cmp_ps(d, b2, _CMP_GE_OQ)));
+		const __m256 hit = _mm256_andnot_ps(_mm256_cmp_ps(d, zero, _CMP_LT_OQ), _mm256_or_ps(root1, root2));
+		const int bits = _mm256_movemask_ps(hit);
+		if( !bits )
+			continue;
+		const __m256 s = _mm256_sqrt_ps(d);
+		_mm256_storeu_ps(pfK + i, _mm256_div_ps(Select(root1, _mm256_sub_ps(nb, s), _mm256_add_ps(nb, s)), a));
+		mask |= (DWORD)bits << i;
+	}
+	if( i < nCount )
+		mask |= CirclesSse(x1, y1, x2, y2, pfXc + i, pfYc + i, pfRc + i, nCount - i, pfK + i) << i;
+	return mask;
+}
+
+static const SegmentsProc segmentsProcs[] = { SegmentsScalar, SegmentsSse, SegmentsAvx };
+static const CirclesProc circlesProcs[] = { CirclesScalar, CirclesSse, CirclesAvx };
+#else
+static const SegmentsProc segmentsProcs[] = { SegmentsScalar };
+static const CirclesProc circlesProcs[] = { CirclesScalar };
+#endif
+
+// SSE is there on every x86 processor the game runs on, AVX needs the processor and the OS saving its registers
+static int GetCpuSimd()
+{
+#ifndef FAST_MATH_SSE
+	return MATH_SIMD_SCALAR;
+#else
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	const unsigned int ecx = info[2];
+#else
+	unsigned int eax, ebx, ecx, edx;
+	if( !__get_cpuid(1, &eax, &ebx, &ecx, &edx) )
+		return MATH_SIMD_SSE;
+#endif
+	// OSXSAVE and AVX
+	if( (ecx & (3 << 27)) != (3u << 27) )
+		return MATH_SIMD_SSE;
+#ifdef _MSC_VER
+	const unsigned __int64 xcr0 = _xgetbv(0);
+#else
+	unsigned int lo, hi;
+	__asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	const unsigned __int64 xcr0 = ((unsigned __int64)hi << 32) | lo;
+#endif
+	return (xcr0 & 6) == 6 ? MATH_SIMD_AVX : MATH_SIMD_SSE;
+#endif
+}
+
+static int nCpuSimd = GetCpuSimd(), nMathSimd = nCpuSimd;
+
+int GetMathSimd()
+{
+	return nMathSimd;
+}
+
+int SetMathSimd(int nLevel)
+{
+	nMathSimd = Clamp(nLevel, (int)MATH_SIMD_SCALAR, nCpuSimd);
+	return nMathSimd;
+}
+
+// The earliest of the hits in mask, the lowest target on ties
+static DWORD FirstHit(DWORD mask, const float *pfK, float *pfMinK, int *pnFirst)
+{
+	if( !mask || (!pfMinK && !pnFirst) )
+		return mask;
+	int nFirst = LowBit(mask);
+	for(DWORD bits = mask & (mask - 1); bits; bits &= bits - 1)
+		if( pfK[LowBit(bits)] < pfK[nFirst] )
+			nFirst = LowBit(bits);
+	if( pfMinK ) *pfMinK = pfK[nFirst];
+	if( pnFirst ) *pnFirst = nFirst;
+	return mask;
+}
+
+DWORD IntersectSegmentSegments2D(
+	float x1, float y1, float x2, float y2,
+	const float *pfX1, const float *pfY1, const float *pfX2, const float *pfY2, int nCount,
+	float *pfMinK, int *pnFirst)
+{
+	ASSERT(nCount >= 0 && nCount <= 32);
+	float pfK[32];
+	return FirstHit(segmentsProcs[nMathSimd](x1, y1, x2, y2, pfX1, pfY1, pfX2, pfY2, nCount, pfK), pfK, pfMinK, pnFirst);
+}
+
+DWORD IntersectSegmentCircles2D(
+	float x1, float y1, float x2, float y2,
+	const float *pfXc, const float *pfYc, const float *pfRc, int nCount,
+	float *pfMinK, int *pnFirst)
+{
+	ASSERT(nCount >= 0 && nCount <= 32);
+	ASSERT(x1 != x2 || y1 != y2);
+	float pfK[32];
+	return FirstHit(circlesProcs[nMathSimd](x1, y1, x2, y2, pfXc, pfYc, pfRc, nCount, pfK), pfK, pfMinK, pnFirst);
+}
+
+// The lanes of the kernels add the products in the order of TransformScalar, so that they give the same bits
+static void TransformScalar(const float *m, const float *pfX, const float *pfY, const float *pfZ, float *pfXOut, float *pfYOut, float *pfZOut, int nCount)
+{
+	for(int i = 0; i < nCount; i++)
+	{
+		const float x = pfX[i], y = pfY[i], z = pfZ[i];
+		pfXOut[i] = m[0] * x + m[4] * y + m[8] * z + m[12];
+		pfYOut[i] = m[1] * x + m[5] * y + m[9] * z + m[13];
+		pfZOut[i] = m[2] * x + m[6] * y + m[10] * z + m[14];
+	}
+}
+
+#ifdef FAST_MATH_SSE
+static void TransformSse(const float *m, const float *pfX, const float *pfY, const float *pfZ, float *pfXOut, float *pfYOut, float *pfZOut, int nCount)
+{
+	__m128 mv[12];
+	for(int j = 0; j < 12; j++)
+		mv[j] = _mm_set1_ps(m[j + j / 3]); // the 3 rows of each of the 4 columns
+	int i = 0;
+	for(; i + 4 <= nCount; i += 4)
+	{
+		const __m128 x = _mm_loadu_ps(pfX + i), y = _mm_loadu_ps(pfY + i), z = _mm_loadu_ps(pfZ + i);
+		for(int j = 0; j < 3; j++)
+		{
+			const __m128 r = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(mv[j], x), _mm_mul_ps(mv[j + 3], y)), _mm_mul_ps(mv[j + 6], z)), mv[j + 9]);
+			_mm_storeu_ps((j == 0 ? pfXOut : j == 1 ? pfYOut : pfZOut) + i, r);
+		}
+	}
+	TransformScalar(m, pfX + i, pfY + i, pfZ + i, pfXOut + i, pfYOut + i, pfZOut + i, nCount - i);
+}
+
+MATH_TARGET_AVX static void TransformAvx(const float *m, const float *pfX, const float *pfY, const float *pfZ, float *pfXOut, float *pfYOut, float *pfZOut, int nCount)
+{
+	__m256 mv[12];
+	for(int j = 0; j < 12; j++)
+		mv[j] = _mm256_set1_ps(m[j + j / 3]);
+	int i = 0;
+	for(; i + 8 <= nCount; i += 8)
+	{
+		const __m256 x = _mm256_loadu_ps(pfX + i), y = _mm256_loadu_ps(pfY + i), z = _mm256_loadu_ps(pfZ + i);
+		for(int j = 0; j < 3; j++)
+		{
+			const __m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(mv[j], x), _mm256_mul_ps(mv[j + 3], y)), _mm256_mul_ps(mv[j + 6], z)), mv[j + 9]);
+			_mm256_storeu_ps((j == 0 ? pfXOut : j == 1 ? pfYOut : pfZOut) + i, r);
+		}
+	}
+	TransformSse(m, pfX + i, pfY + i, pfZ + i, pfXOut + i, pfYOut + i, pfZOut + i, nCount - i);
+}
+#endif
+
+typedef void (*TransformProc)(const float *m, const float *pfX, const float *pfY, const float *pfZ, float *pfXOut, float *pfYOut, float *pfZOut, int nCount);
+#ifdef FAST_MATH_SSE
+static const TransformProc transformProcs[] = { TransformScalar, TransformSse, TransformAvx };
+#else
+static const TransformProc transformProcs[] = { TransformScalar };
+#endif
+
+void TransformPoints(const float *pfMatrix,
+	const float *pfX, const float *pfY, const float *pfZ,
+	float *pfXOut, float *pfYOut, float *pfZOut, int nCount)
+{
+	transformProcs[nMathSimd](pfMatrix, pfX, pfY, pfZ, pfXOut, pfYOut, pfZOut, nCount);
+}
+
+void Quaternion::GetMatrix3(float *m) const
+{
+	const float xx = x * x, yy = y * y, zz = z * z, xy = x * y, xz = x * z, yz = y * z, wx = w * x, wy = w * y, wz = w * z;
+	m[0] = 1 - 2 * (yy + zz); m[1] = 2 * (xy - wz);     m[2] = 2 * (xz + wy);
+	m[3] = 2 * (xy + wz);     m[4] = 1 - 2 * (xx + zz); m[5] = 2 * (yz - wx);
+	m[6] = 2 * (xz - wy);     m[7] = 2 * (yz + wx);     m[8] = 1 - 2 * (xx + yy);
+}
+
+void Quaternion::GetMatrix4(float *m, const Point &ptPos) const
+{
+	float r[9];
+	GetMatrix3(r);
+	for(int i = 0; i < 3; i++)
+	{
+		for(int j = 0; j < 3; j++)
+			m[4 * j + i] = r[3 * i + j];
+		m[4 * i + 3] = 0;
+	}
+	m[12] = ptPos.x;
+	m[13] = ptPos.y;
+	m[14] = ptPos.z;
+	m[15] = 1;
+}
+
+void RotatePoints(const Quaternion &q, const Point *ptIn, Point *ptOut, int nCount)
+{
+	float m[9];
+	q.GetMatrix3(m);
+	for(int i = 0; i < nCount; i++)
+	{
+		const Point pt = ptIn[i];
+		ptOut[i] = Point(
+			m[0] * pt.x + m[1] * pt.y + m[2] * pt.z,
+			m[3] * pt.x + m[4] * pt.y + m[5] * pt.z,
+			m[6] * pt.x + m[7] * pt.y + m[8] * pt.z);
+	}
+}
+
+Quaternion Nlerp(const Quaternion &q1, const Quaternion &q2, float t)
+{
+	// q and -q are the same rotation, the one nearer to q1 is the short way
+	const float t2 = q1.Dot(q2) < 0 ? -t : t, t1 = 1 - t;
+	return Quaternion(q1.x * t1 + q2.x * t2, q1.y * t1 + q2.y * t2, q1.z * t1 + q2.z * t2, q1.w * t1 + q2.w * t2).Normalize();
+}
+
+Quaternion Slerp(const Quaternion &q1, const Quaternion &q2, float t)
+{
+	float fCos = q1.Dot(q2), fSign = 1;
+	if( fCos < 0 )
+	{
+		fCos = -fCos;
+		fSign = -1;
+	}
+	// nearly the same rotation, where the sine below loses its precision
+	if( fCos > 0.9995f )
+		return Nlerp(q1, q2, t);
+	const float fAngle = acosf(fCos), fInvSin = 1 / sinf(fAngle);
+	const float t1 = sinf((1 - t) * fAngle) * fInvSin, t2 = sinf(t * fAngle) * fInvSin * fSign;
+	return Quaternion(q1.x * t1 + q2.x * t2, q1.y * t1 + q2.y * t2, q1.z * t1 + q2.z * t2, q1.w * t1 + q2.w * t2);
+}
+
 float DistSegmentPoint2D2(
 	float x1, float y1,
 	float x2, float y2,
@@ -85,6 +478,400 @@ static inline float GetSplineEps2(const Point *s)
 	return (s[3].Dist2(s[0]) + s[0].Dist2(s[1]) + s[1].Dist2(s[2]) + s[2].Dist2(s[3])) / 4000000;
 }
 
+// DistSplineSpline2 runs Gauss-Newton descents from seeds in order, keeping the nearest point they end at,
+// until a descent ends within the precision. The kernels run the descents one after another or in the lanes
+// of a vector; every lane does the operations of the scalar descent in their order, so where each one ends
+// is the same bit for bit whichever kernel runs.
+
+#define SPLINE_SEEDS 4
+static const float splineSeeds[SPLINE_SEEDS] = { 0.00f, 0.33f, 0.66f, 1.00f };
+
+// Descends from the seed t1, t2 and returns the distance it ends at. At an end of a spline with the distance
+// falling outward, t stays at the end and the descent goes on along the other spline only.
+static float SplineDescent(const Point *c1, const Point *c2, float eps2, float &t1, float &t2)
+{
+	Point
+		P1 = SplinePos(c1, t1),
+		V1 = SplineSpeed(c1, t1),
+		A1 = SplineAccel(c1, t1),
+		P2 = SplinePos(c2, t2),
+		V2 = SplineSpeed(c2, t2),
+		A2 = SplineAccel(c2, t2),
+		dP = P1 - P2;
+	float d2 = dP * dP;
+	for(;;)
+	{
+		/* Gauss - Newton (the fastest iterative method, BUT may deviate if the initial solution is too far away from the real solution)
+
+											| V1.V1 + A1.dP      -V1.V2     |* | V1.dP |
+		t(k+1) = t(k) - H*(k).S(k) = t(k) - |                               | .|       |
+											|    -V1.V2       V2.V2 - A2.dP |  |-V2.dP |
+		dP = P1 - P2
+		*/
+		float
+			H12 = -(V1 * V2),
+			H11 = V1 * V1 + A1 * dP,
+			H22 = V2 * V2 - A2 * dP,
+			S1 = V1 * dP,
+			S2 = -(V2 * dP);
+		const bool
+			bFixed1 = (t1 == 0 && S1 > 0) || (t1 == 1 && S1 < 0),
+			bFixed2 = (t2 == 0 && S2 > 0) || (t2 == 1 && S2 < 0);
+		if( bFixed1 && bFixed2 ) // a minimum at the ends of both
+			break;
+		if( bFixed1 ) { H12 = 0; H11 = 1; S1 = 0; }
+		if( bFixed2 ) { H12 = 0; H22 = 1; S2 = 0; }
+		float det = H11 * H22 - H12 * H12;
+		if( det < MIN_HESSIAN_DET || H11 < 0 ) // the hessian has to be positive definite so that there is a minimum
+			break;
+		float
+			fact = 1.0f / det,
+			t1i = t1 + fact * ( H12 * S2 - H22 * S1 ),
+			t2i = t2 + fact * ( H12 * S1 - H11 * S2 );
+
+		// check if the next step is somewhere outside
+		bool bClamped = false;
+		if( t1i < 0 ) { t1i = 0; bClamped = true; }
+		else if( t1i > 1 ) { t1i = 1; bClamped = true; }
+		if( t2i < 0 ) { t2i = 0; bClamped = true; }
+		else if( t2i > 1 ) { t2i = 1; bClamped = true; }
+		if( bClamped && t1 == t1i && t2 == t2i )
+			break;
+
+		Point P1i, P2i;
+		P1i = SplinePos(c1, t1i),
+		V1 = SplineSpeed(c1, t1i),
+		A1 = SplineAccel(c1, t1i),
+		P2i = SplinePos(c2, t2i),
+		V2 = SplineSpeed(c2, t2i),
+		A2 = SplineAccel(c2, t2i),
+		dP = P1i - P2i;
+		float d2i = dP * dP;
+		if( d2i >= d2 ) // wrong convergence, bad initial solution
+			break;
+		Point
+			dP1 = P1 - P1i,
+			dP2 = P2 - P2i;
+		P1 = P1i;
+		P2 = P2i;
+		d2 = d2i;
+		t1 = t1i;
+		t2 = t2i;
+		if( d2 <= eps2 )
+			break;
+		float diff2 = dP1 * dP1 + dP2 * dP2;
+		if( diff2 <= eps2 ) // no movement
+			break;
+	}
+	return d2;
+}
+
+// Descends from the seeds pfT1, pfT2, which get where the descents end and pfD2 their distances, up to the first
+// block of seeds where one ends within eps2. The arrays are padded to 8 seeds. Returns the number of seeds run.
+typedef int (*SplineProc)(const Point *c1, const Point *c2, float eps2, float *pfT1, float *pfT2, float *pfD2, int nCount);
+
+static int SplineScalar(const Point *c1, const Point *c2, float eps2, float *pfT1, float *pfT2, float *pfD2, int nCount)
+{
+	for(int i = 0; i < nCount; i++)
+	{
+		pfD2[i] = SplineDescent(c1, c2, eps2, pfT1[i], pfT2[i]);
+		if( pfD2[i] <= eps2 ) // collision
+			return i + 1;
+	}
+	return nCount;
+}
+
+#ifdef FAST_MATH_SSE
+// The coefficients of a spline for SplinePos, SplineSpeed and SplineAccel, x, y and z in turn:
+// c0, c1, c2, c3, c3 * 1.5, c3 * 6 and c2 * 2
+static inline void SplineLaneCoefs(const Point *c, float *pfCoefs)
+{
+	for(int i = 0; i < 3; i++)
+	{
+		const float c0 = (&c[0].x)[i], c1 = (&c[1].x)[i], c2 = (&c[2].x)[i], c3 = (&c[3].x)[i];
+		float *p = pfCoefs + 7 * i;
+		p[0] = c0; p[1] = c1; p[2] = c2; p[3] = c3;
+		p[4] = c3 * 1.5f; p[5] = c3 * 6.0f; p[6] = c2 * 2.0f;
+	}
+}
+
+struct Point4
+{
+	__m128 x, y, z;
+};
+
+static inline __m128 Dot(const Point4 &a, const Point4 &b)
+{
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+}
+
+static inline Point4 Sub(const Point4 &a, const Point4 &b)
+{
+	const Point4 r = { _mm_sub_ps(a.x, b.x), _mm_sub_ps(a.y, b.y), _mm_sub_ps(a.z, b.z) };
+	return r;
+}
+
+static inline Point4 Select(__m128 mask, const Point4 &a, const Point4 &b)
+{
+	const Point4 r = { Select(mask, a.x, b.x), Select(mask, a.y, b.y), Select(mask, a.z, b.z) };
+	return r;
+}
+
+// SplinePos of the lanes, and SplineSpeed with SplineAccel. The kernels keep only the positions from
+// a step to the next and work the rest out again, since it would not stay in the registers.
+static inline void SplinePosSse(const __m128 *c, __m128 t, Point4 &P)
+{
+	for(int i = 0; i < 3; i++, c += 7)
+		(&P.x)[i] = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(c[3], t), c[2]), t), c[1]), t), c[0]);
+}
+
+static inline void SplineSpeedSse(const __m128 *c, __m128 t, Point4 &V, Point4 &A)
+{
+	for(int i = 0; i < 3; i++, c += 7)
+	{
+		(&V.x)[i] = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(c[4], t), c[2]), _mm_set1_ps(2.0f)), t), c[1]);
+		(&A.x)[i] = _mm_add_ps(_mm_mul_ps(c[5], t), c[6]);
+	}
+}
+
+static int SplineSse(const Point *c1, const Point *c2, float eps2, float *pfT1, float *pfT2, float *pfD2, int nCount)
+{
+	float pfCoefs[42];
+	SplineLaneCoefs(c1, pfCoefs);
+	SplineLaneCoefs(c2, pfCoefs + 21);
+	__m128 vc1[21], vc2[21];
+	for(int i = 0; i < 21; i++)
+	{
+		vc1[i] = _mm_set1_ps(pfCoefs[i]);
+		vc2[i] = _mm_set1_ps(pfCoefs[21 + i]);
+	}
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), sign = _mm_set1_ps(-0.0f);
+	const __m128 minDet = _mm_set1_ps(MIN_HESSIAN_DET), veps2 = _mm_set1_ps(eps2);
+	for(int i = 0; i < nCount; i += 4)
+	{
+		__m128 t1 = _mm_loadu_ps(pfT1 + i), t2 = _mm_loadu_ps(pfT2 + i);
+		Point4 P1, P2;
+		SplinePosSse(vc1, t1, P1);
+		SplinePosSse(vc2, t2, P2);
+		Point4 dP = Sub(P1, P2);
+		__m128 d2 = Dot(dP, dP);
+		// the lanes still descending
+		__m128 active = _mm_cmpeq_ps(zero, zero);
+		for(;;)
+		{
+			Point4 V1, A1, V2, A2;
+			SplineSpeedSse(vc1, t1, V1, A1);
+			SplineSpeedSse(vc2, t2, V2, A2);
+			__m128 S1 = Dot(V1, dP), S2 = _mm_xor_ps(Dot(V2, dP), sign);
+			const __m128 fixed1 = _mm_or_ps(_mm_and_ps(_mm_cmpeq_ps(t1, zero), _mm_cmpgt_ps(S1, zero)),
+				_mm_and_ps(_mm_cmpeq_ps(t1, one), _mm_cmplt_ps(S1, zero)));
+			const __m128 fixed2 = _mm_or_ps(_mm_and_ps(_mm_cmpeq_ps(t2, zero), _mm_cmpgt_ps(S2, zero)),
+				_mm_and_ps(_mm_cmpeq_ps(t2, one), _mm_cmplt_ps(S2, zero)));
+			S1 = _mm_andnot_ps(fixed1, S1);
+			S2 = _mm_andnot_ps(fixed2, S2);
+			const __m128 H12 = _mm_andnot_ps(_mm_or_ps(fixed1, fixed2), _mm_xor_ps(Dot(V1, V2), sign));
+			const __m128 H11 = Select(fixed1, one, _mm_add_ps(Dot(V1, V1), Dot(A1, dP)));
+			const __m128 H22 = Select(fixed2, one, _mm_sub_ps(Dot(V2, V2), Dot(A2, dP)));
+			const __m128 det = _mm_sub_ps(_mm_mul_ps(H11, H22), _mm_mul_ps(H12, H12));
+			active = _mm_andnot_ps(_mm_or_ps(_mm_and_ps(fixed1, fixed2),
+				_mm_or_ps(_mm_cmplt_ps(det, minDet), _mm_cmplt_ps(H11, zero))), active);
+			if( !_mm_movemask_ps(active) )
+				break;
+			const __m128 fact = _mm_div_ps(one, det);
+			__m128 t1i = _mm_add_ps(t1, _mm_mul_ps(fact, _mm_sub_ps(_mm_mul_ps(H12, S2), _mm_mul_ps(H22, S1))));
+			__m128 t2i = _mm_add_ps(t2, _mm_mul_ps(fact, _mm_sub_ps(_mm_mul_ps(H12, S1), _mm_mul_ps(H11, S2))));
+			const __m128 low1 = _mm_cmplt_ps(t1i, zero), high1 = _mm_cmpgt_ps(t1i, one);
+			const __m128 low2 = _mm_cmplt_ps(t2i, zero), high2 = _mm_cmpgt_ps(t2i, one);
+			t1i = Select(low1, zero, Select(high1, one, t1i));
+			t2i = Select(low2, zero, Select(high2, one, t2i));
+			const __m128 clamped = _mm_or_ps(_mm_or_ps(low1, high1), _mm_or_ps(low2, high2));
+			active = _mm_andnot_ps(_mm_and_ps(clamped, _mm_and_ps(_mm_cmpeq_ps(t1, t1i), _mm_cmpeq_ps(t2, t2i))), active);
+			if( !_mm_movemask_ps(active) )
+				break;
+
+			Point4 P1i, P2i;
+			SplinePosSse(vc1, t1i, P1i);
+			SplinePosSse(vc2, t2i, P2i);
+			const Point4 dPi = Sub(P1i, P2i);
+			const __m128 d2i = Dot(dPi, dPi);
+			active = _mm_andnot_ps(_mm_cmpge_ps(d2i, d2), active);
+			if( !_mm_movemask_ps(active) )
+				break;
+			const Point4 dP1 = Sub(P1, P1i), dP2 = Sub(P2, P2i);
+			const __m128 diff2 = _mm_add_ps(Dot(dP1, dP1), Dot(dP2, dP2));
+			P1 = Select(active, P1i, P1);
+			P2 = Select(active, P2i, P2);
+			dP = Select(active, dPi, dP);
+			d2 = Select(active, d2i, d2);
+			t1 = Select(active, t1i, t1);
+			t2 = Select(active, t2i, t2);
+			active = _mm_andnot_ps(_mm_or_ps(_mm_cmple_ps(d2i, veps2), _mm_cmple_ps(diff2, veps2)), active);
+			if( !_mm_movemask_ps(active) )
+				break;
+		}
+		_mm_storeu_ps(pfT1 + i, t1);
+		_mm_storeu_ps(pfT2 + i, t2);
+		_mm_storeu_ps(pfD2 + i, d2);
+		if( _mm_movemask_ps(_mm_cmple_ps(d2, veps2)) ) // collision
+			return min(i + 4, nCount);
+	}
+	return nCount;
+}
+
+struct Point8
+{
+	__m256 x, y, z;
+};
+
+MATH_TARGET_AVX static inline __m256 Dot(const Point8 &a, const Point8 &b)
+{
+	return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a.x, b.x), _mm256_mul_ps(a.y, b.y)), _mm256_mul_ps(a.z, b.z));
+}
+
+MATH_TARGET_AVX static inline Point8 Sub(const Point8 &a, const Point8 &b)
+{
+	const Point8 r = { _mm256_sub_ps(a.x, b.x), _mm256_sub_ps(a.y, b.y), _mm256_sub_ps(a.z, b.z) };
+	return r;
+}
+
+MATH_TARGET_AVX static inline Point8 Select(__m256 mask, const Point8 &a, const Point8 &b)
+{
+	const Point8 r = { Select(mask, a.x, b.x), Select(mask, a.y, b.y), Select(mask, a.z, b.z) };
+	return r;
+}
+
+MATH_TARGET_AVX static inline void SplinePosAvx(const __m256 *c, __m256 t, Point8 &P)
+{
+	for(int i = 0; i < 3; i++, c += 7)
+		(&P.x)[i] = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(c[3], t), c[2]), t), c[1]), t), c[0]);
+}
+
+MATH_TARGET_AVX static inline void SplineSpeedAvx(const __m256 *c, __m256 t, Point8 &V, Point8 &A)
+{
+	for(int i = 0; i < 3; i++, c += 7)
+	{
+		(&V.x)[i] = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(c[4], t), c[2]), _mm256_set1_ps(2.0f)), t), c[1]);
+		(&A.x)[i] = _mm256_add_ps(_mm256_mul_ps(c[5], t), c[6]);
+	}
+}
+
+// Up to 4 seeds go to the SSE kernel, the lanes of a half empty vector would only wait for the others
+MATH_TARGET_AVX static int SplineAvx(const Point *c1, const Point *c2, float eps2, float *pfT1, float *pfT2, float *pfD2, int nCount)
+{
+	if( nCount <= 4 )
+		return SplineSse(c1, c2, eps2, pfT1, pfT2, pfD2, nCount);
+	float pfCoefs[42];
+	SplineLaneCoefs(c1, pfCoefs);
+	SplineLaneCoefs(c2, pfCoefs + 21);
+	__m256 vc1[21], vc2[21];
+	for(int i = 0; i < 21; i++)
+	{
+		vc1[i] = _mm256_set1_ps(pfCoefs[i]);
+		vc2[i] = _mm256_set1_ps(pfCoefs[21 + i]);
+	}
+	const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), sign = _mm256_set1_ps(-0.0f);
+	const __m256 minDet = _mm256_set1_ps(MIN_HESSIAN_DET), veps2 = _mm256_set1_ps(eps2);
+	for(int i = 0; i < nCount; i += 8)
+	{
+		__m256 t1 = _mm256_loadu_ps(pfT1 + i), t2 = _mm256_loadu_ps(pfT2 + i);
+		Point8 P1, P2;
+		SplinePosAvx(vc1, t1, P1);
+		SplinePosAvx(vc2, t2, P2);
+		Point8 dP = Sub(P1, P2);
+		__m256 d2 = Dot(dP, dP);
+		__m256 active = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+		for(;;)
+		{
+			Point8 V1, A1, V2, A2;
+			SplineSpeedAvx(vc1, t1, V1, A1);
+			SplineSpeedAvx(vc2, t2, V2, A2);
+			__m256 S1 = Dot(V1, dP), S2 = _mm256_xor_ps(Dot(V2, dP), sign);
+			const __m256 fixed1 = _mm256_or_ps(
+				_mm256_and_ps(_mm256_cmp_ps(t1, zero, _CMP_EQ_OQ), _mm256_cmp_ps(S1, zero, _CMP_GT_OQ)),
+				_mm256_and_ps(_mm256_cmp_ps(t1, one, _CMP_EQ_OQ), _mm256_cmp_ps(S1, zero, _CMP_LT_OQ)));
+			const __m256 fixed2 = _mm256_or_ps(
+				_mm256_and_ps(_mm256_cmp_ps(t2, zero, _CMP_EQ_OQ), _mm256_cmp_ps(S2, zero, _CMP_GT_OQ)),
+				_mm256_and_ps(_mm256_cmp_ps(t2, one, _CMP_EQ_OQ), _mm256_cmp_ps(S2, zero, _CMP_LT_OQ)));
+			S1 = _mm256_andnot_ps(fixed1, S1);
+			S2 = _mm256_andnot_ps(fixed2, S2);
+			const __m256 H12 = _mm256_andnot_ps(_mm256_or_ps(fixed1, fixed2), _mm256_xor_ps(Dot(V1, V2), sign));
+			const __m256 H11 = Select(fixed1, one, _mm256_add_ps(Dot(V1, V1), Dot(A1, dP)));
+			const __m256 H22 = Select(fixed2, one, _mm256_sub_ps(Dot(V2, V2), Dot(A2, dP)));
+			const __m256 det = _mm256_sub_ps(_mm256_mul_ps(H11, H22), _mm256_mul_ps(H12, H12));
+			active = _mm256_andnot_ps(_mm256_or_ps(_mm256_and_ps(fixed1, fixed2),
+				_mm256_or_ps(_mm256_cmp_ps(det, minDet, _CMP_LT_OQ), _mm256_cmp_ps(H11, zero, _CMP_LT_OQ))), active);
+			if( !_mm256_movemask_ps(active) )
+				break;
+			const __m256 fact = _mm256_div_ps(one, det);
+			__m256 t1i = _mm256_add_ps(t1, _mm256_mul_ps(fact, _mm256_sub_ps(_mm256_mul_ps(H12, S2), _mm256_mul_ps(H22, S1))));
+			__m256 t2i = _mm256_add_ps(t2, _mm256_mul_ps(fact, _mm256_sub_ps(_mm256_mul_ps(H12, S1), _mm256_mul_ps(H11, S2))));
+			const __m256 low1 = _mm256_cmp_ps(t1i, zero, _CMP_LT_OQ), high1 = _mm256_cmp_ps(t1i, one, _CMP_GT_OQ);
+			const __m256 low2 = _mm256_cmp_ps(t2i, zero, _CMP_LT_OQ), high2 = _mm256_cmp_ps(t2i, one, _CMP_GT_OQ);
+			t1i = Select(low1, zero, Select(high1, one, t1i));
+			t2i = Select(low2, zero, Select(high2, one, t2i));
+			const __m256 clamped = _mm256_or_ps(_mm256_or_ps(low1, high1), _mm256_or_ps(low2, high2));
+			active = _mm256_andnot_ps(_mm256_and_ps(clamped,
+				_mm256_and_ps(_mm256_cmp_ps(t1, t1i, _CMP_EQ_OQ), _mm256_cmp_ps(t2, t2i, _CMP_EQ_OQ))), active);
+			if( !_mm256_movemask_ps(active) )
+				break;
+
+			Point8 P1i, P2i;
+			SplinePosAvx(vc1, t1i, P1i);
+			SplinePosAvx(vc2, t2i, P2i);
+			const Point8 dPi = Sub(P1i, P2i);
+			const __m256 d2i = Dot(dPi, dPi);
+			active = _mm256_andnot_ps(_mm256_cmp_ps(d2i, d2, _CMP_GE_OQ), active);
+			if( !_mm256_movemask_ps(active) )
+				break;
+			const Point8 dP1 = Sub(P1, P1i), dP2 = Sub(P2, P2i);
+			const __m256 diff2 = _mm256_add_ps(Dot(dP1, dP1), Dot(dP2, dP2));
+			P1 = Select(active, P1i, P1);
+			P2 = Select(active, P2i, P2);
+			dP = Select(active, dPi, dP);
+			d2 = Select(active, d2i, d2);
+			t1 = Select(active, t1i, t1);
+			t2 = Select(active, t2i, t2);
+			active = _mm256_andnot_ps(_mm256_or_ps(_mm256_cmp_ps(d2i, veps2, _CMP_LE_OQ), _mm256_cmp_ps(diff2, veps2, _CMP_LE_OQ)), active);
+			if( !_mm256_movemask_ps(active) )
+				break;
+		}
+		_mm256_storeu_ps(pfT1 + i, t1);
+		_mm256_storeu_ps(pfT2 + i, t2);
+		_mm256_storeu_ps(pfD2 + i, d2);
+		if( _mm256_movemask_ps(_mm256_cmp_ps(d2, veps2, _CMP_LE_OQ)) ) // collision
+			return min(i + 8, nCount);
+	}
+	return nCount;
+}
+
+static const SplineProc splineProcs[] = { SplineScalar, SplineSse, SplineAvx };
+#else
+static const SplineProc splineProcs[] = { SplineScalar };
+#endif
+
+// Bounding box of a piece of a spline, from the control points of the piece: its ends pa and pb,
+// their speeds va and vb and its length in t
+static void SplinePieceBox(const Point &pa, const Point &va, const Point &pb, const Point &vb, float fLen, Point &ptMin, Point &ptMax)
+{
+	const float h = fLen / 3;
+	const Point pt[4] = { pa, pa + va * h, pb - vb * h, pb };
+	ptMin = ptMax = pt[0];
+	for(int i = 1; i < 4; i++)
+	{
+		ptMin = Point(min(ptMin.x, pt[i].x), min(ptMin.y, pt[i].y), min(ptMin.z, pt[i].z));
+		ptMax = Point(max(ptMax.x, pt[i].x), max(ptMax.y, pt[i].y), max(ptMax.z, pt[i].z));
+	}
+}
+
+static float DistBoxBox2(const Point &ptMin1, const Point &ptMax1, const Point &ptMin2, const Point &ptMax2)
+{
+	const float
+		dx = max(0.0f, max(ptMin1.x - ptMax2.x, ptMin2.x - ptMax1.x)),
+		dy = max(0.0f, max(ptMin1.y - ptMax2.y, ptMin2.y - ptMax1.y)),
+		dz = max(0.0f, max(ptMin1.z - ptMax2.z, ptMin2.z - ptMax1.z));
+	return dx * dx + dy * dy + dz * dz;
+}
+
 float DistSplineSpline2(
 	const Point *ptSpline1, const Point *ptSpline2,
 	float fPrecision,
@@ -94,105 +881,73 @@ float DistSplineSpline2(
 		eps2 = fPrecision > 0 ? (fPrecision * fPrecision) : min(GetSplineEps2(ptSpline1), GetSplineEps2(ptSpline2)),
 		mindist2 = FLT_MAX,
 		mint1 = 0.0f, mint2 = 0.0f;
-	int iters = 0;
-	bool bCollision = false;
-
-	const static float fInitSol[][2] = { // initial solutions
-		{ 0.00f, 0.00f }, { 0.00f, 0.33f }, { 0.00f, 0.66f }, { 0.00f, 1.00f },
-		{ 0.33f, 0.00f }, { 0.33f, 0.33f }, { 0.33f, 0.66f }, { 0.33f, 1.00f },
-		{ 0.66f, 0.00f }, { 0.66f, 0.33f }, { 0.66f, 0.66f }, { 0.66f, 1.00f },
-		{ 1.00f, 0.00f }, { 1.00f, 0.33f }, { 1.00f, 0.66f }, { 1.00f, 1.00f },
-	};
 
 	Point c1[4], c2[4];
 	SplineCoefs(ptSpline1, c1);
 	SplineCoefs(ptSpline2, c2);
 
-	for(int i=0; i < ArrSize(fInitSol); i++)
+	// The seeds cut the splines in pieces, each inside the box of the control points of the piece. A seed is dropped
+	// when the boxes of the pieces around it are all farther from each other than the nearest two seeds: then any
+	// pair of pieces that may hold nearer points keeps the four seeds at its corners.
+	Point pt1[SPLINE_SEEDS], pt2[SPLINE_SEEDS], ptMin1[SPLINE_SEEDS - 1], ptMax1[SPLINE_SEEDS - 1], ptMin2[SPLINE_SEEDS - 1], ptMax2[SPLINE_SEEDS - 1];
+	Point v1Last, v2Last;
+	for(int i = 0; i < SPLINE_SEEDS; i++)
 	{
-		float
-			t1 = fInitSol[i][0],
-			t2 = fInitSol[i][1];
-		Point
-			P1 = SplinePos(c1, t1),
-			V1 = SplineSpeed(c1, t1),
-			A1 = SplineAccel(c1, t1),
-			P2 = SplinePos(c2, t2),
-			V2 = SplineSpeed(c2, t2),
-			A2 = SplineAccel(c2, t2),
-			dP = P1 - P2;
-		iters++;
-		float d2 = dP * dP;
-		for(;;)
+		const Point v1 = SplineSpeed(c1, splineSeeds[i]), v2 = SplineSpeed(c2, splineSeeds[i]);
+		pt1[i] = SplinePos(c1, splineSeeds[i]);
+		pt2[i] = SplinePos(c2, splineSeeds[i]);
+		if( i > 0 )
 		{
-			/* Gauss - Newton (the fastest iterative method, BUT may deviate if the initial solution is too far away from the real solution)
-
-												| V1.V1 + A1.dP      -V1.V2     |* | V1.dP |
-			t(k+1) = t(k) - H*(k).S(k) = t(k) - |                               | .|       |
-												|    -V1.V2       V2.V2 - A2.dP |  |-V2.dP |                                 
-			dP = P1 - P2
-			*/
-			float
-				H12 = -(V1 * V2),
-				H11 = V1 * V1 + A1 * dP,
-				H22 = V2 * V2 - A2 * dP,
-				det = H11 * H22 - H12 * H12;
-			if( det < MIN_HESSIAN_DET || H11 < 0 ) // the hessian has to be positive definite so that there is a minimum
-				break;
-			float
-				S1 = V1 * dP,
-				S2 = -(V2 * dP),
-				fact = 1.0f / det,
-				t1i = t1 + fact * ( H12 * S2 - H22 * S1 ),
-				t2i = t2 + fact * ( H12 * S1 - H11 * S2 );
-
-			// check if the next step is somewhere outside
-			bool bClamped = false;
-			if( t1i < 0 ) { t1i = 0; bClamped = true; }
-			else if( t1i > 1 ) { t1i = 1; bClamped = true; }
-			if( t2i < 0 ) { t2i = 0; bClamped = true; }
-			else if( t2i > 1 ) { t2i = 1; bClamped = true; }
-			if( bClamped && t1 == t1i && t2 == t2i )
-				break;
+			const float fLen = splineSeeds[i] - splineSeeds[i - 1];
+			SplinePieceBox(pt1[i - 1], v1Last, pt1[i], v1, fLen, ptMin1[i - 1], ptMax1[i - 1]);
+			SplinePieceBox(pt2[i - 1], v2Last, pt2[i], v2, fLen, ptMin2[i - 1], ptMax2[i - 1]);
+		}
+		v1Last = v1;
+		v2Last = v2;
+	}
+	float fSeedDist2 = FLT_MAX, fPieceDist2[SPLINE_SEEDS - 1][SPLINE_SEEDS - 1];
+	for(int i = 0; i < SPLINE_SEEDS; i++)
+		for(int j = 0; j < SPLINE_SEEDS; j++)
+			fSeedDist2 = min(fSeedDist2, pt1[i].Dist2(pt2[j]));
+	for(int i = 0; i < SPLINE_SEEDS - 1; i++)
+		for(int j = 0; j < SPLINE_SEEDS - 1; j++)
+			fPieceDist2[i][j] = DistBoxBox2(ptMin1[i], ptMax1[i], ptMin2[j], ptMax2[j]);
 
-			Point P1i, P2i;
-			P1i = SplinePos(c1, t1i),
-			V1 = SplineSpeed(c1, t1i),
-			A1 = SplineAccel(c1, t1i),
-			P2i = SplinePos(c2, t2i),
-			V2 = SplineSpeed(c2, t2i),
-			A2 = SplineAccel(c2, t2i),
-			iters++;
-			dP = P1i - P2i;
-			float d2i = dP * dP;
-			if( d2i >= d2 ) // wrong convergence, bad initial solution
-				break;
-			Point
-				dP1 = P1 - P1i,
-				dP2 = P2 - P2i;
-			P1 = P1i;
-			P2 = P2i;
-			d2 = d2i;
-			t1 = t1i;
-			t2 = t2i;
-			if( d2 <= eps2 || bClamped )
-				break;
-			float diff2 = dP1 * dP1 + dP2 * dP2;
-			if( diff2 <= eps2 ) // no movement
-				break;
+	// the seeds kept, in order, padded with the last one for the vectors
+	float pfT1[SPLINE_SEEDS * SPLINE_SEEDS + 8], pfT2[SPLINE_SEEDS * SPLINE_SEEDS + 8], pfD2[SPLINE_SEEDS * SPLINE_SEEDS + 8];
+	int nCount = 0;
+	for(int i = 0; i < SPLINE_SEEDS; i++)
+		for(int j = 0; j < SPLINE_SEEDS; j++)
+		{
+			float fDist2 = FLT_MAX;
+			for(int a = max(i - 1, 0); a <= min(i, SPLINE_SEEDS - 2); a++)
+				for(int b = max(j - 1, 0); b <= min(j, SPLINE_SEEDS - 2); b++)
+					fDist2 = min(fDist2, fPieceDist2[a][b]);
+			if( fDist2 > fSeedDist2 )
+				continue;
+			pfT1[nCount] = splineSeeds[i];
+			pfT2[nCount] = splineSeeds[j];
+			nCount++;
 		}
-		if( mindist2 > d2 )
+	ASSERT(nCount > 0);
+	for(int i = nCount; i < nCount + 8; i++)
+	{
+		pfT1[i] = pfT1[nCount - 1];
+		pfT2[i] = pfT2[nCount - 1];
+	}
+
+	const int nRun = splineProcs[nMathSimd](c1, c2, eps2, pfT1, pfT2, pfD2, nCount);
+	for(int i = 0; i < nRun; i++)
+	{
+		if( mindist2 > pfD2[i] )
 		{
-			mindist2 = d2;
-			mint1 = t1;
-			mint2 = t2;
+			mindist2 = pfD2[i];
+			mint1 = pfT1[i];
+			mint2 = pfT2[i];
 			if( mindist2 <= eps2 ) // collision
-				bCollision = true;
+				break;
 		}
-		if( bCollision )
-			break;
 	}
-	ASSERT(iters < 10*ArrSize(fInitSol));
 	if( k1 ) *k1 = mint1;
 	if( k2 ) *k2 = mint2;
 	return mindist2;
@@ -211,7 +966,7 @@ float DistSplinePoint2(
 	Point P2 = ptPos, P2i = P2, c[4];
 	SplineCoefs(ptSpline, c);
 	static float fInitSol[] = { 0.0f, 0.25f, 0.5f, 0.75f, 1.0f };
-	for(int i=0; i < ArrSize(fInitSol); i++)
+	for(int i=0; i < (int)ArrSize(fInitSol); i++)
 	{
 		float t = fInitSol[i];
 		Point 
@@ -270,4 +1025,87 @@ float DistSplinePoint2(
 	ASSERT(iters < 10*ArrSize(fInitSol));
 	if( k ) *k = mint;
 	return mindist2;
-}
\ No newline at end of file
+}
+
+// 5 point Gauss-Legendre on [-1, 1], exact for the polynomials up to degree 9
+static const float gaussNodes[5] = { 0.0f, -0.5384693101f, 0.5384693101f, -0.9061798459f, 0.9061798459f };
+static const float gaussWeights[5] = { 0.5688888889f, 0.4786286705f, 0.4786286705f, 0.2369268851f, 0.2369268851f };
+
+SplineArc::SplineArc(): m_nBuilds(0)
+{
+	ZeroMemory(m_fLens, sizeof(m_fLens));
+}
+
+SplineArc::SplineArc(const Point *ptSpline): m_nBuilds(0)
+{
+	ZeroMemory(m_fLens, sizeof(m_fLens));
+	SetSpline(ptSpline);
+}
+
+float SplineArc::Integrate(float a, float b) const
+{
+	const float h = (b - a) / 2, m = (a + b) / 2;
+	float fLen = 0;
+	for(int i = 0; i < 5; i++)
+		fLen += gaussWeights[i] * sqrtf(SplineSpeed(m_coefs, m + h * gaussNodes[i]).Len2());
+	return fLen * h;
+}
+
+void SplineArc::SetSpline(const Point *ptSpline)
+{
+	if( m_nBuilds && !memcmp(m_pt, ptSpline, sizeof(m_pt)) )
+		return;
+	memcpy(m_pt, ptSpline, sizeof(m_pt));
+	SplineCoefs(m_pt, m_coefs);
+	m_fLens[0] = 0;
+	for(int i = 0; i < SPLINE_ARC_PIECES; i++)
+		m_fLens[i + 1] = m_fLens[i] + Integrate((float)i / SPLINE_ARC_PIECES, (float)(i + 1) / SPLINE_ARC_PIECES);
+	m_nBuilds++;
+}
+
+float SplineArc::GetDist(float t) const
+{
+	if( t <= 0 )
+		return 0;
+	if( t >= 1 )
+		return GetLen();
+	const int i = min(Trunc(t * SPLINE_ARC_PIECES), SPLINE_ARC_PIECES - 1);
+	return m_fLens[i] + Integrate((float)i / SPLINE_ARC_PIECES, t);
+}
+
+float SplineArc::GetT(float fDist) const
+{
+	if( fDist <= 0 )
+		return 0;
+	if( fDist >= GetLen() )
+		return 1;
+	// the piece with m_fLens[i] <= fDist < m_fLens[i + 1]
+	int i = 0, j = SPLINE_ARC_PIECES;
+	while( j - i > 1 )
+	{
+		const int m = (i + j) / 2;
+		if( m_fLens[m] <= fDist )
+			i = m;
+		else
+			j = m;
+	}
+	// Newton steps from the linear guess, kept within the piece by halving it where a step would leave it,
+	// as they would where the spline almost stops
+	const float a = (float)i / SPLINE_ARC_PIECES, fEps = GetLen() * 1e-6f;
+	float lo = a, hi = (float)(i + 1) / SPLINE_ARC_PIECES;
+	float t = a + (hi - lo) * (fDist - m_fLens[i]) / (m_fLens[i + 1] - m_fLens[i]);
+	for(int iters = 0; iters < 8; iters++)
+	{
+		const float f = m_fLens[i] + Integrate(a, t) - fDist;
+		if( fabsf(f) <= fEps )
+			break;
+		if( f > 0 )
+			hi = t;
+		else
+			lo = t;
+		const float fSpeed = sqrtf(SplineSpeed(m_coefs, t).Len2());
+		const float tNext = t - f / fSpeed;
+		t = fSpeed > 0 && tNext > lo && tNext < hi ? tNext : (lo + hi) / 2;
+	}
+	return t;
+}
@@ -1,32 +1,44 @@
 #ifndef __MATH_H_
 #define __MATH_H_
-#include "utils.h"
+#include <math.h>
+#include <float.h>
+#include "Utils.h"
+#include "Fixed.h"
 
-struct Point
+inline float Sqrt(float x) { return sqrtf(x); }
+inline float Abs(float x) { return fabsf(x); }
+inline float InvSqrt(float x) { return FastInvSqrt(x); }
+inline int Floor(float x) { return (int)floorf(x); }
+
+// T is float for everything drawn and Fixed for the deterministic simulation
+template<class T>
+struct PointT
 {
-	float x, y, z;
-	Point():x(0), y(0), z(0){}
-	Point(float x0, float y0, float z0 = 0):x(x0), y(y0), z(z0){}
-	float Dot(const Point &pt) const { return x * pt.x + y * pt.y + z * pt.z; }
-	Point Cross(const Point &pt) const { return Point(z * pt.x - x * pt.y, y * pt.z - z * pt.y, x * pt.y - y * pt.x); }
-	float Len2() const { return x * x + y * y + z * z; }
-	float Dist2(const Point &pt) const { float dx = x - pt.x, dy = y - pt.y, dz = z - pt.z; return dx * dx + dy * dy + dz * dz; }
-	Point Normalize() const { float l2 = Len2(); ASSERT(l2 != 0); float r = 1 / sqrtf(l2); return Point(x * r, y * r, z * r); }
-	float Angle(const Point &pt) const { float l2 = Len2() * pt.Len2(); ASSERT( l2 != 0 ); return (180 / PI) * acosf(Dot(pt) / sqrtf(l2)); }
-	Point operator -() const {  return Point(-x, -y, -z); }
+	T x, y, z;
+	PointT():x(0), y(0), z(0){}
+	PointT(T x0, T y0, T z0 = 0):x(x0), y(y0), z(z0){}
+	T Dot(const PointT &pt) const { return x * pt.x + y * pt.y + z * pt.z; }
+	PointT Cross(const PointT &pt) const { return PointT(y * pt.z - z * pt.y, z * pt.x - x * pt.z, x * pt.y - y * pt.x); }
+	T Len2() const { return x * x + y * y + z * z; }
+	T Dist2(const PointT &pt) const { T dx = x - pt.x, dy = y - pt.y, dz = z - pt.z; return dx * dx + dy * dy + dz * dz; }
+	PointT Normalize() const { T l2 = Len2(); ASSERT(l2 != 0); T r = 1 / Sqrt(l2); return PointT(x * r, y * r, z * r); }
+	float Angle(const PointT &pt) const { T l2 = Len2() * pt.Len2(); ASSERT( l2 != 0 ); return (180 / PI) * acosf((float)(Dot(pt) / Sqrt(l2))); }
+	PointT operator -() const {  return PointT(-x, -y, -z); }
+
+	friend PointT operator +(const PointT &pt1, const PointT &pt2) { return PointT(pt1.x + pt2.x, pt1.y + pt2.y, pt1.z + pt2.z); }
+	friend PointT operator -(const PointT &pt1, const PointT &pt2) { return PointT(pt1.x - pt2.x, pt1.y - pt2.y, pt1.z - pt2.z); }
+	friend T operator *(const PointT &pt1, const PointT &pt2) { return pt1.Dot(pt2); }
+	friend PointT operator *(const PointT &pt, T n) { return PointT(pt.x * n, pt.y * n, pt.z * n); }
+	friend PointT operator *(T n, const PointT &pt) { return PointT(pt.x * n, pt.y * n, pt.z * n); }
+	friend PointT operator /(const PointT &pt, T n) { return PointT(pt.x / n, pt.y / n, pt.z / n); }
 };
 
-inline Point operator +(const Point &pt1, const Point &pt2) { return Point(pt1.x + pt2.x, pt1.y + pt2.y, pt1.z + pt2.z); }
-inline Point operator -(const Point &pt1, const Point &pt2) { return Point(pt1.x - pt2.x, pt1.y - pt2.y, pt1.z - pt2.z); }
-inline float operator *(const Point &pt1, const Point &pt2) { return pt1.Dot(pt2); }
-inline Point operator *(const Point &pt, float n) { return Point(pt.x * n, pt.y * n, pt.z * n); }
-inline Point operator *(float n, const Point &pt) { return Point(pt.x * n, pt.y * n, pt.z * n); }
-inline Point operator /(const Point &pt, float n) { return Point(pt.x / n, pt.y / n, pt.z / n); }
+typedef PointT<float> Point;
 
 struct Quaternion {
 	float x, y, z, w;
-	Quaternion(): w(1), x(0), y(0), z(0) {}
-	Quaternion(float x, float y, float z, float w = 0): w(w), x(x), y(y), z(z) {}
+	Quaternion(): x(0), y(0), z(0), w(1) {}
+	Quaternion(float x, float y, float z, float w = 0): x(x), y(y), z(z), w(w) {}
 	Quaternion(const Point &ptAxis, float fDeg, bool bNormalized = false) 
 	{
 		float a = fDeg * PI / 360, u = sinf(a);
@@ -49,6 +61,7 @@ struct Quaternion {
 		return Quaternion(x * u, y * u, z * u, w * u);
 	}
 	Quaternion Inv() const { return Quaternion(-x, -y, -z, w); }
+	float Dot(const Quaternion &q) const { return x * q.x + y * q.y + z * q.z + w * q.w; }
 	// compose rotation
 	Quaternion operator *(const Quaternion &q) const 
 	{
@@ -59,12 +72,16 @@ struct Quaternion {
 			w * q.w - x * q.x - y * q.y - z * q.z);
 	}
 	Quaternion& operator *=(const Quaternion &q)  { return (*this = (*this) * q); }
-	// rotate a vector
+	// rotate a vector, by a normalized quaternion: q * pt * q.Inv() with the terms that cancel left out
 	Point operator *(const Point &pt) const 
 	{
-		Quaternion q = (*this) * Quaternion(pt.x, pt.y, pt.z) * this->Inv();
-		return Point(q.x, q.y, q.z);
+		const Point u(x, y, z), t = u.Cross(pt) * 2.0f;
+		return pt + t * w + u.Cross(t);
 	}
+	// The rotation of a normalized quaternion as a 3x3 matrix, row after row, and as a 4x4 matrix for OpenGL,
+	// column after column, moving by ptPos after the rotation
+	void GetMatrix3(float *pfMatrix) const;
+	void GetMatrix4(float *pfMatrix, const Point &ptPos = Point()) const;
 	float GetDeg() const 
 	{
 		ASSERT( w >= -1 && w <= 1 );
@@ -72,17 +89,59 @@ struct Quaternion {
 	}
 };
 
+// From q1 at t = 0 to q2 at t = 1 the short way round, both normalized. Slerp turns at a constant speed,
+// Nlerp is cheaper and turns faster in the middle, which is hardly seen for steps of a few degrees.
+Quaternion Slerp(const Quaternion &q1, const Quaternion &q2, float t);
+Quaternion Nlerp(const Quaternion &q1, const Quaternion &q2, float t);
+
+// instantiated for float and Fixed
+template<class T>
 bool IntersectSegmentSegment2D(
-	float x1a, float y1a, float x2a, float y2a,
-	float x1b, float y1b, float x2b, float y2b,
-	float *ka = NULL, float *kb = NULL);
+	T x1a, T y1a, T x2a, T y2a,
+	T x1b, T y1b, T x2b, T y2b,
+	T *ka = NULL, T *kb = NULL);
 
+template<class T>
 bool IntersectSegmentCircle2D(
-	float x1, float y1,
-	float x2, float y2,
-	float xc, float yc,
-	float rc,
-	float *k = NULL);
+	T x1, T y1,
+	T x2, T y2,
+	T xc, T yc,
+	T rc,
+	T *k = NULL);
+
+// Levels of the batch kernels below
+#define MATH_SIMD_SCALAR 0
+#define MATH_SIMD_SSE    1
+#define MATH_SIMD_AVX    2
+
+// The level the batch kernels run at: the highest the processor and the OS have, unless lowered. Off x86
+// it is always MATH_SIMD_SCALAR.
+int GetMathSimd();
+// Returns the level set, which is never above what the processor has
+int SetMathSimd(int nLevel);
+
+// One segment against up to 32 segments or circles in arrays of their coordinates, for narrowing down many
+// candidates at once. Bit i of the result is set when target i is hit; the hits and their k are the ones the
+// float IntersectSegmentSegment2D (k being ka) and IntersectSegmentCircle2D give, whatever the level.
+// pfMinK gets the least k of the hits and pnFirst its target, the lowest one on ties; both are left alone without hits.
+DWORD IntersectSegmentSegments2D(
+	float x1, float y1, float x2, float y2,
+	const float *pfX1, const float *pfY1, const float *pfX2, const float *pfY2, int nCount,
+	float *pfMinK = NULL, int *pnFirst = NULL);
+
+DWORD IntersectSegmentCircles2D(
+	float x1, float y1, float x2, float y2,
+	const float *pfXc, const float *pfYc, const float *pfRc, int nCount,
+	float *pfMinK = NULL, int *pnFirst = NULL);
+
+// Points rotated by a normalized quaternion through its matrix, ptIn and ptOut may be the same
+void RotatePoints(const Quaternion &q, const Point *ptIn, Point *ptOut, int nCount);
+// Points in arrays of their coordinates through a 4x4 matrix of Quaternion::GetMatrix4 or OpenGL, at the
+// SIMD level set, for many points at once. The results are the same whatever the level; the output arrays
+// may be the input ones.
+void TransformPoints(const float *pfMatrix,
+	const float *pfX, const float *pfY, const float *pfZ,
+	float *pfXOut, float *pfYOut, float *pfZOut, int nCount);
 
 float DistSegmentPoint2D2(
 	float x1, float y1,
@@ -142,4 +201,35 @@ inline float SplineLenEst( const Point *pt, float *fMinLen = NULL, float *fMaxLe
 	return ( fMin + fMax ) / 2;
 }
 
+#define SPLINE_ARC_PIECES 16
+
+// Arc length along a spline, for moving along it at a constant speed. The lengths at SPLINE_ARC_PIECES
+// even steps of t are summed by Gauss-Legendre quadrature when the control points are set, and kept until
+// they change; a distance finds its piece by a binary search and its t by Newton steps within the piece.
+class SplineArc
+{
+	Point m_pt[4], m_coefs[4];
+	float m_fLens[SPLINE_ARC_PIECES + 1]; // from t = 0 to the start of each piece, the last is the whole length
+	int m_nBuilds;
+
+	// Length of the spline from t = a to b
+	float Integrate(float a, float b) const;
+public:
+	SplineArc();
+	SplineArc(const Point *ptSpline);
+
+	// Takes the control points, the table is built again only if they are not the ones it has
+	void SetSpline(const Point *ptSpline);
+	const Point *GetCoefs() const { return m_coefs; }
+
+	float GetLen() const { return m_fLens[SPLINE_ARC_PIECES]; }
+	// Length from the start to t, within [0, 1]
+	float GetDist(float t) const;
+	// t at fDist from the start, clamped to the ends
+	float GetT(float fDist) const;
+	Point GetPos(float fDist) const { return SplinePos(m_coefs, GetT(fDist)); }
+	// Times the table was built
+	int GetBuilds() const { return m_nBuilds; }
+};
+
 #endif __MATH_H_
\ No newline at end of file
@@ -0,0 +1,358 @@
+#include "Particles.h"
+#include "Simulation.h"
+#include "Profile.h"
+#include <math.h>
+
+const ParticleParams parDefault =
+{
+	0.0f,
+	5.0f, 3.0f,
+	1.0f, 2.0f,
+	0.0f, -1.5f, 0.0f,
+	0.05f,
+	0.05f, 0.5f,
+	6.0f,
+	-0.15f, -0.05f,
+	0.45f, 0.55f,
+	50.0f, -50.0f,
+	0, 0, 0
+};
+
+static const float pfParColors[12][3] =
+{
+	{1.0f,0.5f,0.5f}, {1.0f,0.75f,0.5f}, {1.0f,1.0f,0.5f}, {0.75f,1.0f,0.5f},
+	{0.5f,1.0f,0.5f}, {0.5f,1.0f,0.75f}, {0.5f,1.0f,1.0f}, {0.5f,0.75f,1.0f},
+	{0.5f,0.5f,1.0f}, {0.75f,0.5f,1.0f}, {1.0f,0.5f,1.0f}, {1.0f,0.5f,0.75f}
+};
+
+void ParticlesUpdate(Particle *pParticles, int nCount, const ParticleParams &params, float dt, RandGen &gen)
+{
+	PROF_SCOPE(PROF_TIME_PARTICLES);
+	dt /= expf(0.69314718056f * params.fSlowdown);
+	const float fFriction = params.fFriction;
+	for(int i = 0; i < nCount; i++)
+	{
+		Particle &par = pParticles[i];
+		if( par.alpha <= 0 || par.age > params.fMaxAge )
+		{
+			PROF_COUNT(PROF_RESPAWNS, 1);
+			par.age = 0;
+			par.alpha = gen.Next(0.0f, 1.0f);
+			par.fade = gen.Next(params.fFadeMin, params.fFadeMax);
+			par.resize = gen.Next(params.fResizeMin, params.fResizeMax);
+			par.rotate = gen.Next(params.fRotateMin, params.fRotateMax);
+			par.size = gen.Next(params.fSizeMin, params.fSizeMax);
+			par.x = params.fX0;
+			par.y = params.fY0;
+			par.z = params.fZ0;
+			float fAngle = gen.Next(0.0f, 2*PI);
+			float fSpeedInit = gen.Next(params.fSpeedInitMin, params.fSpeedInitMax);
+			par.vx = params.fSpeedX + fSpeedInit * cosf(fAngle);
+			par.vy = params.fSpeedY + fSpeedInit * sinf(fAngle);
+			par.vz = gen.Next(-fSpeedInit, fSpeedInit);
+			const float *fColor = pfParColors[(i / 100) % 12];
+			par.r = fColor[0];
+			par.g = fColor[1];
+			par.b = fColor[2];
+		}
+
+		par.x += par.vx * dt;
+		par.y += par.vy * dt;
+		par.z += par.vz * dt;
+
+		par.vx += (params.fAccelX - fFriction * par.vx) * dt;
+		par.vy += (params.fAccelY - fFriction * par.vy) * dt;
+		par.vz += (params.fAccelZ - fFriction * par.vz) * dt;
+
+		par.alpha -= par.fade * dt;
+		par.size += par.resize * dt;
+		par.angle += par.rotate * dt;
+		par.age += dt;
+	}
+}
+
+// A brick or mover near a cell of particles
+struct ParticleObstacle
+{
+	float x, y;
+	BrickShape eShape;
+};
+
+// The narrow phase takes four particles at a time in SSE registers on x86 and x64, and one at a time elsewhere
+#ifdef FAST_MATH_SSE
+static inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// Four particles off a round brick of radius r; hit lanes are pushed out to its surface and reflected if moving in
+static inline void BounceBall(__m128 &x, __m128 &y, __m128 &vx, __m128 &vy, __m128 bx, __m128 by, __m128 r, __m128 k, __m128 lanes)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 dx = _mm_sub_ps(x, bx), dy = _mm_sub_ps(y, by);
+	const __m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+	const __m128 hit = _mm_and_ps(lanes, _mm_and_ps(_mm_cmplt_ps(d2, _mm_mul_ps(r, r)), _mm_cmpgt_ps(d2, zero)));
+	if( !_mm_movemask_ps(hit) )
+		return;
+	const __m128 inv = _mm_rsqrt_ps(d2);
+	const __m128 nx = _mm_mul_ps(dx, inv), ny = _mm_mul_ps(dy, inv);
+	const __m128 pen = _mm_sub_ps(r, _mm_mul_ps(d2, inv));
+	x = Select(hit, _mm_add_ps(x, _mm_mul_ps(nx, pen)), x);
+	y = Select(hit, _mm_add_ps(y, _mm_mul_ps(ny, pen)), y);
+	const __m128 vn = _mm_add_ps(_mm_mul_ps(vx, nx), _mm_mul_ps(vy, ny));
+	const __m128 in = _mm_and_ps(hit, _mm_cmplt_ps(vn, zero));
+	const __m128 j = _mm_mul_ps(vn, k);
+	vx = Select(in, _mm_sub_ps(vx, _mm_mul_ps(j, nx)), vx);
+	vy = Select(in, _mm_sub_ps(vy, _mm_mul_ps(j, ny)), vy);
+}
+
+// Same for a square brick of half size h, left through the nearest side
+static inline void BounceCube(__m128 &x, __m128 &y, __m128 &vx, __m128 &vy, __m128 bx, __m128 by, __m128 h, __m128 b, __m128 lanes)
+{
+	const __m128 zero = _mm_setzero_ps(), sign = _mm_set1_ps(-0.0f);
+	const __m128 dx = _mm_sub_ps(x, bx), dy = _mm_sub_ps(y, by);
+	const __m128 ax = _mm_andnot_ps(sign, dx), ay = _mm_andnot_ps(sign, dy);
+	const __m128 hit = _mm_and_ps(lanes, _mm_and_ps(_mm_cmplt_ps(ax, h), _mm_cmplt_ps(ay, h)));
+	if( !_mm_movemask_ps(hit) )
+		return;
+	// +-h on the side of the particle
+	const __m128 hx = _mm_or_ps(_mm_and_ps(sign, dx), h), hy = _mm_or_ps(_mm_and_ps(sign, dy), h);
+	const __m128 side = _mm_cmplt_ps(ax, ay); // nearer to the top or the bottom
+	const __m128 hitx = _mm_andnot_ps(side, hit), hity = _mm_and_ps(side, hit);
+	x = Select(hitx, _mm_add_ps(bx, hx), x);
+	y = Select(hity, _mm_add_ps(by, hy), y);
+	const __m128 nb = _mm_sub_ps(zero, b);
+	vx = Select(_mm_and_ps(hitx, _mm_cmplt_ps(_mm_mul_ps(vx, hx), zero)), _mm_mul_ps(vx, nb), vx);
+	vy = Select(_mm_and_ps(hity, _mm_cmplt_ps(_mm_mul_ps(vy, hy), zero)), _mm_mul_ps(vy, nb), vy);
+}
+
+// Keeps four particles in [fMin, fMax] along one axis
+static inline void BounceWalls(__m128 &x, __m128 &vx, __m128 fMin, __m128 fMax, __m128 b, __m128 lanes)
+{
+	const __m128 zero = _mm_setzero_ps(), nb = _mm_sub_ps(zero, b);
+	const __m128 lo = _mm_and_ps(lanes, _mm_cmplt_ps(x, fMin)), hi = _mm_and_ps(lanes, _mm_cmpgt_ps(x, fMax));
+	x = Select(lo, fMin, Select(hi, fMax, x));
+	const __m128 in = _mm_or_ps(_mm_and_ps(lo, _mm_cmplt_ps(vx, zero)), _mm_and_ps(hi, _mm_cmpgt_ps(vx, zero)));
+	vx = Select(in, _mm_mul_ps(vx, nb), vx);
+}
+#else
+// One particle off a round brick of radius r, as the four of the SSE version
+static inline void BounceBall(float &x, float &y, float &vx, float &vy, float bx, float by, float r, float k)
+{
+	const float dx = x - bx, dy = y - by, d2 = dx * dx + dy * dy;
+	if( !(d2 < r * r && d2 > 0) )
+		return;
+	const float inv = FastInvSqrt(d2);
+	const float nx = dx * inv, ny = dy * inv, pen = r - d2 * inv;
+	x += nx * pen;
+	y += ny * pen;
+	const float vn = vx * nx + vy * ny;
+	if( vn < 0 )
+	{
+		const float j = vn * k;
+		vx -= j * nx;
+		vy -= j * ny;
+	}
+}
+
+static inline void BounceCube(float &x, float &y, float &vx, float &vy, float bx, float by, float h, float b)
+{
+	const float dx = x - bx, dy = y - by, ax = fabsf(dx), ay = fabsf(dy);
+	if( !(ax < h && ay < h) )
+		return;
+	if( ax < ay ) // nearer to the top or the bottom
+	{
+		const float hy = dy < 0 ? -h : h;
+		y = by + hy;
+		if( vy * hy < 0 )
+			vy *= -b;
+	}
+	else
+	{
+		const float hx = dx < 0 ? -h : h;
+		x = bx + hx;
+		if( vx * hx < 0 )
+			vx *= -b;
+	}
+}
+
+static inline void BounceWalls(float &x, float &vx, float fMin, float fMax, float b)
+{
+	if( x < fMin )
+	{
+		x = fMin;
+		if( vx < 0 )
+			vx *= -b;
+	}
+	else if( x > fMax )
+	{
+		x = fMax;
+		if( vx > 0 )
+			vx *= -b;
+	}
+}
+#endif
+
+void ParticleCollider::Collide(Particle *pParticles, int nCount, const World &world, float fBounce)
+{
+	PROF_SCOPE(PROF_TIME_COLLIDER);
+	m_nTests = 0;
+	if( nCount <= 0 )
+		return;
+	const LevelGrid &level = world.level;
+	const int nWidth = level.GetWidth(), nHeight = level.GetHeight();
+	const float fMinX = (float)level.GetX(0), fMinY = (float)level.GetY(0);
+	const float fPitch = (float)(fBrickSize + fBrickMargin), fInvPitch = 1 / fPitch;
+
+	// bin by cell, the cells out of the level are clamped to the ring around it
+	const int nRow = nWidth + 2, nCells = nRow * (nHeight + 2);
+	int nBuckets = 64;
+	while( nBuckets < 2 * nCount && nBuckets < 2 * nCells )
+		nBuckets <<= 1;
+	m_vBuckets.assign(nBuckets + 1, 0);
+	m_vCells.resize(nCount);
+	m_vPoints.resize(nCount);
+	m_vOrder.resize(nCount);
+	m_vKeys.resize(nCount);
+	m_vSorted.resize(nCount + 4);
+	// shifted by one cell so that truncating the clamped position floors it
+	const float fOffsetX = 1.5f - fMinX * fInvPitch, fOffsetY = 1.5f - fMinY * fInvPitch;
+	const float fMaxCellX = (float)(nWidth + 1), fMaxCellY = (float)(nHeight + 1);
+	for(int i = 0; i < nCount; i++)
+	{
+		const Particle &par = pParticles[i];
+		const int cx = (int)max(0.0f, min(fMaxCellX, par.x * fInvPitch + fOffsetX));
+		const int cy = (int)max(0.0f, min(fMaxCellY, par.y * fInvPitch + fOffsetY));
+		const int nCell = cy * nRow + cx;
+		m_vCells[i] = nCell;
+		m_vBuckets[(nCell & (nBuckets - 1)) + 1]++;
+		const Point point = { par.x, par.y, par.vx, par.vy };
+		m_vPoints[i] = point;
+	}
+	for(int i = 0; i < nBuckets; i++)
+		m_vBuckets[i + 1] += m_vBuckets[i];
+	// the particles are read once in order above, the sort only moves their points
+	for(int i = 0; i < nCount; i++)
+	{
+		const int nCell = m_vCells[i], j = m_vBuckets[nCell & (nBuckets - 1)]++;
+		m_vOrder[j] = i;
+		m_vKeys[j] = nCell;
+		m_vSorted[j] = m_vPoints[i];
+	}
+
+#ifdef FAST_MATH_SSE
+	const __m128
+		k = _mm_set1_ps(1 + fBounce), b = _mm_set1_ps(fBounce),
+		rBall = _mm_set1_ps((float)fBrickRadiusBall), hCube = _mm_set1_ps((float)fBrickRadiusCube),
+		fMinWallX = _mm_set1_ps(-(float)world.fSpanX), fMaxWallX = _mm_set1_ps((float)world.fSpanX),
+		fMinWallY = _mm_set1_ps(-(float)world.fSpanY), fMaxWallY = _mm_set1_ps((float)world.fSpanY),
+		laneIds = _mm_set_ps(3, 2, 1, 0);
+#endif
+	std::vector<ParticleObstacle> vObstacles;
+	int nTests = 0;
+	// runs of one cell; a bucket shared by several cells may split into more runs
+	for(int nStart = 0, nEnd; nStart < nCount; nStart = nEnd)
+	{
+		const int nCell = m_vKeys[nStart];
+		float fRunMinX = m_vSorted[nStart].x, fRunMaxX = fRunMinX, fRunMinY = m_vSorted[nStart].y, fRunMaxY = fRunMinY;
+		for(nEnd = nStart + 1; nEnd < nCount && m_vKeys[nEnd] == nCell; nEnd++)
+		{
+			fRunMinX = min(fRunMinX, m_vSorted[nEnd].x);
+			fRunMaxX = max(fRunMaxX, m_vSorted[nEnd].x);
+			fRunMinY = min(fRunMinY, m_vSorted[nEnd].y);
+			fRunMaxY = max(fRunMaxY, m_vSorted[nEnd].y);
+		}
+		const int cx = nCell % nRow - 1, cy = nCell / nRow - 1;
+
+		vObstacles.clear();
+		for(int y = cy - 1; y <= cy + 1; y++)
+		{
+			for(DWORD bits = level.GetRow(cx - 1, y) & 7; bits; bits &= bits - 1)
+			{
+				const int x = cx - 1 + LowBit(bits);
+				ParticleObstacle obstacle = { (float)level.GetX(x), (float)level.GetY(y), brickTypes[level.Get(x, y)].eShape };
+				vObstacles.push_back(obstacle);
+			}
+		}
+		if( world.movers.GetCount() )
+		{
+			const Aabb box = { Real(fRunMinX), Real(fRunMinY), Real(fRunMaxX), Real(fRunMaxY) };
+			int nNodeTests = 0;
+			world.movers.Query(box, [&](int i)
+			{
+				const SimMover &mover = world.movers[i];
+				ParticleObstacle obstacle = { (float)mover.fX, (float)mover.fY, brickTypes[mover.nType].eShape };
+				vObstacles.push_back(obstacle);
+			}, nNodeTests);
+		}
+
+		for(int i = nStart; i < nEnd; i += 4)
+		{
+#ifndef FAST_MATH_SSE
+			nTests += (int)vObstacles.size();
+			for(int l = i; l < min(i + 4, nEnd); l++)
+			{
+				const Point &point = m_vSorted[l];
+				float x = point.x, y = point.y, vx = point.vx, vy = point.vy;
+				for(size_t j = 0; j < vObstacles.size(); j++)
+				{
+					const ParticleObstacle &obstacle = vObstacles[j];
+					if( obstacle.eShape == ShapeCube )
+						BounceCube(x, y, vx, vy, obstacle.x, obstacle.y, (float)fBrickRadiusCube, fBounce);
+					else
+						BounceBall(x, y, vx, vy, obstacle.x, obstacle.y, (float)fBrickRadiusBall, 1 + fBounce);
+				}
+				BounceWalls(x, vx, -(float)world.fSpanX, (float)world.fSpanX, fBounce);
+				BounceWalls(y, vy, -(float)world.fSpanY, (float)world.fSpanY, fBounce);
+				if( x == point.x && y == point.y && vx == point.vx && vy == point.vy )
+					continue;
+				Particle &par = pParticles[m_vOrder[l]];
+				par.x = x;
+				par.y = y;
+				par.vx = vx;
+				par.vy = vy;
+			}
+#else
+			const __m128 lanes = _mm_cmplt_ps(laneIds, _mm_set1_ps((float)(nEnd - i)));
+			// four points to one register per coordinate
+			__m128 x0 = _mm_loadu_ps(&m_vSorted[i].x), y0 = _mm_loadu_ps(&m_vSorted[i + 1].x);
+			__m128 vx0 = _mm_loadu_ps(&m_vSorted[i + 2].x), vy0 = _mm_loadu_ps(&m_vSorted[i + 3].x);
+			_MM_TRANSPOSE4_PS(x0, y0, vx0, vy0);
+			__m128 x = x0, y = y0, vx = vx0, vy = vy0;
+			for(size_t j = 0; j < vObstacles.size(); j++)
+			{
+				const ParticleObstacle &obstacle = vObstacles[j];
+				const __m128 bx = _mm_set1_ps(obstacle.x), by = _mm_set1_ps(obstacle.y);
+				if( obstacle.eShape == ShapeCube )
+					BounceCube(x, y, vx, vy, bx, by, hCube, b, lanes);
+				else
+					BounceBall(x, y, vx, vy, bx, by, rBall, k, lanes);
+			}
+			BounceWalls(x, vx, fMinWallX, fMaxWallX, b, lanes);
+			BounceWalls(y, vy, fMinWallY, fMaxWallY, b, lanes);
+			nTests += (int)vObstacles.size();
+			// only the particles that bounced are written back
+			const __m128 changed = _mm_or_ps(_mm_or_ps(_mm_cmpneq_ps(x, x0), _mm_cmpneq_ps(y, y0)), _mm_or_ps(_mm_cmpneq_ps(vx, vx0), _mm_cmpneq_ps(vy, vy0)));
+			int nChanged = _mm_movemask_ps(_mm_and_ps(changed, lanes));
+			if( !nChanged )
+				continue;
+			float fX[4], fY[4], fVX[4], fVY[4];
+			_mm_storeu_ps(fX, x);
+			_mm_storeu_ps(fY, y);
+			_mm_storeu_ps(fVX, vx);
+			_mm_storeu_ps(fVY, vy);
+			for(; nChanged; nChanged &= nChanged - 1)
+			{
+				const int l = LowBit(nChanged);
+				Particle &par = pParticles[m_vOrder[i + l]];
+				par.x = fX[l];
+				par.y = fY[l];
+				par.vx = fVX[l];
+				par.vy = fVY[l];
+			}
+#endif
+		}
+	}
+	m_nTests = nTests;
+	PROF_COUNT(PROF_PARTICLE_TESTS, nTests);
+}
@@ -0,0 +1,69 @@
+#ifndef __PARTICLES_H_
+#define __PARTICLES_H_
+
+#include <vector>
+
+#include "Utils.h"
+
+#define MAX_PARTICLES 1200
+
+struct Particle
+{
+	float age, alpha, size;
+	float fade, resize, rotate;
+	float r, g, b;
+	float x, y, z;
+	float vx, vy, vz;
+	float angle;
+};
+
+// Emitter and motion settings, shared by the game and the benchmark
+struct ParticleParams
+{
+	float
+		fSlowdown, // time runs 2^fSlowdown times slower
+		fSpeedX, fSpeedY,
+		fSpeedInitMin, fSpeedInitMax,
+		fAccelX, fAccelY, fAccelZ,
+		fFriction,
+		fFadeMin, fFadeMax,
+		fMaxAge,
+		fResizeMax, fResizeMin,
+		fSizeMin, fSizeMax,
+		fRotateMax, fRotateMin,
+		fX0, fY0, fZ0; // emitter position
+};
+
+extern const ParticleParams parDefault;
+
+// Moves the particles dt seconds forward, the faded ones are emitted again
+void ParticlesUpdate(Particle *pParticles, int nCount, const ParticleParams &params, float dt, RandGen &gen);
+
+struct World;
+
+// Optional stage after ParticlesUpdate for particles in the plane of the level: they bounce off its bricks,
+// movers and walls as points, whatever their z. Every call bins the particles by level cell in a spatial hash,
+// then tests each cell's particles four at a time against the bricks of the cells around it.
+class ParticleCollider
+{
+	// position and velocity in the plane
+	struct Point
+	{
+		float x, y, vx, vy;
+	};
+	std::vector<int> m_vBuckets;   // first sorted particle of each hash bucket, and the end
+	std::vector<int> m_vCells;     // cell of each particle, row by row with the ring around the level
+	std::vector<Point> m_vPoints;  // each particle, read once in order for the sort
+	std::vector<int> m_vOrder;     // particles sorted by bucket
+	std::vector<int> m_vKeys;      // cell of each sorted particle
+	std::vector<Point> m_vSorted;  // sorted particles, padded by four
+	int m_nTests;
+public:
+	ParticleCollider():m_nTests(0){}
+	// fBounce is the part of the speed kept across a surface
+	void Collide(Particle *pParticles, int nCount, const World &world, float fBounce);
+	// Particle-brick tests of the last call, four to a test
+	int GetTests() const { return m_nTests; }
+};
+
+#endif __PARTICLES_H_
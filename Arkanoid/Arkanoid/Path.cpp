@@ -0,0 +1,1384 @@
+#include "Path.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <functional>
+#include <limits.h>
+
+const int pathDirections[8][2] = {
+	{ 0, -1 }, { -1, 0 }, { 1, 0 }, { 0, 1 },
+	{ -1, -1 }, { 1, 1 }, { -1, 1 }, { 1, -1 },
+};
+
+static inline int PosPack(int x, int y)
+{
+	return x | (y << 16);
+}
+
+static inline void PosUnpack(int a, int& x, int& y)
+{
+	x = a & 0xFFFF;
+	y = a >> 16;
+}
+
+void Wave(const float *pfWayCost, int x, int y, int width, int height, float *pfWayPath, bool manhat, PathStats *pStats)
+{
+	if( x < 0 || x >= width || y < 0 || y >= height )
+		return;
+	int o = y * width + x;
+	if( IsFloatZero(pfWayCost + o) )
+		return;
+
+	std::fill(pfWayPath, pfWayPath + width * height, FLT_MAX);
+
+	std::vector<int> vWave[2];
+	size_t uCapacity = width * height / 8;
+	vWave[0].reserve(uCapacity);
+	vWave[1].reserve(uCapacity);
+
+	vWave[0].push_back(PosPack(x, y));
+	pfWayPath[o] = 0;
+
+	int t = 0, nPushed = 1, nExpanded = 0;
+	for(;;)
+	{
+		std::vector<int> &pWaveRead = vWave[t];
+		size_t uWaveSize = pWaveRead.size();
+		if( !uWaveSize )
+			break;
+		std::vector<int> &pWaveWrite = vWave[!t];
+		pWaveWrite.clear();
+		t = !t;
+		int *pWavePos = &pWaveRead[0];
+		const int dircount = manhat ? 4 : 8;
+		nExpanded += (int)uWaveSize;
+		for( size_t i = 0; i < uWaveSize; i++ )
+		{
+			int x1, y1;
+			PosUnpack(pWavePos[i], x1, y1);
+			const int o1 = y1 * width + x1;
+			const float dist0 = pfWayPath[o1];
+			for( int j = 0; j < dircount; j++ )
+			{
+				int dx = pathDirections[j][0], dy = pathDirections[j][1];
+				if( (y1 == 0 && dy < 0) || (y1 == height-1 && dy > 0) || (x1 == 0 && dx < 0) || (x1 == width-1 && dx > 0) )
+					continue;
+				int o = o1 + dy * width + dx;
+				float cost = pfWayCost[o];
+				if( IsFloatZero(cost) )
+					continue;
+				float step = dx && dy ? SQRT2 : 1;
+				float *fPath = pfWayPath + o, dist = dist0 + step * cost;
+				if( dist >= *fPath )
+					continue;
+				pWaveWrite.push_back(PosPack(x1 + dx, y1 + dy));
+				*fPath = dist;
+			}
+		}
+		nPushed += (int)pWaveWrite.size();
+	}
+	if( pStats )
+	{
+		pStats->nPushed += nPushed;
+		pStats->nExpanded += nExpanded;
+	}
+}
+
+// Adds the cells of bits in word n that are not closed yet to the next frontier and closes them.
+// Without branches: the frontier words of a diagonal edge hold a cell or two and most steps reach nothing.
+static inline void BfsReach(DWORD bits, int n, DWORD *pClosed, DWORD *pNext, int *pList, int &nNext)
+{
+	bits &= ~pClosed[n];
+	pClosed[n] |= bits;
+	pList[nNext] = n;
+	nNext += !pNext[n] & (bits != 0);
+	pNext[n] |= bits;
+}
+
+void PathBfs(const float *pfWayCost, int x, int y, int width, int height, float *pfWayPath, PathStats *pStats)
+{
+	if( x < 0 || x >= width || y < 0 || y >= height )
+		return;
+	const int o0 = y * width + x;
+	if( IsFloatZero(pfWayCost + o0) )
+		return;
+
+	std::fill(pfWayPath, pfWayPath + width * height, FLT_MAX);
+	// a bit per cell, 32 cells to a word and whole words to a row, with a word before and after every row
+	// and a row above and below. Closed are the blocked cells, the reached ones and all the padding.
+	const int nWords = (width + 31) >> 5, nStride = nWords + 2, nSize = nStride * (height + 2);
+	std::vector<DWORD> vClosed(nSize, ~0u), vFront[2];
+#ifdef FAST_MATH_SSE
+	const __m128 zero = _mm_setzero_ps();
+#endif
+	for(int y1 = 0; y1 < height; y1++)
+	{
+		const float *pfRow = pfWayCost + y1 * width;
+		DWORD *pRow = &vClosed[(y1 + 1) * nStride + 1];
+		ZeroMemory(pRow, nWords * sizeof(DWORD));
+		int x1 = 0;
+#ifdef FAST_MATH_SSE
+		for(; x1 + 4 <= width; x1 += 4)
+			pRow[x1 >> 5] |= (DWORD)_mm_movemask_ps(_mm_cmpeq_ps(_mm_loadu_ps(pfRow + x1), zero)) << (x1 & 31);
+#endif
+		for(; x1 < width; x1++)
+			pRow[x1 >> 5] |= (DWORD)IsFloatZero(pfRow + x1) << (x1 & 31);
+		if( width & 31 )
+			pRow[nWords - 1] |= ~0u << (width & 31);
+	}
+	// the frontier bits and the list of their nonzero words, each word is listed once
+	vFront[0].assign(nSize, 0);
+	vFront[1].assign(nSize, 0);
+	std::vector<int> vList[2];
+	vList[0].resize(nSize + 1);
+	vList[1].resize(nSize + 1);
+
+	const int n0 = (y + 1) * nStride + 1 + (x >> 5);
+	vClosed[n0] |= 1u << (x & 31);
+	vFront[0][n0] = 1u << (x & 31);
+	vList[0][0] = n0;
+	pfWayPath[o0] = 0;
+
+	// a wave at a time like Wave, stepping whole frontier words with shifts
+	DWORD *pClosed = &vClosed[0];
+	int t = 0, nCount = 1, nReached = 1;
+	float fDist = 0;
+	while( nCount )
+	{
+		const int *pCurrent = &vList[t][0];
+		int *pList = &vList[!t][0];
+		DWORD *pFront = &vFront[t][0], *pNext = &vFront[!t][0];
+		t = !t;
+		fDist += 1;
+		int nNext = 0;
+		for(int i = 0; i < nCount; i++)
+		{
+			const int n = pCurrent[i];
+			const DWORD front = pFront[n];
+			pFront[n] = 0;
+			BfsReach(front << 1 | front >> 1, n, pClosed, pNext, pList, nNext);
+			BfsReach(front << 31, n - 1, pClosed, pNext, pList, nNext);
+			BfsReach(front >> 31, n + 1, pClosed, pNext, pList, nNext);
+			BfsReach(front, n - nStride, pClosed, pNext, pList, nNext);
+			BfsReach(front, n + nStride, pClosed, pNext, pList, nNext);
+		}
+		for(int i = 0; i < nNext; i++)
+		{
+			const int n = pList[i], y1 = n / nStride - 1, w = n - (y1 + 1) * nStride - 1;
+			DWORD bits = pNext[n];
+			nReached += BitCount(bits);
+			float *pfRow = pfWayPath + y1 * width + (w << 5);
+			do
+			{
+				pfRow[LowBit(bits)] = fDist;
+				bits &= bits - 1;
+			}
+			while( bits );
+		}
+		nCount = nNext;
+	}
+	if( pStats )
+	{
+		pStats->nPushed += nReached;
+		pStats->nExpanded += nReached;
+	}
+}
+
+// Monotone priority queue: no key pushed is below the last one popped, as in Dijkstra.
+// Floats from 0 up order like their bits, so an item goes to the bucket of the highest bit where its key
+// differs from the last popped key. Popping empties the lowest bucket into lower ones around its least key,
+// every item moves down at most 32 times in all.
+class RadixHeap
+{
+	struct Item
+	{
+		DWORD uKey;
+		int nCell;
+	};
+	std::vector<Item> m_vBuckets[33]; // 0 for the last popped key itself
+	DWORD m_uLast;
+	int m_nSize;
+
+	static DWORD Bits(float fKey) { DWORD u; memcpy(&u, &fKey, sizeof(u)); return u; }
+	int Bucket(DWORD uKey) const { return uKey == m_uLast ? 0 : 1 + HighBit(uKey ^ m_uLast); }
+public:
+	RadixHeap():m_uLast(0), m_nSize(0){}
+	bool IsEmpty() const { return !m_nSize; }
+	// fKey must be at least the last popped key
+	void Push(float fKey, int nCell)
+	{
+		const Item item = { Bits(fKey), nCell };
+		ASSERT(fKey >= 0 && item.uKey >= m_uLast);
+		m_vBuckets[Bucket(item.uKey)].push_back(item);
+		m_nSize++;
+	}
+	// Returns a cell with the least key
+	int Pop(float &fKey)
+	{
+		ASSERT(m_nSize);
+		if( m_vBuckets[0].empty() )
+		{
+			int i = 1;
+			while( m_vBuckets[i].empty() )
+				i++;
+			std::vector<Item> &bucket = m_vBuckets[i];
+			DWORD uMin = bucket[0].uKey;
+			for(size_t j = 1; j < bucket.size(); j++)
+				uMin = min(uMin, bucket[j].uKey);
+			m_uLast = uMin;
+			for(size_t j = 0; j < bucket.size(); j++)
+				m_vBuckets[Bucket(bucket[j].uKey)].push_back(bucket[j]);
+			bucket.clear();
+		}
+		const Item item = m_vBuckets[0].back();
+		m_vBuckets[0].pop_back();
+		m_nSize--;
+		memcpy(&fKey, &item.uKey, sizeof(fKey));
+		return item.nCell;
+	}
+};
+
+// Buckets of keys fWidth apart in a ring spanning the longest step, fWidth being at most the shortest step.
+// No cell can then get cheaper through another cell of its own bucket, so the cells come out with their
+// final distances without any ordering within the buckets.
+class BucketQueue
+{
+	struct Item
+	{
+		float fKey;
+		int nCell;
+	};
+	std::vector<std::vector<Item> > m_vBuckets; // a power of two of them
+	float m_fInvWidth;
+	int m_nCurrent; // bucket of the last popped key, counted from key 0
+	int m_nSize;
+public:
+	BucketQueue(float fWidth, float fMaxStep):m_fInvWidth(1 / fWidth), m_nCurrent(0), m_nSize(0)
+	{
+		int nBuckets = 1;
+		while( nBuckets < (int)(fMaxStep * m_fInvWidth) + 2 )
+			nBuckets <<= 1;
+		m_vBuckets.resize(nBuckets);
+	}
+	bool IsEmpty() const { return !m_nSize; }
+	void Push(float fKey, int nCell)
+	{
+		const Item item = { fKey, nCell };
+		const int nBucket = max(m_nCurrent, (int)(fKey * m_fInvWidth));
+		ASSERT(nBucket - m_nCurrent < (int)m_vBuckets.size());
+		m_vBuckets[nBucket & (m_vBuckets.size() - 1)].push_back(item);
+		m_nSize++;
+	}
+	// Returns a cell of the least bucket
+	int Pop(float &fKey)
+	{
+		ASSERT(m_nSize);
+		while( m_vBuckets[m_nCurrent & (m_vBuckets.size() - 1)].empty() )
+			m_nCurrent++;
+		std::vector<Item> &bucket = m_vBuckets[m_nCurrent & (m_vBuckets.size() - 1)];
+		const Item item = bucket.back();
+		bucket.pop_back();
+		m_nSize--;
+		fKey = item.fKey;
+		return item.nCell;
+	}
+};
+
+// beyond this many cheapest steps in the longest one, the ring of BucketQueue gets long to scan and PathDijkstra
+// takes a RadixHeap instead
+#define PATH_BUCKET_RATIO 64
+
+template<class Queue>
+static void DijkstraRun(Queue &queue, const float *pfWayCost, int o0, int width, int height, float *pfWayPath, bool manhat, PathStats *pStats)
+{
+	pfWayPath[o0] = 0;
+	queue.Push(0, o0);
+	int nPushed = 1, nExpanded = 0;
+	const int dircount = manhat ? 4 : 8;
+	while( !queue.IsEmpty() )
+	{
+		float dist0;
+		const int o1 = queue.Pop(dist0);
+		// left behind by a cheaper push of the same cell
+		if( dist0 > pfWayPath[o1] )
+			continue;
+		nExpanded++;
+		const int x1 = o1 % width, y1 = o1 / width;
+		for( int j = 0; j < dircount; j++ )
+		{
+			int dx = pathDirections[j][0], dy = pathDirections[j][1];
+			if( (y1 == 0 && dy < 0) || (y1 == height-1 && dy > 0) || (x1 == 0 && dx < 0) || (x1 == width-1 && dx > 0) )
+				continue;
+			int o = o1 + dy * width + dx;
+			float cost = pfWayCost[o];
+			if( IsFloatZero(cost) )
+				continue;
+			float step = dx && dy ? SQRT2 : 1;
+			float *fPath = pfWayPath + o, dist = dist0 + step * cost;
+			if( dist >= *fPath )
+				continue;
+			*fPath = dist;
+			queue.Push(dist, o);
+			nPushed++;
+		}
+	}
+	if( pStats )
+	{
+		pStats->nPushed += nPushed;
+		pStats->nExpanded += nExpanded;
+	}
+}
+
+void PathDijkstra(const float *pfWayCost, int x, int y, int width, int height, float *pfWayPath, bool manhat, PathStats *pStats)
+{
+	if( x < 0 || x >= width || y < 0 || y >= height )
+		return;
+	const int o0 = y * width + x;
+	if( IsFloatZero(pfWayCost + o0) )
+		return;
+
+	std::fill(pfWayPath, pfWayPath + width * height, FLT_MAX);
+	// the buckets are as wide as the cheapest step, unless that makes too many of them
+	float fMinCost = FLT_MAX, fMaxCost = 0;
+	for(int o = 0; o < width * height; o++)
+	{
+		if( IsFloatZero(pfWayCost + o) )
+			continue;
+		fMinCost = min(fMinCost, pfWayCost[o]);
+		fMaxCost = max(fMaxCost, pfWayCost[o]);
+	}
+	const float fMaxStep = manhat ? fMaxCost : SQRT2 * fMaxCost;
+	if( fMaxStep <= PATH_BUCKET_RATIO * fMinCost )
+	{
+		BucketQueue queue(fMinCost, fMaxStep);
+		DijkstraRun(queue, pfWayCost, o0, width, height, pfWayPath, manhat, pStats);
+	}
+	else
+	{
+		RadixHeap heap;
+		DijkstraRun(heap, pfWayCost, o0, width, height, pfWayPath, manhat, pStats);
+	}
+}
+
+// Lower bound of the distance between cells dx, dy apart, in units of the least cost
+static inline float PathHeuristic(int dx, int dy, bool manhat)
+{
+	dx = abs(dx);
+	dy = abs(dy);
+	if( manhat )
+		return (float)(dx + dy);
+	return (float)max(dx, dy) + (SQRT2 - 1) * (float)min(dx, dy);
+}
+
+float PathAStar(const float *pfWayCost, int x, int y, int xGoal, int yGoal, int width, int height, float *pfWayPath, bool manhat, float fMinCost, PathStats *pStats)
+{
+	if( x < 0 || x >= width || y < 0 || y >= height || xGoal < 0 || xGoal >= width || yGoal < 0 || yGoal >= height )
+		return FLT_MAX;
+	const int o0 = y * width + x, oGoal = yGoal * width + xGoal;
+	if( IsFloatZero(pfWayCost + o0) )
+		return FLT_MAX;
+
+	std::fill(pfWayPath, pfWayPath + width * height, FLT_MAX);
+	std::vector<BYTE> vClosed(width * height, 0);
+	RadixHeap heap;
+	pfWayPath[o0] = 0;
+	heap.Push(fMinCost * PathHeuristic(xGoal - x, yGoal - y, manhat), o0);
+	int nPushed = 1, nExpanded = 0;
+	const int dircount = manhat ? 4 : 8;
+	float fLast = 0;
+	while( !heap.IsEmpty() )
+	{
+		float f;
+		const int o1 = heap.Pop(f);
+		if( vClosed[o1] )
+			continue;
+		vClosed[o1] = 1;
+		nExpanded++;
+		fLast = f;
+		if( o1 == oGoal )
+			break;
+		const int x1 = o1 % width, y1 = o1 / width;
+		const float dist0 = pfWayPath[o1];
+		for( int j = 0; j < dircount; j++ )
+		{
+			int dx = pathDirections[j][0], dy = pathDirections[j][1];
+			if( (y1 == 0 && dy < 0) || (y1 == height-1 && dy > 0) || (x1 == 0 && dx < 0) || (x1 == width-1 && dx > 0) )
+				continue;
+			int o = o1 + dy * width + dx;
+			float cost = pfWayCost[o];
+			if( IsFloatZero(cost) || vClosed[o] )
+				continue;
+			float step = dx && dy ? SQRT2 : 1;
+			float *fPath = pfWayPath + o, dist = dist0 + step * cost;
+			if( dist >= *fPath )
+				continue;
+			*fPath = dist;
+			// the heuristic is consistent, only rounding can take a key below the last one
+			heap.Push(max(fLast, dist + fMinCost * PathHeuristic(xGoal - x1 - dx, yGoal - y1 - dy, manhat)), o);
+			nPushed++;
+		}
+	}
+	if( pStats )
+	{
+		pStats->nPushed += nPushed;
+		pStats->nExpanded += nExpanded;
+	}
+	return vClosed[oGoal] ? pfWayPath[oGoal] : FLT_MAX;
+}
+
+// Shared state of PathDeltaStep; the rows are cut in bands, one part for each thread owning the distances of its band
+class DeltaStepping
+{
+	typedef std::pair<int, float> Request;
+	struct Part
+	{
+		DeltaStepping *pStep;
+		int nIndex;
+		std::vector<std::vector<int> > vBuckets; // cells of the band by floor(distance / delta) in a ring, stale ones included
+		std::vector<int> vFrontier;
+		std::vector<std::vector<Request> > vOut;  // the distances found for the cells of each band
+		int nPushed, nExpanded;
+	};
+	const float *m_pfWayCost;
+	float *m_pfWayPath;
+	std::vector<float> m_vExpanded; // the distance a cell was last expanded with
+	std::vector<int> m_vRowPart;
+	std::vector<Part> m_vParts;
+	int m_nWidth, m_nHeight, m_nBucket, m_nRing, m_nDirCount;
+	float m_fDelta;
+
+	// A step reaches at most m_nRing - 2 buckets past the current one, so the ring never wraps onto live cells
+	std::vector<int> &GetBucket(Part &part, int nBucket) const { return part.vBuckets[nBucket & (m_nRing - 1)]; }
+	void Push(Part &part, int o, float dist)
+	{
+		const int nBucket = max(m_nBucket, (int)(dist / m_fDelta));
+		ASSERT(nBucket - m_nBucket < m_nRing);
+		GetBucket(part, nBucket).push_back(o);
+		part.nPushed++;
+	}
+	// Steps from the cells of the current bucket of the band, only reading the distances out of the band
+	static void Relax(void *pParam)
+	{
+		Part &part = *(Part*)pParam;
+		DeltaStepping &step = *part.pStep;
+		const int width = step.m_nWidth, height = step.m_nHeight;
+		// the cells of the bucket not expanded with their distance yet
+		part.vFrontier.clear();
+		std::vector<int> &vBucket = step.GetBucket(part, step.m_nBucket);
+		for(size_t i = 0; i < vBucket.size(); i++)
+		{
+			const int o = vBucket[i];
+			if( step.m_vExpanded[o] == step.m_pfWayPath[o] )
+				continue;
+			step.m_vExpanded[o] = step.m_pfWayPath[o];
+			part.vFrontier.push_back(o);
+		}
+		vBucket.clear();
+		part.nExpanded += (int)part.vFrontier.size();
+		for(size_t i = 0; i < part.vFrontier.size(); i++)
+		{
+			const int o1 = part.vFrontier[i], x1 = o1 % width, y1 = o1 / width;
+			const float dist0 = step.m_pfWayPath[o1];
+			for( int j = 0; j < step.m_nDirCount; j++ )
+			{
+				int dx = pathDirections[j][0], dy = pathDirections[j][1];
+				if( (y1 == 0 && dy < 0) || (y1 == height-1 && dy > 0) || (x1 == 0 && dx < 0) || (x1 == width-1 && dx > 0) )
+					continue;
+				int o = o1 + dy * width + dx;
+				float cost = step.m_pfWayCost[o];
+				if( IsFloatZero(cost) )
+					continue;
+				float dist = dist0 + (dx && dy ? SQRT2 : 1) * cost;
+				if( dist < step.m_pfWayPath[o] )
+					part.vOut[step.m_vRowPart[y1 + dy]].push_back(Request(o, dist));
+			}
+		}
+	}
+	// Takes the distances the parts found for the band, in the order of the parts
+	static void Apply(void *pParam)
+	{
+		Part &part = *(Part*)pParam;
+		DeltaStepping &step = *part.pStep;
+		for(size_t k = 0; k < step.m_vParts.size(); k++)
+		{
+			std::vector<Request> &vIn = step.m_vParts[k].vOut[part.nIndex];
+			for(size_t i = 0; i < vIn.size(); i++)
+			{
+				if( vIn[i].second >= step.m_pfWayPath[vIn[i].first] )
+					continue;
+				step.m_pfWayPath[vIn[i].first] = vIn[i].second;
+				step.Push(part, vIn[i].first, vIn[i].second);
+			}
+			vIn.clear();
+		}
+	}
+	void Run(ThreadPool *pPool, TaskProc pProc)
+	{
+		if( !pPool )
+		{
+			pProc(&m_vParts[0]);
+			return;
+		}
+		for(size_t k = 0; k < m_vParts.size(); k++)
+			pPool->Add(pProc, &m_vParts[k]);
+		pPool->Wait();
+	}
+	bool IsBucketEmpty()
+	{
+		for(size_t k = 0; k < m_vParts.size(); k++)
+			if( !GetBucket(m_vParts[k], m_nBucket).empty() )
+				return false;
+		return true;
+	}
+	// Moves on to the first bucket with cells, all of them are within the ring from the current one
+	bool NextBucket()
+	{
+		for(int b = m_nBucket; b < m_nBucket + m_nRing; b++)
+		{
+			for(size_t k = 0; k < m_vParts.size(); k++)
+			{
+				if( !GetBucket(m_vParts[k], b).empty() )
+				{
+					m_nBucket = b;
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+public:
+	void Solve(const float *pfWayCost, int o0, int width, int height, float *pfWayPath, bool manhat, ThreadPool *pPool, PathStats *pStats)
+	{
+		m_pfWayCost = pfWayCost;
+		m_pfWayPath = pfWayPath;
+		m_nWidth = width;
+		m_nHeight = height;
+		m_nDirCount = manhat ? 4 : 8;
+		float fMinCost = FLT_MAX, fMaxCost = 0;
+		for(int o = 0; o < width * height; o++)
+		{
+			if( IsFloatZero(pfWayCost + o) )
+				continue;
+			fMinCost = min(fMinCost, pfWayCost[o]);
+			fMaxCost = max(fMaxCost, pfWayCost[o]);
+		}
+		// any delta gives the same distances; one far cheaper cell must not make the buckets countless
+		const float fMaxStep = manhat ? fMaxCost : SQRT2 * fMaxCost;
+		m_fDelta = max(PATH_DELTA * fMinCost, fMaxStep);
+		m_nRing = 1;
+		while( m_nRing < (int)(fMaxStep / m_fDelta) + 2 )
+			m_nRing <<= 1;
+		m_vExpanded.assign(width * height, FLT_MAX);
+		std::fill(pfWayPath, pfWayPath + width * height, FLT_MAX);
+
+		const int nParts = pPool ? max(min(pPool->GetThreads(), height), 1) : 1;
+		m_vRowPart.resize(height);
+		for(int y = 0; y < height; y++)
+			m_vRowPart[y] = (int)((__int64)y * nParts / height);
+		m_vParts.resize(nParts);
+		for(int k = 0; k < nParts; k++)
+		{
+			Part &part = m_vParts[k];
+			part.pStep = this;
+			part.nIndex = k;
+			part.vBuckets.assign(m_nRing, std::vector<int>());
+			part.vOut.assign(nParts, std::vector<Request>());
+			part.nPushed = part.nExpanded = 0;
+		}
+		pfWayPath[o0] = 0;
+		m_nBucket = 0;
+		Push(m_vParts[m_vRowPart[o0 / width]], o0, 0);
+		// a bucket is done when stepping from its cells brings no cell back into it
+		while( NextBucket() )
+		{
+			do
+			{
+				Run(pPool, Relax);
+				Run(pPool, Apply);
+			} while( !IsBucketEmpty() );
+		}
+		if( pStats )
+		{
+			for(int k = 0; k < nParts; k++)
+			{
+				pStats->nPushed += m_vParts[k].nPushed;
+				pStats->nExpanded += m_vParts[k].nExpanded;
+			}
+		}
+	}
+};
+
+void PathDeltaStep(const float *pfWayCost, int x, int y, int width, int height, float *pfWayPath, bool manhat, ThreadPool *pPool, PathStats *pStats)
+{
+	if( x < 0 || x >= width || y < 0 || y >= height )
+		return;
+	const int o0 = y * width + x;
+	if( IsFloatZero(pfWayCost + o0) )
+		return;
+	DeltaStepping step;
+	step.Solve(pfWayCost, o0, width, height, pfWayPath, manhat, pPool, pStats);
+}
+
+void PathSolve(const float *pfWayCost, int x, int y, int width, int height, float *pfWayPath, bool manhat, PathStats *pStats)
+{
+	bool bUnit = manhat;
+	for(int o = 0; o < width * height && bUnit; o++)
+		bUnit = IsFloatZero(pfWayCost + o) || pfWayCost[o] == 1;
+	if( bUnit )
+		PathBfs(pfWayCost, x, y, width, height, pfWayPath, pStats);
+	else
+		PathDijkstra(pfWayCost, x, y, width, height, pfWayPath, manhat, pStats);
+}
+
+void PathField::Create(const float *pfWayCost, int x, int y, int width, int height, bool manhat)
+{
+	m_nWidth = width;
+	m_nHeight = height;
+	m_bManhat = manhat;
+	m_nStart = y * width + x;
+	m_vCost.assign(pfWayCost, pfWayCost + width * height);
+	m_vDist.assign(width * height, FLT_MAX);
+	m_vQueue.clear();
+	// the solvers leave every cell consistent, its distance is the least over the neighbours of the same sums
+	PathSolve(&m_vCost[0], x, y, width, height, &m_vDist[0], manhat);
+	m_vRhs = m_vDist;
+}
+
+float PathField::GetRhs(int o) const
+{
+	if( o == m_nStart )
+		return IsFloatZero(m_vCost[o]) ? FLT_MAX : 0;
+	const float cost = m_vCost[o];
+	if( IsFloatZero(cost) )
+		return FLT_MAX;
+	const int x1 = o % m_nWidth, y1 = o / m_nWidth;
+	const int dircount = m_bManhat ? 4 : 8;
+	float rhs = FLT_MAX;
+	for( int j = 0; j < dircount; j++ )
+	{
+		// the steps are symmetric, stepping from the neighbour back into the cell
+		int dx = pathDirections[j][0], dy = pathDirections[j][1];
+		if( (y1 == 0 && dy < 0) || (y1 == m_nHeight-1 && dy > 0) || (x1 == 0 && dx < 0) || (x1 == m_nWidth-1 && dx > 0) )
+			continue;
+		const float dist0 = m_vDist[o + dy * m_nWidth + dx];
+		if( dist0 == FLT_MAX )
+			continue;
+		float step = dx && dy ? SQRT2 : 1;
+		rhs = min(rhs, dist0 + step * cost);
+	}
+	return rhs;
+}
+
+void PathField::UpdateCell(int o)
+{
+	m_vRhs[o] = GetRhs(o);
+	if( m_vRhs[o] != m_vDist[o] )
+	{
+		m_vQueue.push_back(Key(min(m_vDist[o], m_vRhs[o]), o));
+		std::push_heap(m_vQueue.begin(), m_vQueue.end(), std::greater<Key>());
+	}
+}
+
+void PathField::UpdateNeighbours(int o)
+{
+	const int x1 = o % m_nWidth, y1 = o / m_nWidth;
+	const int dircount = m_bManhat ? 4 : 8;
+	for( int j = 0; j < dircount; j++ )
+	{
+		int dx = pathDirections[j][0], dy = pathDirections[j][1];
+		if( (y1 == 0 && dy < 0) || (y1 == m_nHeight-1 && dy > 0) || (x1 == 0 && dx < 0) || (x1 == m_nWidth-1 && dx > 0) )
+			continue;
+		UpdateCell(o + dy * m_nWidth + dx);
+	}
+}
+
+void PathField::SetCost(int o, float fCost)
+{
+	ASSERT(o >= 0 && o < (int)m_vCost.size());
+	if( m_vCost[o] == fCost )
+		return;
+	m_vCost[o] = fCost;
+	// only the steps into the cell change
+	UpdateCell(o);
+}
+
+void PathField::Update(PathStats *pStats)
+{
+	int nPushed = (int)m_vQueue.size(), nExpanded = 0;
+	while( !m_vQueue.empty() )
+	{
+		const Key key = m_vQueue.front();
+		std::pop_heap(m_vQueue.begin(), m_vQueue.end(), std::greater<Key>());
+		m_vQueue.pop_back();
+		const int o = key.second;
+		float &dist = m_vDist[o];
+		const float rhs = m_vRhs[o];
+		// consistent by now, or queued again with another key
+		if( dist == rhs || key.first != min(dist, rhs) )
+			continue;
+		nExpanded++;
+		const size_t uQueued = m_vQueue.size();
+		if( dist > rhs )
+			dist = rhs; // got cheaper, final like in Dijkstra
+		else
+		{
+			// got dearer: forget the distance, the cell and its neighbours look for the best they have now
+			dist = FLT_MAX;
+			UpdateCell(o);
+		}
+		UpdateNeighbours(o);
+		nPushed += (int)(m_vQueue.size() - uQueued);
+	}
+	if( pStats )
+	{
+		pStats->nPushed += nPushed;
+		pStats->nExpanded += nExpanded;
+	}
+}
+
+// Index in pathDirections of the step dx, dy
+static const int pathDirIndex[3][3] = {
+	{ 4, 0, 7 },
+	{ 1, -1, 2 },
+	{ 6, 3, 5 },
+};
+
+static inline int PathDir(int dx, int dy)
+{
+	return pathDirIndex[dy + 1][dx + 1];
+}
+
+void PathJump::Create(const float *pfWayCost, int width, int height)
+{
+	m_nWidth = width;
+	m_nHeight = height;
+	const int nCells = width * height;
+	m_vOpen.resize(nCells);
+	for(int o = 0; o < nCells; o++)
+		m_vOpen[o] = !IsFloatZero(pfWayCost + o);
+	m_vJumps.assign(nCells * 8, 0);
+	m_vDirty.clear();
+	m_vRowDirty.assign(height, 0);
+	m_vColDirty.assign(width, 0);
+	m_vG.resize(nCells);
+	m_vParent.resize(nCells);
+	m_vDir.resize(nCells);
+	m_vSeen.assign(nCells, 0);
+	m_vClosed.assign(nCells, 0);
+	m_uStamp = 0;
+
+	for(int y = 0; y < height; y++)
+	{
+		UpdateLine(1, 0, y, NULL);
+		UpdateLine(2, 0, y, NULL);
+	}
+	for(int x = 0; x < width; x++)
+	{
+		UpdateLine(0, x, 0, NULL);
+		UpdateLine(3, x, 0, NULL);
+	}
+	// a diagonal jump needs the one of the next cell along, so the cells go from the far corner back
+	for(int j = 4; j < 8; j++)
+	{
+		const int dx = pathDirections[j][0], dy = pathDirections[j][1];
+		for(int y = dy > 0 ? height - 1 : 0; y >= 0 && y < height; y -= dy)
+			for(int x = dx > 0 ? width - 1 : 0; x >= 0 && x < width; x -= dx)
+				m_vJumps[(y * width + x) * 8 + j] = GetDiagonalJump(j, x, y);
+	}
+}
+
+bool PathJump::IsForced(int x, int y, int dx, int dy) const
+{
+	if( !dy )
+		return (!IsOpen(x, y + 1) && IsOpen(x + dx, y + 1)) || (!IsOpen(x, y - 1) && IsOpen(x + dx, y - 1));
+	if( !dx )
+		return (!IsOpen(x + 1, y) && IsOpen(x + 1, y + dy)) || (!IsOpen(x - 1, y) && IsOpen(x - 1, y + dy));
+	return (!IsOpen(x - dx, y) && IsOpen(x - dx, y + dy)) || (!IsOpen(x, y - dy) && IsOpen(x + dx, y - dy));
+}
+
+void PathJump::UpdateLine(int j, int x, int y, std::vector<int> *pvChanged)
+{
+	const int dx = pathDirections[j][0], dy = pathDirections[j][1];
+	// from the last cell of the line back, each jump follows from the one of the cell after
+	if( dx )
+		x = dx > 0 ? m_nWidth - 1 : 0;
+	else
+		y = dy > 0 ? m_nHeight - 1 : 0;
+	int nNext = 0;
+	for(; x >= 0 && x < m_nWidth && y >= 0 && y < m_nHeight; x -= dx, y -= dy)
+	{
+		int nJump;
+		if( !IsOpen(x + dx, y + dy) )
+			nJump = 0;
+		else if( IsForced(x + dx, y + dy, dx, dy) )
+			nJump = 1;
+		else
+			nJump = nNext > 0 ? nNext + 1 : nNext - 1;
+		int &jump = m_vJumps[(y * m_nWidth + x) * 8 + j];
+		if( jump != nJump )
+		{
+			jump = nJump;
+			if( pvChanged )
+				pvChanged->push_back(y * m_nWidth + x);
+		}
+		nNext = nJump;
+	}
+}
+
+int PathJump::GetDiagonalJump(int j, int x, int y) const
+{
+	const int dx = pathDirections[j][0], dy = pathDirections[j][1];
+	const int xn = x + dx, yn = y + dy;
+	if( !IsOpen(xn, yn) )
+		return 0;
+	// a diagonal stops where one of its sides reaches a jump point
+	const int *pJumps = &m_vJumps[(yn * m_nWidth + xn) * 8];
+	if( IsForced(xn, yn, dx, dy) || pJumps[PathDir(dx, 0)] > 0 || pJumps[PathDir(0, dy)] > 0 )
+		return 1;
+	return pJumps[j] > 0 ? pJumps[j] + 1 : pJumps[j] - 1;
+}
+
+void PathJump::SetOpen(int o, bool bOpen)
+{
+	ASSERT(o >= 0 && o < (int)m_vOpen.size());
+	if( (m_vOpen[o] != 0) == bOpen )
+		return;
+	m_vOpen[o] = bOpen;
+	m_vDirty.push_back(o);
+}
+
+void PathJump::Refresh()
+{
+	if( m_vDirty.empty() )
+		return;
+	// A cell changes the forced neighbours of the cells around it, so the straight jumps of the three rows
+	// and columns through them. Every cell whose inputs changed then goes back along the diagonals
+	// into it for as long as the jumps there change.
+	std::vector<int> vSeeds;
+	for(size_t i = 0; i < m_vDirty.size(); i++)
+	{
+		const int x = m_vDirty[i] % m_nWidth, y = m_vDirty[i] / m_nWidth;
+		for(int y1 = max(y - 1, 0); y1 <= min(y + 1, m_nHeight - 1); y1++)
+		{
+			m_vRowDirty[y1] = 1;
+			for(int x1 = max(x - 1, 0); x1 <= min(x + 1, m_nWidth - 1); x1++)
+				vSeeds.push_back(y1 * m_nWidth + x1);
+		}
+		for(int x1 = max(x - 1, 0); x1 <= min(x + 1, m_nWidth - 1); x1++)
+			m_vColDirty[x1] = 1;
+	}
+	m_vDirty.clear();
+	for(int y = 0; y < m_nHeight; y++)
+	{
+		if( !m_vRowDirty[y] )
+			continue;
+		m_vRowDirty[y] = 0;
+		UpdateLine(1, 0, y, &vSeeds);
+		UpdateLine(2, 0, y, &vSeeds);
+	}
+	for(int x = 0; x < m_nWidth; x++)
+	{
+		if( !m_vColDirty[x] )
+			continue;
+		m_vColDirty[x] = 0;
+		UpdateLine(0, x, 0, &vSeeds);
+		UpdateLine(3, x, 0, &vSeeds);
+	}
+	for(size_t i = 0; i < vSeeds.size(); i++)
+	{
+		for(int j = 4; j < 8; j++)
+		{
+			const int dx = pathDirections[j][0], dy = pathDirections[j][1];
+			int x = vSeeds[i] % m_nWidth - dx, y = vSeeds[i] / m_nWidth - dy;
+			for(; x >= 0 && x < m_nWidth && y >= 0 && y < m_nHeight; x -= dx, y -= dy)
+			{
+				int &jump = m_vJumps[(y * m_nWidth + x) * 8 + j];
+				const int nJump = GetDiagonalJump(j, x, y);
+				if( jump == nJump )
+					break;
+				jump = nJump;
+			}
+		}
+	}
+}
+
+float PathJump::Find(int x, int y, int xGoal, int yGoal, std::vector<int> *pvPath, PathStats *pStats)
+{
+	if( pvPath )
+		pvPath->clear();
+	if( !IsOpen(x, y) || !IsOpen(xGoal, yGoal) )
+		return FLT_MAX;
+	Refresh();
+	if( !++m_uStamp )
+	{
+		std::fill(m_vSeen.begin(), m_vSeen.end(), 0);
+		std::fill(m_vClosed.begin(), m_vClosed.end(), 0);
+		m_uStamp = 1;
+	}
+	const int o0 = y * m_nWidth + x, oGoal = yGoal * m_nWidth + xGoal;
+	m_vQueue.clear();
+	m_vSeen[o0] = m_uStamp;
+	m_vG[o0] = 0;
+	m_vParent[o0] = -1;
+	m_vDir[o0] = 8; // all directions
+	m_vQueue.push_back(Key(PathHeuristic(xGoal - x, yGoal - y, false), o0));
+	int nPushed = 1, nExpanded = 0;
+	while( !m_vQueue.empty() )
+	{
+		const int o1 = m_vQueue.front().second;
+		std::pop_heap(m_vQueue.begin(), m_vQueue.end(), std::greater<Key>());
+		m_vQueue.pop_back();
+		if( m_vClosed[o1] == m_uStamp )
+			continue;
+		m_vClosed[o1] = m_uStamp;
+		nExpanded++;
+		if( o1 == oGoal )
+			break;
+		const int x1 = o1 % m_nWidth, y1 = o1 / m_nWidth;
+
+		// the natural directions on from the one it came in and the forced ones around the walls beside it
+		DWORD dirs;
+		const int nCame = m_vDir[o1];
+		if( nCame == 8 )
+			dirs = 0xff;
+		else
+		{
+			const int dx = pathDirections[nCame][0], dy = pathDirections[nCame][1];
+			dirs = 1 << nCame;
+			if( !dy )
+			{
+				if( !IsOpen(x1, y1 + 1) )
+					dirs |= 1 << PathDir(dx, 1);
+				if( !IsOpen(x1, y1 - 1) )
+					dirs |= 1 << PathDir(dx, -1);
+			}
+			else if( !dx )
+			{
+				if( !IsOpen(x1 + 1, y1) )
+					dirs |= 1 << PathDir(1, dy);
+				if( !IsOpen(x1 - 1, y1) )
+					dirs |= 1 << PathDir(-1, dy);
+			}
+			else
+			{
+				dirs |= 1 << PathDir(dx, 0) | 1 << PathDir(0, dy);
+				if( !IsOpen(x1 - dx, y1) )
+					dirs |= 1 << PathDir(-dx, dy);
+				if( !IsOpen(x1, y1 - dy) )
+					dirs |= 1 << PathDir(dx, -dy);
+			}
+		}
+
+		const float g0 = m_vG[o1];
+		for(; dirs; dirs &= dirs - 1)
+		{
+			const int j = LowBit(dirs);
+			const int dx = pathDirections[j][0], dy = pathDirections[j][1];
+			const int nJump = m_vJumps[o1 * 8 + j], nFree = abs(nJump);
+			const int gdx = xGoal - x1, gdy = yGoal - y1;
+			int k;
+			// stop short on the goal, or for a diagonal on its row or column, when the way there is open
+			if( !dx || !dy )
+			{
+				const bool bOnLine = dx ? !gdy && gdx * dx > 0 : !gdx && gdy * dy > 0;
+				const int nGoal = abs(gdx + gdy);
+				if( bOnLine && nGoal <= nFree )
+					k = nGoal;
+				else if( nJump > 0 )
+					k = nJump;
+				else
+					continue;
+			}
+			else
+			{
+				const int nGoal = min(abs(gdx), abs(gdy));
+				if( gdx * dx > 0 && gdy * dy > 0 && nGoal <= nFree )
+					k = nGoal;
+				else if( nJump > 0 )
+					k = nJump;
+				else
+					continue;
+			}
+			const int o = o1 + k * (dy * m_nWidth + dx);
+			const float g = g0 + (float)k * (dx && dy ? SQRT2 : 1);
+			if( m_vSeen[o] == m_uStamp && g >= m_vG[o] )
+				continue;
+			m_vSeen[o] = m_uStamp;
+			m_vG[o] = g;
+			m_vParent[o] = o1;
+			m_vDir[o] = (BYTE)j;
+			m_vQueue.push_back(Key(g + PathHeuristic(xGoal - x1 - k * dx, yGoal - y1 - k * dy, false), o));
+			std::push_heap(m_vQueue.begin(), m_vQueue.end(), std::greater<Key>());
+			nPushed++;
+		}
+	}
+	if( pStats )
+	{
+		pStats->nPushed += nPushed;
+		pStats->nExpanded += nExpanded;
+	}
+	if( m_vClosed[oGoal] != m_uStamp )
+		return FLT_MAX;
+	if( pvPath )
+	{
+		for(int o = oGoal; o >= 0; o = m_vParent[o])
+			pvPath->push_back(o);
+		std::reverse(pvPath->begin(), pvPath->end());
+	}
+	return m_vG[oGoal];
+}
+
+void PathHierarchy::Create(const float *pfWayCost, int width, int height, bool manhat, int nClusterSize)
+{
+	ASSERT(nClusterSize > 0);
+	m_nWidth = width;
+	m_nHeight = height;
+	m_bManhat = manhat;
+	m_nClusterSize = nClusterSize;
+	m_nClustersX = (width + nClusterSize - 1) / nClusterSize;
+	m_nClustersY = (height + nClusterSize - 1) / nClusterSize;
+	m_vCost.assign(pfWayCost, pfWayCost + width * height);
+	m_fMinCost = FLT_MAX;
+	for(int o = 0; o < width * height; o++)
+		if( !IsFloatZero(pfWayCost + o) )
+			m_fMinCost = min(m_fMinCost, pfWayCost[o]);
+	if( m_fMinCost == FLT_MAX )
+		m_fMinCost = 1;
+	m_vLocalDist.resize(nClusterSize * nClusterSize);
+	m_vLocalParent.resize(nClusterSize * nClusterSize);
+
+	m_vClusters.assign(m_nClustersX * m_nClustersY, Cluster());
+	m_vDirty.assign(m_vClusters.size(), 0);
+	m_vDirtyList.clear();
+	// a side gets at most an entrance for every other cell
+	m_nSlots = 4 * ((nClusterSize + 1) / 2);
+	m_nNodes = 0;
+	const int nIds = (int)m_vClusters.size() * m_nSlots + 1;
+	m_vG.resize(nIds);
+	m_vParent.resize(nIds);
+	m_vSeen.assign(nIds, 0);
+	m_vClosed.assign(nIds, 0);
+	m_uStamp = 0;
+	for(int cy = 0, k = 0; cy < m_nClustersY; cy++)
+	{
+		for(int cx = 0; cx < m_nClustersX; cx++, k++)
+		{
+			Cluster &cluster = m_vClusters[k];
+			cluster.x0 = cx * nClusterSize;
+			cluster.y0 = cy * nClusterSize;
+			cluster.x1 = min(cluster.x0 + nClusterSize, width);
+			cluster.y1 = min(cluster.y0 + nClusterSize, height);
+			MarkDirty(k);
+		}
+	}
+	Refresh();
+}
+
+void PathHierarchy::MarkDirty(int k)
+{
+	if( m_vDirty[k] )
+		return;
+	m_vDirty[k] = 1;
+	m_vDirtyList.push_back(k);
+}
+
+void PathHierarchy::SetCost(int o, float fCost)
+{
+	ASSERT(o >= 0 && o < (int)m_vCost.size());
+	if( m_vCost[o] == fCost )
+		return;
+	m_vCost[o] = fCost;
+	if( !IsFloatZero(fCost) )
+		m_fMinCost = min(m_fMinCost, fCost);
+	// the distances inside its cluster, and the entrances on the sides it is on
+	const int x = o % m_nWidth, y = o / m_nWidth, C = m_nClusterSize;
+	MarkDirty(GetCluster(x, y));
+	if( x % C == 0 && x > 0 )
+		MarkDirty(GetCluster(x - 1, y));
+	if( x % C == C - 1 && x + 1 < m_nWidth )
+		MarkDirty(GetCluster(x + 1, y));
+	if( y % C == 0 && y > 0 )
+		MarkDirty(GetCluster(x, y - 1));
+	if( y % C == C - 1 && y + 1 < m_nHeight )
+		MarkDirty(GetCluster(x, y + 1));
+}
+
+void PathHierarchy::AddEntrances(Cluster &cluster, int x, int y, int dx, int dy, int nx, int ny, int nCount)
+{
+	// a run of open cells facing open cells gets an entrance in its middle, a long run one at each end;
+	// the cluster across scans the same run the same way, so its entrances face these
+	int nRun = 0;
+	for(int i = 0; i <= nCount; i++)
+	{
+		const int x1 = x + i * dx, y1 = y + i * dy;
+		if( i < nCount && IsOpen(x1, y1) && IsOpen(x1 + nx, y1 + ny) )
+		{
+			nRun++;
+			continue;
+		}
+		if( !nRun )
+			continue;
+		const int nFirst = i - nRun, nMid = nFirst + nRun / 2;
+		if( nRun < 6 )
+			cluster.vNodes.push_back((y + nMid * dy) * m_nWidth + x + nMid * dx);
+		else
+		{
+			cluster.vNodes.push_back((y + nFirst * dy) * m_nWidth + x + nFirst * dx);
+			cluster.vNodes.push_back((y + (i - 1) * dy) * m_nWidth + x + (i - 1) * dx);
+		}
+		nRun = 0;
+	}
+}
+
+void PathHierarchy::UpdateCluster(int k)
+{
+	Cluster &cluster = m_vClusters[k];
+	const int w = cluster.x1 - cluster.x0, h = cluster.y1 - cluster.y0;
+	cluster.vNodes.clear();
+	if( cluster.x0 > 0 )
+		AddEntrances(cluster, cluster.x0, cluster.y0, 0, 1, -1, 0, h);
+	if( cluster.x1 < m_nWidth )
+		AddEntrances(cluster, cluster.x1 - 1, cluster.y0, 0, 1, 1, 0, h);
+	if( cluster.y0 > 0 )
+		AddEntrances(cluster, cluster.x0, cluster.y0, 1, 0, 0, -1, w);
+	if( cluster.y1 < m_nHeight )
+		AddEntrances(cluster, cluster.x0, cluster.y1 - 1, 1, 0, 0, 1, w);
+	std::sort(cluster.vNodes.begin(), cluster.vNodes.end());
+	cluster.vNodes.erase(std::unique(cluster.vNodes.begin(), cluster.vNodes.end()), cluster.vNodes.end());
+
+	const int n = (int)cluster.vNodes.size();
+	ASSERT(n <= m_nSlots);
+	cluster.vDist.resize(n * n);
+	for(int i = 0; i < n; i++)
+	{
+		LocalSearch(cluster, cluster.vNodes[i], false);
+		for(int j = 0; j < n; j++)
+			cluster.vDist[i * n + j] = GetLocalDist(cluster, cluster.vNodes[j]);
+	}
+}
+
+void PathHierarchy::Relink(int k)
+{
+	Cluster &cluster = m_vClusters[k];
+	const int dircount = m_bManhat ? 4 : 8;
+	cluster.vLinkStart.resize(cluster.vNodes.size() + 1);
+	cluster.vLinks.clear();
+	for(int i = 0; i < (int)cluster.vNodes.size(); i++)
+	{
+		const int o = cluster.vNodes[i], x = o % m_nWidth, y = o / m_nWidth;
+		cluster.vLinkStart[i] = (int)cluster.vLinks.size();
+		// one step into an entrance of another cluster
+		for( int j = 0; j < dircount; j++ )
+		{
+			const int dx = pathDirections[j][0], dy = pathDirections[j][1];
+			if( !IsOpen(x + dx, y + dy) )
+				continue;
+			const int kNext = GetCluster(x + dx, y + dy), oNext = o + dy * m_nWidth + dx;
+			if( kNext == k )
+				continue;
+			const std::vector<int> &vNodes = m_vClusters[kNext].vNodes;
+			std::vector<int>::const_iterator it = std::lower_bound(vNodes.begin(), vNodes.end(), oNext);
+			if( it == vNodes.end() || *it != oNext )
+				continue;
+			const Link link = { kNext * m_nSlots + (int)(it - vNodes.begin()), (dx && dy ? SQRT2 : 1) * m_vCost[oNext] };
+			cluster.vLinks.push_back(link);
+		}
+	}
+	cluster.vLinkStart[cluster.vNodes.size()] = (int)cluster.vLinks.size();
+}
+
+void PathHierarchy::Refresh()
+{
+	if( m_vDirtyList.empty() )
+		return;
+	const size_t uDirty = m_vDirtyList.size();
+	for(size_t i = 0; i < uDirty; i++)
+	{
+		const int k = m_vDirtyList[i];
+		m_nNodes -= (int)m_vClusters[k].vNodes.size();
+		UpdateCluster(k);
+		m_nNodes += (int)m_vClusters[k].vNodes.size();
+	}
+	// the links into a rebuilt cluster go by the places of its entrances, so the clusters around it link again too
+	for(size_t i = 0; i < uDirty; i++)
+	{
+		const int cx = m_vDirtyList[i] % m_nClustersX, cy = m_vDirtyList[i] / m_nClustersX;
+		for(int ny = max(cy - 1, 0); ny <= min(cy + 1, m_nClustersY - 1); ny++)
+			for(int nx = max(cx - 1, 0); nx <= min(cx + 1, m_nClustersX - 1); nx++)
+				MarkDirty(ny * m_nClustersX + nx);
+	}
+	for(size_t i = 0; i < m_vDirtyList.size(); i++)
+	{
+		Relink(m_vDirtyList[i]);
+		m_vDirty[m_vDirtyList[i]] = 0;
+	}
+	m_vDirtyList.clear();
+}
+
+void PathHierarchy::LocalSearch(const Cluster &cluster, int o, bool bReverse, int oGoal)
+{
+	const int w = cluster.x1 - cluster.x0, h = cluster.y1 - cluster.y0;
+	std::fill(m_vLocalDist.begin(), m_vLocalDist.begin() + w * h, FLT_MAX);
+	m_vLocalQueue.clear();
+	const int l0 = (o / m_nWidth - cluster.y0) * w + o % m_nWidth - cluster.x0;
+	m_vLocalDist[l0] = 0;
+	m_vLocalParent[l0] = -1;
+	m_vLocalQueue.push_back(Key(0.0f, l0));
+	const int dircount = m_bManhat ? 4 : 8;
+	while( !m_vLocalQueue.empty() )
+	{
+		const Key key = m_vLocalQueue.front();
+		std::pop_heap(m_vLocalQueue.begin(), m_vLocalQueue.end(), std::greater<Key>());
+		m_vLocalQueue.pop_back();
+		const int l = key.second;
+		if( key.first > m_vLocalDist[l] )
+			continue;
+		m_nLocalExpanded++;
+		const int x1 = cluster.x0 + l % w, y1 = cluster.y0 + l / w, o1 = y1 * m_nWidth + x1;
+		if( o1 == oGoal )
+			break;
+		for( int j = 0; j < dircount; j++ )
+		{
+			const int dx = pathDirections[j][0], dy = pathDirections[j][1];
+			const int x = x1 + dx, y = y1 + dy;
+			if( x < cluster.x0 || x >= cluster.x1 || y < cluster.y0 || y >= cluster.y1 )
+				continue;
+			const float cost = m_vCost[y * m_nWidth + x];
+			if( IsFloatZero(cost) )
+				continue;
+			// going back, the step from (x, y) costs the cell it goes into
+			const float dist = key.first + (dx && dy ? SQRT2 : 1) * (bReverse ? m_vCost[o1] : cost);
+			const int ln = l + dy * w + dx;
+			if( dist >= m_vLocalDist[ln] )
+				continue;
+			m_vLocalDist[ln] = dist;
+			m_vLocalParent[ln] = l;
+			m_vLocalQueue.push_back(Key(dist, ln));
+			std::push_heap(m_vLocalQueue.begin(), m_vLocalQueue.end(), std::greater<Key>());
+		}
+	}
+}
+
+float PathHierarchy::GetLocalDist(const Cluster &cluster, int o) const
+{
+	return m_vLocalDist[(o / m_nWidth - cluster.y0) * (cluster.x1 - cluster.x0) + o % m_nWidth - cluster.x0];
+}
+
+void PathHierarchy::AppendLocalPath(const Cluster &cluster, int o, int oGoal, std::vector<int> &vPath)
+{
+	LocalSearch(cluster, o, false, oGoal);
+	const int w = cluster.x1 - cluster.x0;
+	const size_t uFirst = vPath.size();
+	int l = (oGoal / m_nWidth - cluster.y0) * w + oGoal % m_nWidth - cluster.x0;
+	ASSERT(m_vLocalDist[l] != FLT_MAX);
+	for(; m_vLocalParent[l] >= 0; l = m_vLocalParent[l])
+		vPath.push_back((cluster.y0 + l / w) * m_nWidth + cluster.x0 + l % w);
+	std::reverse(vPath.begin() + uFirst, vPath.end());
+}
+
+void PathHierarchy::Visit(int nNode, float g, int nParent, int xGoal, int yGoal)
+{
+	if( m_vSeen[nNode] == m_uStamp && g >= m_vG[nNode] )
+		return;
+	m_vSeen[nNode] = m_uStamp;
+	m_vG[nNode] = g;
+	m_vParent[nNode] = nParent;
+	float h = 0;
+	if( nNode < (int)m_vClusters.size() * m_nSlots )
+	{
+		const int o = m_vClusters[nNode / m_nSlots].vNodes[nNode % m_nSlots];
+		h = m_fMinCost * PathHeuristic(xGoal - o % m_nWidth, yGoal - o / m_nWidth, m_bManhat);
+	}
+	m_vQueue.push_back(Key(g + h, nNode));
+	std::push_heap(m_vQueue.begin(), m_vQueue.end(), std::greater<Key>());
+}
+
+float PathHierarchy::Find(int x, int y, int xGoal, int yGoal, std::vector<int> *pvPath, PathStats *pStats)
+{
+	if( pvPath )
+		pvPath->clear();
+	if( !IsOpen(x, y) || !IsOpen(xGoal, yGoal) )
+		return FLT_MAX;
+	Refresh();
+	if( !++m_uStamp )
+	{
+		std::fill(m_vSeen.begin(), m_vSeen.end(), 0);
+		std::fill(m_vClosed.begin(), m_vClosed.end(), 0);
+		m_uStamp = 1;
+	}
+	m_nLocalExpanded = 0;
+	const int o0 = y * m_nWidth + x, oGoal = yGoal * m_nWidth + xGoal, nGoal = (int)m_vClusters.size() * m_nSlots;
+	const int kStart = GetCluster(x, y), kGoal = GetCluster(xGoal, yGoal);
+	const Cluster &start = m_vClusters[kStart], &goal = m_vClusters[kGoal];
+
+	// back from the goal to the entrances of its cluster, then from the start to the entrances of its own
+	LocalSearch(goal, oGoal, true);
+	m_vGoalDist.resize(goal.vNodes.size());
+	for(size_t i = 0; i < goal.vNodes.size(); i++)
+		m_vGoalDist[i] = GetLocalDist(goal, goal.vNodes[i]);
+	LocalSearch(start, o0, false);
+	m_vQueue.clear();
+	if( kStart == kGoal && GetLocalDist(start, oGoal) != FLT_MAX )
+		Visit(nGoal, GetLocalDist(start, oGoal), -1, xGoal, yGoal);
+	for(size_t i = 0; i < start.vNodes.size(); i++)
+	{
+		const float dist = GetLocalDist(start, start.vNodes[i]);
+		if( dist != FLT_MAX )
+			Visit(kStart * m_nSlots + (int)i, dist, -1, xGoal, yGoal);
+	}
+	int nPushed = (int)m_vQueue.size(), nExpanded = 0;
+	while( !m_vQueue.empty() )
+	{
+		const int nNode = m_vQueue.front().second;
+		std::pop_heap(m_vQueue.begin(), m_vQueue.end(), std::greater<Key>());
+		m_vQueue.pop_back();
+		if( m_vClosed[nNode] == m_uStamp )
+			continue;
+		m_vClosed[nNode] = m_uStamp;
+		nExpanded++;
+		if( nNode == nGoal )
+			break;
+		const size_t uQueued = m_vQueue.size();
+		const int k = nNode / m_nSlots, i = nNode % m_nSlots;
+		const Cluster &cluster = m_vClusters[k];
+		const int n = (int)cluster.vNodes.size();
+		const float g = m_vG[nNode];
+		for(int j = 0; j < n; j++)
+			if( j != i && cluster.vDist[i * n + j] != FLT_MAX )
+				Visit(k * m_nSlots + j, g + cluster.vDist[i * n + j], nNode, xGoal, yGoal);
+		for(int l = cluster.vLinkStart[i]; l < cluster.vLinkStart[i + 1]; l++)
+			Visit(cluster.vLinks[l].nNode, g + cluster.vLinks[l].fCost, nNode, xGoal, yGoal);
+		if( k == kGoal && m_vGoalDist[i] != FLT_MAX )
+			Visit(nGoal, g + m_vGoalDist[i], nNode, xGoal, yGoal);
+		nPushed += (int)(m_vQueue.size() - uQueued);
+	}
+	const bool bFound = m_vClosed[nGoal] == m_uStamp;
+	if( bFound && pvPath )
+	{
+		// the entrances on the way, then the cells between them cluster by cluster
+		std::vector<int> vNodes;
+		for(int nNode = m_vParent[nGoal]; nNode >= 0; nNode = m_vParent[nNode])
+			vNodes.push_back(nNode);
+		std::reverse(vNodes.begin(), vNodes.end());
+		pvPath->push_back(o0);
+		int nLast = -1;
+		for(size_t i = 0; i < vNodes.size(); i++)
+		{
+			const Cluster &cluster = m_vClusters[vNodes[i] / m_nSlots];
+			const int o = cluster.vNodes[vNodes[i] % m_nSlots];
+			if( nLast < 0 )
+				AppendLocalPath(start, o0, o, *pvPath);
+			else if( nLast / m_nSlots == vNodes[i] / m_nSlots )
+				AppendLocalPath(cluster, pvPath->back(), o, *pvPath);
+			else
+				pvPath->push_back(o);
+			nLast = vNodes[i];
+		}
+		AppendLocalPath(nLast < 0 ? start : goal, pvPath->back(), oGoal, *pvPath);
+	}
+	if( pStats )
+	{
+		pStats->nPushed += nPushed;
+		pStats->nExpanded += nExpanded + m_nLocalExpanded;
+	}
+	return bFound ? m_vG[nGoal] : FLT_MAX;
+}
@@ -0,0 +1,199 @@
+#ifndef __PATH_H_
+#define __PATH_H_
+
+#include <vector>
+
+#include "Utils.h"
+#include "Math.h"
+
+#define SQRT2 1.41421356237f
+// width of the buckets of PathDeltaStep, in cheapest costs
+#define PATH_DELTA 8
+
+class ThreadPool;
+
+// Shortest paths over a grid of cell costs, row by row. A cost of 0 blocks the cell, stepping into a cell
+// costs its cost, SQRT2 times that diagonally. With manhat only the 4 side neighbours are stepped to.
+// The solvers fill pfWayPath with the distance from (x, y) of every cell they reach and FLT_MAX elsewhere.
+
+// Side steps first, then the diagonal ones
+extern const int pathDirections[8][2];
+
+// Work of the solver calls, for the benchmarks
+struct PathStats
+{
+	int nPushed;   // cells put in a wave or the queue, counting every repeat
+	int nExpanded; // cells whose neighbours were stepped to
+};
+
+typedef void (*PathProc)(const float *pfWayCost, int x, int y, int width, int height, float *pfWayPath, bool manhat, PathStats *pStats);
+
+// Level synchronous waves; a cell goes into the next wave again whenever it gets cheaper,
+// so with diagonals and uneven costs it expands cells many times over
+void Wave(const float *pfWayCost, int x, int y, int width, int height, float *pfWayPath, bool manhat, PathStats *pStats = NULL);
+// Wave for manhat when every open cell costs 1, as for the bricks of a level: a breadth first search on rows of bits,
+// stepping the frontier 32 cells to a word with shifts and masks. Gives the distances Wave gives, only about 1.5 to 2.5
+// times faster than it: the frontier of a single start holds a cell or two per row, so most of its words are nearly empty.
+void PathBfs(const float *pfWayCost, int x, int y, int width, int height, float *pfWayPath, PathStats *pStats = NULL);
+// Dijkstra on buckets as wide as the cheapest step, every reached cell is expanded once. Gives the distances Wave gives.
+// When the costs are far apart, so that the buckets would be too many, it keeps the cells in a radix heap instead.
+void PathDijkstra(const float *pfWayCost, int x, int y, int width, int height, float *pfWayPath, bool manhat, PathStats *pStats = NULL);
+// A* on a radix heap from (x, y) to (xGoal, yGoal), guided by the octile distance (manhattan with manhat) times fMinCost,
+// which must not be above the cost of any open cell. Stops when the goal is expanded, so only the expanded
+// cells have their final distance; the others have the length of some path or FLT_MAX. Going down the
+// distances from the goal still leads back to (x, y). Returns the distance of the goal, FLT_MAX if it cannot be reached.
+float PathAStar(const float *pfWayCost, int x, int y, int xGoal, int yGoal, int width, int height, float *pfWayPath, bool manhat, float fMinCost, PathStats *pStats = NULL);
+// Wave on the threads of the pool, as delta-stepping: the cells are taken in buckets PATH_DELTA cheapest costs wide,
+// or as wide as the dearest step when that is wider, in a ring spanning that step. Each thread steps from the
+// cells of its band of rows and takes the distances found for them. Gives the distances Wave gives whatever the number
+// of threads. Runs on the calling thread without a pool.
+void PathDeltaStep(const float *pfWayCost, int x, int y, int width, int height, float *pfWayPath, bool manhat, ThreadPool *pPool, PathStats *pStats = NULL);
+// The fastest of the above for the costs: PathBfs when they are unit and manhat, PathDijkstra otherwise
+void PathSolve(const float *pfWayCost, int x, int y, int width, int height, float *pfWayPath, bool manhat, PathStats *pStats = NULL);
+
+// Distance field from one cell kept up to date while cell costs change, as LPA* with every cell wanted.
+// Each cell keeps its distance and the best distance its neighbours offer it; a changed cost puts the cell back
+// in the queue, and the repair spreads only over the cells whose distances change. After Update the field
+// is the one PathDijkstra gives for the current costs.
+class PathField
+{
+	typedef std::pair<float, int> Key;
+	std::vector<float> m_vCost, m_vDist, m_vRhs; // rhs is the distance through the best neighbour
+	std::vector<Key> m_vQueue;                   // heap of cells whose distance and rhs differ, stale ones included
+	int m_nWidth, m_nHeight, m_nStart;
+	bool m_bManhat;
+
+	float GetRhs(int o) const;
+	// Recomputes the rhs of the cell and queues it if it differs from the distance
+	void UpdateCell(int o);
+	void UpdateNeighbours(int o);
+public:
+	PathField():m_nWidth(0), m_nHeight(0), m_nStart(-1), m_bManhat(false){}
+	// The field from (x, y) for the costs, which are copied
+	void Create(const float *pfWayCost, int x, int y, int width, int height, bool manhat);
+	float GetCost(int o) const { return m_vCost[o]; }
+	// Only queues the repair
+	void SetCost(int o, float fCost);
+	// Repairs the field after the costs set since the last call
+	void Update(PathStats *pStats = NULL);
+
+	// Distances row by row like pfWayPath, FLT_MAX for the cells not reached
+	const float *GetDist() const { return m_vDist.empty() ? NULL : &m_vDist[0]; }
+	int GetWidth() const { return m_nWidth; }
+	int GetHeight() const { return m_nHeight; }
+};
+
+// Jump point search for point to point queries over open and blocked cells, every open cell costing 1 and
+// all 8 steps allowed, corners included, like Wave without manhat. The search keeps only the cells where an
+// optimal path may turn, found with jump tables: for every cell and direction, how far the next such cell is,
+// or how far the wall. Changing a cell only marks it, the next Find repairs the tables around it.
+class PathJump
+{
+	typedef std::pair<float, int> Key;
+	std::vector<BYTE> m_vOpen;
+	std::vector<int> m_vJumps; // 8 per cell by pathDirections: n > 0 for a jump point n cells away, -n for n open cells before the wall
+	std::vector<int> m_vDirty; // cells changed since the tables were right
+	std::vector<BYTE> m_vRowDirty, m_vColDirty;
+	// the search: g, the jump point it came from, the direction it came in and stamps for seen and closed
+	std::vector<float> m_vG;
+	std::vector<int> m_vParent;
+	std::vector<BYTE> m_vDir;
+	std::vector<DWORD> m_vSeen, m_vClosed;
+	std::vector<Key> m_vQueue;
+	DWORD m_uStamp;
+	int m_nWidth, m_nHeight;
+
+	bool IsOpen(int x, int y) const { return x >= 0 && x < m_nWidth && y >= 0 && y < m_nHeight && m_vOpen[y * m_nWidth + x]; }
+	// An optimal path going into (x, y) in direction dx, dy may turn there
+	bool IsForced(int x, int y, int dx, int dy) const;
+	// Recomputes the straight jumps in direction j of the line through (x, y), the cells whose jumps changed go to pvChanged
+	void UpdateLine(int j, int x, int y, std::vector<int> *pvChanged);
+	int GetDiagonalJump(int j, int x, int y) const;
+	void Refresh();
+public:
+	PathJump():m_uStamp(0), m_nWidth(0), m_nHeight(0){}
+	// The cells with a nonzero cost are open, whatever the cost
+	void Create(const float *pfWayCost, int width, int height);
+	void SetOpen(int o, bool bOpen);
+	bool IsOpen(int o) const { return m_vOpen[o] != 0; }
+	// Length of a shortest path from (x, y) to (xGoal, yGoal), FLT_MAX if there is none.
+	// pvPath gets the jump points along it from (x, y) to the goal, the cells between them are on straight or diagonal lines.
+	float Find(int x, int y, int xGoal, int yGoal, std::vector<int> *pvPath = NULL, PathStats *pStats = NULL);
+	// The tables as they are after the changes, 8 jumps per cell
+	const int *GetJumps() { Refresh(); return m_vJumps.empty() ? NULL : &m_vJumps[0]; }
+};
+
+// cells on a side of the clusters of PathHierarchy by default
+#define PATH_CLUSTER_SIZE 32
+
+// Near optimal point to point queries over the costs of a huge grid, as in HPA*. The grid is cut in square
+// clusters; where open cells face each other across a cluster side they make entrances, and every cluster keeps
+// the distances inside it between its entrances. A query searches from the start and back from the goal inside
+// their clusters, then runs A* over the entrances only; the cells of the path are found cluster by cluster
+// when asked for. Paths keep to entrances, so they can be a little longer than the optimal ones.
+// Changing a cost only marks its cluster, and the ones across the sides it is on; the next Find rebuilds them
+// and links again the entrances of the clusters around them. Entrance ids are k * m_nSlots plus the place in
+// cluster k, so they stay put when other clusters change.
+class PathHierarchy
+{
+	struct Link
+	{
+		int nNode;
+		float fCost;
+	};
+	struct Cluster
+	{
+		int x0, y0, x1, y1;          // cells [x0, x1) x [y0, y1)
+		std::vector<int> vNodes;     // entrance cells, sorted
+		std::vector<float> vDist;    // [i * n + j] from entrance i to entrance j inside the cluster, FLT_MAX if none
+		std::vector<int> vLinkStart; // the steps from entrance i into other clusters are vLinks[vLinkStart[i], vLinkStart[i + 1])
+		std::vector<Link> vLinks;
+	};
+	typedef std::pair<float, int> Key;
+	std::vector<float> m_vCost;
+	std::vector<Cluster> m_vClusters;
+	std::vector<BYTE> m_vDirty;        // clusters to rebuild or link again
+	std::vector<int> m_vDirtyList;
+	// the abstract search by entrance id, the last id is the goal
+	std::vector<float> m_vG, m_vGoalDist;
+	std::vector<int> m_vParent;
+	std::vector<DWORD> m_vSeen, m_vClosed;
+	std::vector<Key> m_vQueue;
+	DWORD m_uStamp;
+	// the searches inside a cluster, by cell of the cluster
+	std::vector<float> m_vLocalDist;
+	std::vector<int> m_vLocalParent;
+	std::vector<Key> m_vLocalQueue;
+	int m_nWidth, m_nHeight, m_nClusterSize, m_nClustersX, m_nClustersY, m_nSlots, m_nNodes, m_nLocalExpanded;
+	float m_fMinCost;
+	bool m_bManhat;
+
+	int GetCluster(int x, int y) const { return (y / m_nClusterSize) * m_nClustersX + x / m_nClusterSize; }
+	bool IsOpen(int x, int y) const { return x >= 0 && x < m_nWidth && y >= 0 && y < m_nHeight && !IsFloatZero(m_vCost[y * m_nWidth + x]); }
+	// Entrances on the run of cells from (x, y) stepping dx, dy across the side toward the cells nx, ny further
+	void AddEntrances(Cluster &cluster, int x, int y, int dx, int dy, int nx, int ny, int nCount);
+	void MarkDirty(int k);
+	void UpdateCluster(int k);
+	// The links of the entrances of cluster k, after the clusters around it are up to date
+	void Relink(int k);
+	void Refresh();
+	// Dijkstra inside the cluster from cell o, or back to it with bReverse, until oGoal is reached if it is given
+	void LocalSearch(const Cluster &cluster, int o, bool bReverse, int oGoal = -1);
+	float GetLocalDist(const Cluster &cluster, int o) const;
+	// Appends the cells after o on a shortest way from o to oGoal inside the cluster
+	void AppendLocalPath(const Cluster &cluster, int o, int oGoal, std::vector<int> &vPath);
+	// Queues an entrance, or the goal, unless it has been reached as cheaply
+	void Visit(int nNode, float g, int nParent, int xGoal, int yGoal);
+public:
+	PathHierarchy():m_uStamp(0), m_nWidth(0), m_nHeight(0), m_nClusterSize(0), m_nClustersX(0), m_nClustersY(0), m_nSlots(0), m_nNodes(0),
+		m_nLocalExpanded(0), m_fMinCost(1), m_bManhat(false){}
+	void Create(const float *pfWayCost, int width, int height, bool manhat, int nClusterSize = PATH_CLUSTER_SIZE);
+	float GetCost(int o) const { return m_vCost[o]; }
+	void SetCost(int o, float fCost);
+	// Length of a path from (x, y) to (xGoal, yGoal) through the entrances, FLT_MAX if there is none.
+	// pvPath gets its cells from (x, y) to the goal. Expanded counts the entrances and the cells of the searches inside clusters.
+	float Find(int x, int y, int xGoal, int yGoal, std::vector<int> *pvPath = NULL, PathStats *pStats = NULL);
+	int GetNodeCount() { Refresh(); return m_nNodes; }
+};
+
+#endif __PATH_H_
@@ -0,0 +1,102 @@
+#include "Profile.h"
+
+Profiler profiler;
+
+// the counters before and after the ones by brick type
+static const char *pchCounterNames[PROF_TYPE_TESTS] =
+{
+	"substeps",
+	"cell candidates",
+	"mover candidates",
+	"node tests"
+};
+
+static const char *pchCounterNamesAfter[MAX_PROF_COUNTER - PROF_PLATFORM_TESTS] =
+{
+	"platform tests",
+	"respawns",
+	"particle tests"
+};
+
+static const char *pchTimerNames[MAX_PROF_TIMER] =
+{
+	"step",
+	"ball",
+	"movers",
+	"particles",
+	"collider"
+};
+
+Profiler::Profiler():m_bEnabled(false)
+{
+	Clear();
+}
+
+void Profiler::Clear()
+{
+	ZeroMemory(m_ticks, sizeof(m_ticks));
+	ZeroMemory(&m_current, sizeof(m_current));
+	m_nTicks = 0;
+}
+
+void Profiler::EndTick()
+{
+	if( !m_bEnabled )
+		return;
+	m_current.nTick = m_nTicks;
+	m_ticks[m_nTicks % MAX_PROF_TICKS] = m_current;
+	m_nTicks++;
+	ZeroMemory(&m_current, sizeof(m_current));
+}
+
+void Profiler::GetPeak(ProfTick &peak) const
+{
+	ZeroMemory(&peak, sizeof(peak));
+	for(int i = 0; i < GetCount(); i++)
+	{
+		const ProfTick &tick = GetTick(i);
+		for(int j = 0; j < MAX_PROF_COUNTER; j++)
+			peak.nCounters[j] = max(peak.nCounters[j], tick.nCounters[j]);
+		for(int j = 0; j < MAX_PROF_TIMER; j++)
+			peak.fTimes[j] = max(peak.fTimes[j], tick.fTimes[j]);
+	}
+}
+
+const char *Profiler::GetCounterName(int nCounter, char *pchBuff, int nSize)
+{
+	ASSERT(nCounter >= 0 && nCounter < MAX_PROF_COUNTER);
+	if( nCounter < PROF_TYPE_TESTS )
+		return pchCounterNames[nCounter];
+	if( nCounter >= PROF_PLATFORM_TESTS )
+		return pchCounterNamesAfter[nCounter - PROF_PLATFORM_TESTS];
+	_snprintf(pchBuff, nSize, "type %d tests", nCounter - PROF_TYPE_TESTS);
+	pchBuff[nSize - 1] = 0;
+	return pchBuff;
+}
+
+const char *Profiler::GetTimerName(ProfTimer eTimer)
+{
+	ASSERT(eTimer >= 0 && eTimer < MAX_PROF_TIMER);
+	return pchTimerNames[eTimer];
+}
+
+void Profiler::Dump(FILE *fp) const
+{
+	char buff[32];
+	fprintf(fp, "tick");
+	for(int i = 0; i < MAX_PROF_COUNTER; i++)
+		fprintf(fp, "\t%s", GetCounterName(i, buff, sizeof(buff)));
+	for(int i = 0; i < MAX_PROF_TIMER; i++)
+		fprintf(fp, "\t%s us", GetTimerName((ProfTimer)i));
+	fprintf(fp, "\n");
+	for(int i = GetCount() - 1; i >= 0; i--)
+	{
+		const ProfTick &tick = GetTick(i);
+		fprintf(fp, "%d", tick.nTick);
+		for(int j = 0; j < MAX_PROF_COUNTER; j++)
+			fprintf(fp, "\t%d", tick.nCounters[j]);
+		for(int j = 0; j < MAX_PROF_TIMER; j++)
+			fprintf(fp, "\t%.1f", 1e6f * tick.fTimes[j]);
+		fprintf(fp, "\n");
+	}
+}
@@ -0,0 +1,115 @@
+#ifndef __PROFILE_H_
+#define __PROFILE_H_
+
+#include "Utils.h"
+#include "Level.h"
+
+// Define SIM_PROFILE to count and time the hot paths of the simulation tick by tick, debug builds have it on.
+// Without it the PROF_ macros compile to nothing and the release hot paths are unchanged.
+#if defined(_DEBUG) && !defined(SIM_PROFILE)
+#	define SIM_PROFILE
+#endif
+
+// ticks kept in the ring
+#define MAX_PROF_TICKS 512
+
+enum ProfCounter
+{
+	PROF_SUBSTEPS,                                // iterations of the MoveBall collision loop
+	PROF_CELL_CANDIDATES,                         // bricks under the swept ball bounds
+	PROF_MOVER_CANDIDATES,                        // mover boxes returned by the tree
+	PROF_NODE_TESTS,                              // mover tree nodes tested
+	PROF_TYPE_TESTS,                              // exact ball tests against each brick type, MAX_TYPE counters
+	PROF_PLATFORM_TESTS = PROF_TYPE_TESTS + MAX_TYPE,
+	PROF_RESPAWNS,                                // particles emitted again
+	PROF_PARTICLE_TESTS,                          // particle collider tests, four particles to a test
+	MAX_PROF_COUNTER
+};
+
+enum ProfTimer
+{
+	PROF_TIME_STEP,      // SimStep
+	PROF_TIME_BALL,      // MoveBall, also for the predictor
+	PROF_TIME_MOVERS,    // SimMovers::Step
+	PROF_TIME_PARTICLES, // ParticlesUpdate
+	PROF_TIME_COLLIDER,  // ParticleCollider::Collide
+	MAX_PROF_TIMER
+};
+
+// Counters and times of one tick
+struct ProfTick
+{
+	int nTick;
+	int nCounters[MAX_PROF_COUNTER];
+	float fTimes[MAX_PROF_TIMER]; // seconds
+};
+
+// Ring of the last MAX_PROF_TICKS ticks. A tick gets everything counted since the one before it ended,
+// so the particles and the predictions of a frame go into the tick after them.
+// There is one for the game thread; it is off until enabled, so tools stepping worlds on other threads leave it alone.
+class Profiler
+{
+	ProfTick m_ticks[MAX_PROF_TICKS];
+	ProfTick m_current;
+	int m_nTicks; // ended so far
+	bool m_bEnabled;
+public:
+	Profiler();
+	void Enable(bool bEnable) { m_bEnabled = bEnable; }
+	bool IsEnabled() const { return m_bEnabled; }
+	// Forgets the ring and the open tick
+	void Clear();
+
+	void Count(int nCounter, int n)
+	{
+		if( m_bEnabled )
+			m_current.nCounters[nCounter] += n;
+	}
+	void AddTime(ProfTimer eTimer, float fTime)
+	{
+		if( m_bEnabled )
+			m_current.fTimes[eTimer] += fTime;
+	}
+	// Closes the open tick into the ring
+	void EndTick();
+
+	// Ticks in the ring, and one of them: 0 is the last ended
+	int GetCount() const { return min(m_nTicks, MAX_PROF_TICKS); }
+	const ProfTick &GetTick(int nAgo) const { return m_ticks[(m_nTicks - 1 - nAgo) % MAX_PROF_TICKS]; }
+	// Highest value of each counter and time in the ring
+	void GetPeak(ProfTick &peak) const;
+	static const char *GetCounterName(int nCounter, char *pchBuff, int nSize);
+	static const char *GetTimerName(ProfTimer eTimer);
+	// The ring as tab separated columns, oldest tick first, times in microseconds
+	void Dump(FILE *fp) const;
+};
+
+extern Profiler profiler;
+
+// Adds the time until the end of the scope to a timer
+class ProfScope
+{
+	Timer m_timer;
+	ProfTimer m_eTimer;
+public:
+	ProfScope(ProfTimer eTimer):m_eTimer(eTimer){}
+	~ProfScope() { profiler.AddTime(m_eTimer, m_timer.Time()); }
+};
+
+// Ends the tick at the end of the scope, after the timers declared below it have added their time
+struct ProfTickScope
+{
+	~ProfTickScope() { profiler.EndTick(); }
+};
+
+#ifdef SIM_PROFILE
+#	define PROF_COUNT(counter, n) profiler.Count((counter), (n))
+#	define PROF_SCOPE(timer) ProfScope __profScope(timer)
+#	define PROF_TICK() ProfTickScope __profTick
+#else
+#	define PROF_COUNT(counter, n) ((void)0)
+#	define PROF_SCOPE(timer) ((void)0)
+#	define PROF_TICK() ((void)0)
+#endif
+
+#endif __PROFILE_H_
@@ -0,0 +1,122 @@
+#include "Script.h"
+
+ErrorCode InputScript::Read(FILE *fp)
+{
+	Clear();
+	char pchLine[256];
+	while( fgets(pchLine, sizeof(pchLine), fp) )
+	{
+		int nTick = 0, nLen = 0;
+		char pchCmd[16] = {0};
+		if( pchLine[0] == '#' || sscanf(pchLine, "%d %15s%n", &nTick, pchCmd, &nLen) < 2 )
+			continue;
+		if( !strcmp(pchCmd, "aim") )
+		{
+			float x, y;
+			if( sscanf(pchLine + nLen, "%f %f", &x, &y) != 2 )
+				return "Aim needs a point";
+			Add(nTick, ScriptAim, x, y);
+		}
+		else if( !strcmp(pchCmd, "left") )
+			Add(nTick, ScriptLeft);
+		else if( !strcmp(pchCmd, "right") )
+			Add(nTick, ScriptRight);
+		else if( !strcmp(pchCmd, "stop") )
+			Add(nTick, ScriptStop);
+		else if( !strcmp(pchCmd, "auto") )
+			Add(nTick, ScriptAuto);
+		else if( !strcmp(pchCmd, "predict") )
+			Add(nTick, ScriptPredict);
+		else
+			return "Unknown script command";
+	}
+	return NO_ERROR;
+}
+
+void InputScript::Write(FILE *fp) const
+{
+	static const char *pchCmds[] = { "stop", "left", "right", "auto", "predict" };
+	for(size_t i = 0; i < m_vEvents.size(); i++)
+	{
+		const ScriptEvent &ev = m_vEvents[i];
+		if( ev.eCmd == ScriptAim )
+			fprintf(fp, "%d aim %.9g %.9g\n", ev.nTick, (float)ev.fX, (float)ev.fY);
+		else
+			fprintf(fp, "%d %s\n", ev.nTick, pchCmds[ev.eCmd]);
+	}
+}
+
+void InputScript::Record(int nTick, const SimInput &input)
+{
+	if( input.bAim )
+		Add(nTick, ScriptAim, input.fAimX, input.fAimY);
+	ScriptCmd eMove = input.bRight ? ScriptRight : input.bLeft ? ScriptLeft : ScriptStop;
+	if( eMove != m_eRecordMove )
+	{
+		Add(nTick, eMove);
+		m_eRecordMove = eMove;
+	}
+}
+
+void InputScript::Add(int nTick, ScriptCmd eCmd, Real fX, Real fY)
+{
+	ASSERT(m_vEvents.empty() || m_vEvents.back().nTick <= nTick);
+	ScriptEvent ev = { nTick, eCmd, fX, fY };
+	m_vEvents.push_back(ev);
+}
+
+void ScriptPlayer::Start(const InputScript *pScript)
+{
+	m_pScript = pScript;
+	m_nNext = 0;
+	m_nTick = 0;
+	m_eMove = ScriptStop;
+}
+
+void ScriptPlayer::Next(const World &world, SimInput &input)
+{
+	input.bLeft = false;
+	input.bRight = false;
+	input.bAim = false;
+	for(; m_pScript && m_nNext < m_pScript->GetCount() && (*m_pScript)[m_nNext].nTick <= m_nTick; m_nNext++)
+	{
+		const ScriptEvent &ev = (*m_pScript)[m_nNext];
+		if( ev.eCmd == ScriptAim )
+		{
+			input.bAim = true;
+			input.fAimX = ev.fX;
+			input.fAimY = ev.fY;
+		}
+		else
+			m_eMove = ev.eCmd;
+	}
+	switch( m_eMove )
+	{
+	case ScriptLeft:
+		input.bLeft = true;
+		break;
+	case ScriptRight:
+		input.bRight = true;
+		break;
+	case ScriptAuto:
+	case ScriptPredict:
+		{
+			Real fTargetX = world.fBallX;
+			if( m_eMove == ScriptPredict )
+			{
+				// the last point is the arrival, if the ball comes down within the horizon
+				const std::vector<SimBounce> &path = m_predictor.Predict(world, 4, 16);
+				if( !path.empty() && path.back().nBrick == SIM_PLATFORM )
+					fTargetX = path.back().fX;
+			}
+			// stay still within one platform step, or it would jitter around the target
+			Real fDiff = fTargetX - m_fAutoOffset - world.fPlatX, fStep = fPlatV * fSimTick;
+			input.bRight = fDiff > fStep;
+			input.bLeft = fDiff < -fStep;
+		}
+		break;
+	default:
+		break;
+	}
+	m_nTick++;
+}
@@ -0,0 +1,66 @@
+#ifndef __SCRIPT_H_
+#define __SCRIPT_H_
+
+#include <vector>
+
+#include "Simulation.h"
+
+// Scripted player input for the batch runner and the benchmark.
+// A script is a text file with one command per line, sorted by tick:
+//   <tick> left | right | stop     move the platform until the next move command
+//   <tick> auto                    follow the ball with the platform
+//   <tick> predict                 wait with the platform where the ball comes down
+//   <tick> aim <x> <y>             shoot the ball towards the point
+// Lines starting with '#' are comments.
+enum ScriptCmd
+{
+	ScriptStop,
+	ScriptLeft,
+	ScriptRight,
+	ScriptAuto,
+	ScriptPredict,
+	ScriptAim
+};
+
+struct ScriptEvent
+{
+	int nTick;
+	ScriptCmd eCmd;
+	Real fX, fY;
+};
+
+class InputScript
+{
+	std::vector<ScriptEvent> m_vEvents;
+	ScriptCmd m_eRecordMove;
+public:
+	InputScript():m_eRecordMove(ScriptStop){}
+	ErrorCode Read(FILE *fp);
+	void Write(FILE *fp) const;
+	void Add(int nTick, ScriptCmd eCmd, Real fX = 0, Real fY = 0);
+	// Appends the input of a tick, only what changed since the last recorded one
+	void Record(int nTick, const SimInput &input);
+	void Clear() { m_vEvents.clear(); m_eRecordMove = ScriptStop; }
+	bool IsEmpty() const { return m_vEvents.empty(); }
+	int GetCount() const { return (int)m_vEvents.size(); }
+	const ScriptEvent &operator [](int i) const { return m_vEvents[i]; }
+};
+
+// Plays a script back, one SimInput per tick
+class ScriptPlayer
+{
+	const InputScript *m_pScript;
+	int m_nNext, m_nTick;
+	ScriptCmd m_eMove;
+	Real m_fAutoOffset;
+	SimPredictor m_predictor;
+public:
+	ScriptPlayer():m_pScript(NULL), m_nNext(0), m_nTick(0), m_eMove(ScriptStop), m_fAutoOffset(0){}
+	void Start(const InputScript *pScript);
+	// Input for the next tick. In auto and predict mode the platform keeps the ball fAutoOffset off its center.
+	void Next(const World &world, SimInput &input);
+	void SetAutoOffset(Real fOffset) { m_fAutoOffset = fOffset; }
+	int GetTick() const { return m_nTick; }
+};
+
+#endif __SCRIPT_H_
@@ -1,7 +1,7 @@
 #include <list>
 
-#include "utils.h"
-#include "comm.h"
+#include "Utils.h"
+#include "Comm.h"
 
 int port = 12345;
 Server server;
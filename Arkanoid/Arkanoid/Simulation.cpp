@@ -0,0 +1,633 @@
+#include "Simulation.h"
+#include "Profile.h"
+
+const Real
+	fSimTick = Real(1) / 120,
+	fBallSpeed = 1.5f,
+	fBallR = 0.2f,
+	fLevelWidth = 5.0f,
+	fBrickMargin = 0.01f,
+	fBrickSize = fLevelWidth / (LEVEL_WIDTH - 1) - fBrickMargin,
+	fBrickRadiusBall = 0.85f * fBrickSize / 2,
+	fBrickRadiusCube = fBrickSize / 2,
+	fMinDistBase = fBallR + 0.71f * fBrickSize,
+	fMinDistBall = fBallR + fBrickRadiusBall,
+	fLevelOffsetX = 0,
+	fLevelOffsetY = 0.5f,
+	fLevelSpanX = 3.0f,
+	fLevelSpanY = 3 * fLevelSpanX / 4,
+	fPlatW = 1.0f, fPlatV = 2.0f, fPlatH = 0.3f,
+	fBallXStart = 0;
+
+const BrickType brickTypes[MAX_TYPE] = {
+	{ ShapeBall, 0, 0, NULL,    ShapeBall }, // empty
+	{ ShapeBall, 1, 0, "smile", ShapeBall },
+	{ ShapeCube, 2, 3, "crate", ShapeCube },
+	{ ShapeBall, 1, 0, "clock", ShapeBall }, // hit crate
+};
+
+// TYPE_BIT(type) is set for every type of the shape
+static DWORD ShapeTypes(BrickShape eShape)
+{
+	DWORD types = 0;
+	for(int type = 1; type < MAX_TYPE; type++)
+		if( brickTypes[type].eShape == eShape )
+			types |= TYPE_BIT(type);
+	return types;
+}
+
+static const DWORD dwShapeTypes[MAX_SHAPE] = { ShapeTypes(ShapeBall), ShapeTypes(ShapeCube) };
+
+#define rc fBrickRadiusCube
+#define rb fBallR
+static const Real fBoxSeg[4][5][2] = {
+	{ { 0,-1}, { -rc,      -rc - rb }, {  rc,      -rc - rb }, { -rc, -rc }, {  0,   rb } }, // bottom side
+	{ { 1, 0}, {  rc + rb, -rc      }, {  rc + rb,  rc      }, {  rc, -rc }, { -rb,   0 } }, // right side
+	{ { 0, 1}, { -rc,       rc + rb }, {  rc,       rc + rb }, {  rc,  rc }, {   0, -rb } }, // top side
+	{ {-1, 0}, { -rc - rb, -rc      }, { -rc - rb,  rc      }, { -rc,  rc }, {  rb,   0 } }, // left side
+};
+#undef rc
+#undef rb
+
+static Real SetNewDir(Real &fDirX, Real &fDirY, Real dx, Real dy)
+{
+	Real fDist2 = dx*dx + dy*dy;
+	if( fDist2 > 0 )
+	{
+		Real fDistRec = InvSqrt(fDist2);
+		fDirX = dx * fDistRec;
+		fDirY = dy * fDistRec;
+	}
+	return fDist2;
+}
+
+void SimCreate(World &world)
+{
+	// the default level fits the default walls, larger ones push them out
+	const LevelGrid &level = world.level;
+	world.fSpanX = max(fLevelSpanX, level.GetSpanX() + fBrickSize);
+	world.fSpanY = max(fLevelSpanY, level.GetSpanY() + 1);
+	world.fPlatY = -world.fSpanY + fPlatH;
+	world.fPlatX = 0;
+	SimReset(world);
+}
+
+void SimReset(World &world)
+{
+	world.fBallX = fBallXStart;
+	world.fBallY = world.fPlatY + fBallR;
+	world.fBallDirX = 0;
+	world.fBallDirY = 0;
+	world.bValidSpeed = false;
+	world.nCollisions = 0;
+	ZeroMemory(&world.stats, sizeof(world.stats));
+}
+
+// The ball move of one substep, from (fX0, fY0) to (fX1, fY1)
+struct BallSweep
+{
+	Real fX0, fY0, fX1, fY1, dx, dy;
+	Real fXc, fYc, fMinDist2; // bounds of the move, as a circle
+};
+
+// First brick hit in a substep
+struct BrickHit
+{
+	int x, o; // o is the cell index or SIM_MOVER(x), -1 when nothing was hit
+	int y;
+	Real colk, colx, coly;
+};
+
+// Collision kernel of a brick shape centered at (xc, yc): position along the sweep and contact point of the hit
+template<int nShape>
+static bool HitShape(const BallSweep &sweep, Real xc, Real yc, Real &colk, Real &colx, Real &coly);
+
+template<>
+bool HitShape<ShapeBall>(const BallSweep &sweep, Real xc, Real yc, Real &colk, Real &colx, Real &coly)
+{
+	if( sweep.dx * (sweep.fX0 - xc) + sweep.dy * (sweep.fY0 - yc) >= 0 ||
+		!IntersectSegmentCircle2D(sweep.fX0, sweep.fY0, sweep.fX1, sweep.fY1, xc, yc, fMinDistBall, &colk) )
+		return false;
+	colx = xc;
+	coly = yc;
+	return true;
+}
+
+template<>
+bool HitShape<ShapeCube>(const BallSweep &sweep, Real xc, Real yc, Real &colk, Real &colx, Real &coly)
+{
+	// first test collision with each box side
+	for(int j = 0; j < 4; j++)
+	{
+		auto fSeg = fBoxSeg[j];
+		if( sweep.dx * fSeg[0][0] + sweep.dy * fSeg[0][1] > 0 )
+			continue;
+		Real
+			fSegX1 = xc + fSeg[1][0],
+			fSegY1 = yc + fSeg[1][1],
+			fSegX2 = xc + fSeg[2][0],
+			fSegY2 = yc + fSeg[2][1],
+			coll;
+		if( IntersectSegmentSegment2D(
+			sweep.fX0, sweep.fY0, sweep.fX1, sweep.fY1,
+			fSegX1, fSegY1, fSegX2, fSegY2,
+			&colk, &coll) )
+		{
+			colx = fSegX1 + fSeg[4][0] + (fSegX2 - fSegX1) * coll;
+			coly = fSegY1 + fSeg[4][1] + (fSegY2 - fSegY1) * coll;
+			return true;
+		}
+	}
+	// if no side is hit, test collision with each box corner
+	for(int j = 0; j < 4; j++)
+	{
+		auto fCenter = fBoxSeg[j][3];
+		Real xco = xc + fCenter[0], yco = yc + fCenter[1];
+		if( sweep.dx * (sweep.fX0 - xco) + sweep.dy * (sweep.fY0 - yco) >= 0 )
+			continue;
+		if( IntersectSegmentCircle2D(
+			sweep.fX0, sweep.fY0, sweep.fX1, sweep.fY1,
+			xco, yco,
+			fBallR, &colk) )
+		{
+			colx = xco;
+			coly = yco;
+			return true;
+		}
+	}
+	return false;
+}
+
+// The kernels by shape, for the movers which come a few at a time in any order
+typedef bool (*HitShapeProc)(const BallSweep &sweep, Real xc, Real yc, Real &colk, Real &colx, Real &coly);
+static const HitShapeProc hitShapes[MAX_SHAPE] = { HitShape<ShapeBall>, HitShape<ShapeCube> };
+
+// Tests the bricks of one shape in the cells [xs, xs + 32) of row y selected by mask, in x order up to the first hit.
+// Cells past the hit another shape found in them are left out, so the first hit in row order wins as with a single scan.
+template<int nShape, class Bricks>
+static void HitBricks(const Bricks &level, const BallSweep &sweep, int xs, int y, DWORD mask, int nSkip, BrickHit &hit, SimStats &stats)
+{
+	DWORD bits = level.GetRow(xs, y, dwShapeTypes[nShape]) & mask;
+	if( hit.o >= 0 )
+		bits &= LOW_BITS(hit.x - xs);
+	for(; bits; bits &= bits - 1)
+	{
+		const int x = xs + LowBit(bits), o = y * level.GetWidth() + x;
+		if( o == nSkip )
+			continue;
+		const Real fBrickX = level.GetX(x), fBrickY = level.GetY(y);
+		Real dxc = sweep.fXc - fBrickX, dyc = sweep.fYc - fBrickY;
+		stats.nCellTests++;
+		PROF_COUNT(PROF_CELL_CANDIDATES, 1);
+		if( dxc * dxc + dyc * dyc > sweep.fMinDist2 )
+			continue;
+		stats.nShapeTests++;
+		PROF_COUNT(PROF_TYPE_TESTS + level.Get(x, y), 1);
+		Real colk, colx, coly;
+		if( HitShape<nShape>(sweep, fBrickX, fBrickY, colk, colx, coly) )
+		{
+			BrickHit first = { x, o, y, colk, colx, coly };
+			hit = first;
+			return;
+		}
+	}
+}
+
+// Moves the ball dt forward, off the bricks, the platform (moved from fPlatX0 to world.fPlatX) and the walls.
+// Bricks is the level for SimStep and a LevelOverlay for the prediction, which also lets the ball through the platform.
+// Replaces the hit by the earliest mover hit before it. The tree is asked for the boxes within fReach of the sweep.
+static void HitMovers(const SimMovers &movers, const BallSweep &sweep, Real fReach, int nSkip, BrickHit &hit, SimStats &stats)
+{
+	const Aabb box = {
+		min(sweep.fX0, sweep.fX1) - fReach, min(sweep.fY0, sweep.fY1) - fReach,
+		max(sweep.fX0, sweep.fX1) + fReach, max(sweep.fY0, sweep.fY1) + fReach };
+	int nNodeTests = 0;
+	movers.Query(box, [&](int i)
+	{
+		PROF_COUNT(PROF_MOVER_CANDIDATES, 1);
+		if( SIM_MOVER(i) == nSkip )
+			return;
+		const SimMover &mover = movers[i];
+		stats.nShapeTests++;
+		PROF_COUNT(PROF_TYPE_TESTS + mover.nType, 1);
+		Real colk, colx, coly;
+		// ties go to the grid, then to the lower index, so the order of the tree does not matter
+		if( hitShapes[brickTypes[mover.nType].eShape](sweep, mover.fX, mover.fY, colk, colx, coly) &&
+			(hit.o == -1 || colk < hit.colk || (colk == hit.colk && hit.o < -1 && i < hit.x)) )
+		{
+			BrickHit first = { i, SIM_MOVER(i), 0, colk, colx, coly };
+			hit = first;
+		}
+	}, nNodeTests);
+	stats.nNodeTests += nNodeTests;
+	PROF_COUNT(PROF_NODE_TESTS, nNodeTests);
+}
+
+template<class Bricks>
+static void MoveBall(const World &world, Bricks &level, SimState &ball, Real fPlatX0, bool bPlatform, Real dt, SimStats &stats, SimEventQueue *pEvents, SimMovers *pMovers)
+{
+	PROF_SCOPE(PROF_TIME_BALL);
+	Real &fBallX = ball.fBallX, &fBallY = ball.fBallY, &fBallDirX = ball.fBallDirX, &fBallDirY = ball.fBallDirY;
+	const Real fPlatX = ball.fPlatX, fSpanX = world.fSpanX, fSpanY = world.fSpanY, fPlatY = world.fPlatY;
+	// brick index of the last collision, or nPlatform
+	const int nNone = -1, nPlatform = -2;
+	int nLastCollision = nNone;
+	Real d = fBallSpeed * dt, fNewBallX, fNewBallY;
+	for (;;)
+	{
+		Real dx = fBallDirX * d, dy = fBallDirY * d;
+		Real fBallXc = fBallX + dx / 2, fBallYc = fBallY + dy / 2;
+		fNewBallX = fBallX + dx;
+		fNewBallY = fBallY + dy;
+		if (!ball.bValidSpeed)
+			break;
+		stats.nSubSteps++;
+		PROF_COUNT(PROF_SUBSTEPS, 1);
+		Real fMinDist = fMinDistBase + d / 2, colk = 0, coll, colx = 0, coly = 0;
+		bool bNewCollision = false;
+		int nCollision = nNone, nCollisionType = 0;
+		const BallSweep sweep = { fBallX, fBallY, fNewBallX, fNewBallY, dx, dy, fBallXc, fBallYc, fMinDist * fMinDist };
+		BrickHit hit = { 0, nNone, 0, 0, 0, 0 };
+		// only the cells whose center can be within fMinDist, in row order like a full scan
+		const int
+			x0 = max(level.GetCellX(fBallXc - fMinDist), 0), x1 = min(level.GetCellX(fBallXc + fMinDist), level.GetWidth() - 1),
+			y0 = max(level.GetCellY(fBallYc - fMinDist), 0), y1 = min(level.GetCellY(fBallYc + fMinDist), level.GetHeight() - 1);
+		for(int y = y0; y <= y1 && hit.o == nNone; y++)
+		{
+			for(int xs = x0; xs <= x1 && hit.o == nNone; xs += 32)
+			{
+				// one kernel per shape, adding brick types adds no tests here
+				const DWORD mask = LOW_BITS(x1 - xs + 1);
+				HitBricks<ShapeBall>(level, sweep, xs, y, mask, nLastCollision, hit, stats);
+				HitBricks<ShapeCube>(level, sweep, xs, y, mask, nLastCollision, hit, stats);
+				if( hit.o != nNone )
+					hit.y = y;
+			}
+		}
+		if( pMovers && pMovers->GetCount() )
+			HitMovers(*pMovers, sweep, fBallR, nLastCollision, hit, stats);
+		if( hit.o != nNone )
+		{
+			if( hit.o >= 0 )
+			{
+				nCollisionType = level.Get(hit.x, hit.y);
+				level.Set(hit.x, hit.y, brickTypes[nCollisionType].nNextType);
+			}
+			else if( pMovers ) // mover hits only come from HitMovers
+			{
+				nCollisionType = (*pMovers)[hit.x].nType;
+				pMovers->Hit(hit.x);
+			}
+			nCollision = hit.o;
+			colk = hit.colk;
+			colx = hit.colx;
+			coly = hit.coly;
+			bNewCollision = true;
+		}
+		if (bPlatform && !bNewCollision && nLastCollision != nPlatform && dy < 0)
+		{
+			Real fPlatSpan = (fPlatW + Abs(fPlatX - fPlatX0)) / 2;
+			Real fMinPlatDist = fBallR + d / 2 + fPlatSpan;
+			Real fPlatXc = (fPlatX + fPlatX0) / 2;
+			Real dxc = fBallXc - fPlatXc, dyc = fBallYc - fPlatY;
+			if (dxc * dxc + dyc * dyc <= fMinPlatDist * fMinPlatDist)
+			{
+				stats.nShapeTests++;
+				PROF_COUNT(PROF_PLATFORM_TESTS, 1);
+				if (IntersectSegmentSegment2D(
+					fBallX, fBallY, fNewBallX, fNewBallY,
+					fPlatXc - fPlatSpan, fPlatY + fBallR, fPlatXc + fPlatSpan, fPlatY + fBallR,
+					&colk, &coll))
+				{
+					colx = fPlatXc - fPlatSpan + 2 * fPlatSpan * coll;
+					coly = fPlatY;
+					bNewCollision = true;
+				}
+				else if (IntersectSegmentCircle2D(
+					fBallX, fBallY, fNewBallX, fNewBallY,
+					fPlatXc - fPlatSpan, fPlatY,
+					fBallR, &colk))
+				{
+					colx = fPlatXc - fPlatSpan;
+					coly = fPlatY;
+					bNewCollision = true;
+				}
+				else if (IntersectSegmentCircle2D(
+					fBallX, fBallY, fNewBallX, fNewBallY,
+					fPlatXc + fPlatSpan, fPlatY,
+					fBallR, &colk))
+				{
+					colx = fPlatXc + fPlatSpan;
+					coly = fPlatY;
+					bNewCollision = true;
+				}
+			}
+		}
+		if( !bNewCollision )
+			break;
+		nLastCollision = nCollision == nNone ? nPlatform : nCollision;
+		fBallX += dx * colk;
+		fBallY += dy * colk;
+
+		ball.nCollisions++;
+
+		Real xn = fBallX - colx, yn = fBallY - coly;
+		if( pEvents )
+		{
+			SimEvent ev = { nCollision == nNone ? SIM_PLATFORM : nCollision, nCollisionType, colx, coly, xn, yn, dt - d * (1 - colk) / fBallSpeed };
+			pEvents->Push(ev);
+		}
+		Real dot = fBallDirX * xn + fBallDirY * yn;
+		Real len = -2 * dot / (xn * xn + yn * yn);
+		SetNewDir(fBallDirX, fBallDirY, fBallDirX + len * xn, fBallDirY + len * yn);
+		d *= 1 - colk;
+	}
+	fBallX = fNewBallX;
+	fBallY = fNewBallY;
+	if( (fBallDirX < 0 && fBallX - fBallR <= -fSpanX) || (fBallDirX > 0 && fBallX + fBallR >= fSpanX) )
+	{
+		if( pEvents )
+		{
+			Real fWallX = fBallDirX < 0 ? -fSpanX : fSpanX;
+			SimEvent ev = { SIM_WALL, 0, fWallX, fBallY, fBallX - fWallX, 0, dt };
+			pEvents->Push(ev);
+		}
+		fBallDirX = -fBallDirX;
+	}
+	if( (fBallDirY < 0 && fBallY - fBallR <= -fSpanY) || (fBallDirY > 0 && fBallY + fBallR >= fSpanY) )
+	{
+		if( pEvents )
+		{
+			Real fWallY = fBallDirY < 0 ? -fSpanY : fSpanY;
+			SimEvent ev = { SIM_WALL, 0, fBallX, fWallY, 0, fBallY - fWallY, dt };
+			pEvents->Push(ev);
+		}
+		fBallDirY = -fBallDirY;
+	}
+}
+
+void SimMovers::Clear()
+{
+	m_vMovers.clear();
+	m_vProxies.clear();
+	m_tree.Clear();
+	m_nLive = 0;
+}
+
+Aabb SimMovers::GetBox(const SimMover &mover) const
+{
+	const Real r = brickTypes[mover.nType].eShape == ShapeCube ? fBrickRadiusCube : fBrickRadiusBall;
+	Aabb box = { mover.fX - r, mover.fY - r, mover.fX + r, mover.fY + r };
+	return box;
+}
+
+Aabb SimMovers::GetReach(const SimMover &mover) const
+{
+	Aabb box = GetBox(mover);
+	const Real r = box.fMaxX - mover.fX, fMaxReach = 4 * fBrickSize;
+	Aabb reach;
+	if( mover.fSin != 0 )
+	{
+		const Real dx = mover.fX - mover.fCX, dy = mover.fY - mover.fCY, fRadius = Sqrt(dx * dx + dy * dy) + r;
+		Aabb circle = { mover.fCX - fRadius, mover.fCY - fRadius, mover.fCX + fRadius, mover.fCY + fRadius };
+		reach = circle;
+	}
+	else
+	{
+		Aabb range = { mover.fMinX - r, mover.fMinY - r, mover.fMaxX + r, mover.fMaxY + r };
+		reach = range.Union(box);
+	}
+	return reach.fMaxX - reach.fMinX <= fMaxReach && reach.fMaxY - reach.fMinY <= fMaxReach ? reach : box;
+}
+
+int SimMovers::Add(const SimMover &mover)
+{
+	ASSERT(mover.nType >= 0 && mover.nType < MAX_TYPE);
+	const int i = (int)m_vMovers.size();
+	m_vMovers.push_back(mover);
+	m_vProxies.push_back(mover.nType ? m_tree.Insert(GetReach(mover), i) : -1);
+	m_nLive += mover.nType != 0;
+	return i;
+}
+
+void SimMovers::Step(Real dt)
+{
+	PROF_SCOPE(PROF_TIME_MOVERS);
+	for(size_t i = 0; i < m_vMovers.size(); i++)
+	{
+		SimMover &mover = m_vMovers[i];
+		if( !mover.nType )
+			continue;
+		const Real fX0 = mover.fX, fY0 = mover.fY;
+		if( mover.fSin != 0 )
+		{
+			const Real rx = mover.fX - mover.fCX, ry = mover.fY - mover.fCY;
+			mover.fX = mover.fCX + rx * mover.fCos - ry * mover.fSin;
+			mover.fY = mover.fCY + rx * mover.fSin + ry * mover.fCos;
+		}
+		else
+		{
+			mover.fX = mover.fX + mover.fVX * dt;
+			mover.fY = mover.fY + mover.fVY * dt;
+			if( (mover.fX < mover.fMinX && mover.fVX < 0) || (mover.fX > mover.fMaxX && mover.fVX > 0) )
+				mover.fVX = -mover.fVX;
+			if( (mover.fY < mover.fMinY && mover.fVY < 0) || (mover.fY > mover.fMaxY && mover.fVY > 0) )
+				mover.fVY = -mover.fVY;
+		}
+		m_tree.Move(m_vProxies[i], GetBox(mover), mover.fX - fX0, mover.fY - fY0);
+	}
+}
+
+void SimMovers::Hit(int i)
+{
+	SimMover &mover = m_vMovers[i];
+	ASSERT(mover.nType);
+	mover.nType = brickTypes[mover.nType].nNextType;
+	if( !mover.nType )
+	{
+		m_tree.Remove(m_vProxies[i]);
+		m_vProxies[i] = -1;
+		m_nLive--;
+	}
+}
+
+void SimMovers::Load(const void *pData)
+{
+	if( !m_vMovers.empty() )
+		memcpy(&m_vMovers[0], pData, GetSize());
+	// the tree follows the movers it had, whatever its shape ends up, the hits are the same
+	m_nLive = 0;
+	for(size_t i = 0; i < m_vMovers.size(); i++)
+	{
+		const SimMover &mover = m_vMovers[i];
+		int &nProxy = m_vProxies[i];
+		if( !mover.nType )
+		{
+			if( nProxy >= 0 )
+				m_tree.Remove(nProxy);
+			nProxy = -1;
+			continue;
+		}
+		m_nLive++;
+		if( nProxy < 0 )
+			nProxy = m_tree.Insert(GetReach(mover), (int)i);
+		else
+			m_tree.Move(nProxy, GetBox(mover), 0, 0);
+	}
+}
+
+void SimStep(World &world, const SimInput &input, Real dt)
+{
+	PROF_TICK();
+	PROF_SCOPE(PROF_TIME_STEP);
+	world.stats.nSteps++;
+	if( world.pEvents )
+		world.pEvents->Clear();
+
+	if( input.bAim )
+		world.bValidSpeed = SetNewDir(world.fBallDirX, world.fBallDirY, input.fAimX - world.fBallX, input.fAimY - world.fBallY) > 0;
+
+	Real &fPlatX = world.fPlatX, fPlatX0 = fPlatX;
+	if (input.bRight)
+		fPlatX = min(world.fSpanX - fPlatW / 2, fPlatX + fPlatV * dt);
+	else if (input.bLeft)
+		fPlatX = max(-world.fSpanX + fPlatW / 2, fPlatX - fPlatV * dt);
+
+	world.movers.Step(dt);
+	MoveBall(world, world.level, world, fPlatX0, true, dt, world.stats, world.pEvents, &world.movers);
+}
+
+void SimSnapshots::Create(const World &world, int nSlots)
+{
+	ASSERT(nSlots > 0);
+	m_nSlots = nSlots;
+	m_nBricksSize = world.level.GetBricksSize();
+	m_nMoversSize = world.movers.GetSize();
+	m_nSlotSize = (sizeof(Slot) + m_nBricksSize + m_nMoversSize + sizeof(__int64) - 1) & ~(sizeof(__int64) - 1);
+	m_vData.assign(m_nSlots * m_nSlotSize / sizeof(__int64), 0);
+	for(int i = 0; i < m_nSlots; i++)
+		GetSlot(i).nTick = -1;
+}
+
+void SimSnapshots::Save(const World &world, int nTick)
+{
+	ASSERT(nTick >= 0 && world.level.GetBricksSize() == m_nBricksSize && world.movers.GetSize() == m_nMoversSize);
+	Slot &slot = GetSlot(nTick);
+	slot.nTick = nTick;
+	slot.state = world;
+	world.level.SaveBricks(&slot + 1);
+	world.movers.Save((BYTE*)(&slot + 1) + m_nBricksSize);
+}
+
+bool SimSnapshots::Restore(World &world, int nTick) const
+{
+	if( nTick < 0 || !m_nSlots || world.level.GetBricksSize() != m_nBricksSize || world.movers.GetSize() != m_nMoversSize )
+		return false;
+	const Slot &slot = GetSlot(nTick);
+	if( slot.nTick != nTick )
+		return false;
+	(SimState&)world = slot.state;
+	world.level.LoadBricks(&slot + 1);
+	world.movers.Load((const BYTE*)(&slot + 1) + m_nBricksSize);
+	return true;
+}
+
+int SimPredictor::Find(const World &world) const
+{
+	if( m_pLevel != &world.level || m_uVersion != world.level.GetVersion() || m_fSpanX != world.fSpanX || m_fPlatY != world.fPlatY )
+		return -1;
+	for(int i = m_nTick; i < (int)m_vTicks.size(); i++)
+	{
+		const Tick &tick = m_vTicks[i];
+		if( tick.fX == world.fBallX && tick.fY == world.fBallY && tick.fDirX == world.fBallDirX && tick.fDirY == world.fBallDirY )
+			return i;
+	}
+	return -1;
+}
+
+void SimPredictor::Run(const World &world, int nTicks, int nMaxBounces)
+{
+	m_pLevel = &world.level;
+	m_uVersion = world.level.GetVersion();
+	m_fSpanX = world.fSpanX;
+	m_fPlatY = world.fPlatY;
+	m_bArrived = false;
+	m_nTick = 0;
+	m_vTicks.clear();
+	m_vBounces.clear();
+	m_overlay.Reset(world.level);
+	m_nPredicted++;
+
+	const Real fArrivalY = world.fPlatY + fBallR;
+	SimStats stats;
+	SimEventQueue events;
+	SimState ball = world;
+	for(int i = 0; i < nTicks && (int)m_vBounces.size() < nMaxBounces; i++)
+	{
+		Tick tick = { ball.fBallX, ball.fBallY, ball.fBallDirX, ball.fBallDirY };
+		m_vTicks.push_back(tick);
+		events.Clear();
+		MoveBall(world, m_overlay, ball, ball.fPlatX, false, fSimTick, stats, &events, (SimMovers*)NULL);
+		const Real fTime = fSimTick * i;
+		for(int j = 0; j < events.nCount; j++)
+		{
+			const SimEvent &ev = events.events[j];
+			SimBounce bounce = { ev.fX + ev.fNormX, ev.fY + ev.fNormY, fTime + ev.fTime, ev.nBrick };
+			m_vBounces.push_back(bounce);
+		}
+		if( tick.fY > fArrivalY && ball.fBallY <= fArrivalY )
+		{
+			Real k = (tick.fY - fArrivalY) / (tick.fY - ball.fBallY);
+			SimBounce arrival = { tick.fX + (ball.fBallX - tick.fX) * k, fArrivalY, fTime + fSimTick * k, SIM_PLATFORM };
+			m_arrival = arrival;
+			m_bArrived = true;
+			break;
+		}
+	}
+}
+
+const std::vector<SimBounce> &SimPredictor::Predict(const World &world, Real fHorizon, int nMaxBounces)
+{
+	m_vResult.clear();
+	if( !world.bValidSpeed )
+		return m_vResult;
+	const int nTicks = Floor(fHorizon / fSimTick);
+	int nTick = Find(world);
+	if( nTick >= 0 && !m_bArrived )
+	{
+		// still on the path, but it may not reach far enough from here
+		int nBounces = 0;
+		for(size_t i = 0; i < m_vBounces.size(); i++)
+			nBounces += m_vBounces[i].fTime >= fSimTick * nTick;
+		if( nBounces < nMaxBounces && (int)m_vTicks.size() - nTick < nTicks )
+			nTick = -1;
+	}
+	if( nTick < 0 )
+	{
+		// twice as far as asked, so that the following ticks can reuse it
+		Run(world, 2 * nTicks, 2 * nMaxBounces);
+		nTick = 0;
+	}
+	else
+		m_nReused++;
+	m_nTick = nTick;
+
+	const Real fStart = fSimTick * nTick;
+	for(size_t i = 0; i < m_vBounces.size() && (int)m_vResult.size() < nMaxBounces; i++)
+	{
+		SimBounce bounce = m_vBounces[i];
+		bounce.fTime -= fStart;
+		if( bounce.fTime < 0 )
+			continue;
+		if( bounce.fTime > fHorizon )
+			break;
+		m_vResult.push_back(bounce);
+	}
+	// the arrival at the platform is not a bounce, it comes on top of them
+	if( m_bArrived && m_arrival.fTime - fStart <= fHorizon )
+	{
+		m_vResult.push_back(m_arrival);
+		m_vResult.back().fTime -= fStart;
+	}
+	return m_vResult;
+}
@@ -0,0 +1,243 @@
+#ifndef __SIMULATION_H_
+#define __SIMULATION_H_
+
+#include "Utils.h"
+#include "Fixed.h"
+#include "Math.h"
+#include "Level.h"
+#include "AabbTree.h"
+
+// default level size
+#define LEVEL_WIDTH 20
+#define LEVEL_HEIGHT 10
+
+extern const Real
+	fSimTick,
+	fBallSpeed,
+	fBallR,
+	fLevelWidth,
+	fBrickMargin,
+	fBrickSize,
+	fBrickRadiusBall,
+	fBrickRadiusCube,
+	fMinDistBase,
+	fMinDistBall,
+	fLevelOffsetX,
+	fLevelOffsetY,
+	fLevelSpanX,
+	fLevelSpanY,
+	fPlatW, fPlatV, fPlatH,
+	fBallXStart;
+
+// Collision shapes, each has its own kernel in MoveBall
+enum BrickShape
+{
+	ShapeBall,
+	ShapeCube,
+	MAX_SHAPE
+};
+
+// What a brick type is and does; the only place that knows the types
+struct BrickType
+{
+	BrickShape eShape;
+	int nHitPoints;         // hits to take it out, through the nNextType chain
+	int nNextType;          // type it turns into when hit, 0 when it is gone
+	const char *pchTexture; // image key, NULL for the empty cell
+	BrickShape eMesh;       // shape drawn, need not be the one it collides with
+};
+
+extern const BrickType brickTypes[MAX_TYPE];
+
+// Player input for one tick. With SIM_FIXED_POINT this is all the lockstep peers have to exchange.
+struct SimInput
+{
+	bool bLeft, bRight, bAim;
+	Real fAimX, fAimY;
+};
+
+#define SIM_PLATFORM -1
+#define SIM_WALL -2
+#define SIM_MOVER(i) (-3 - (i))
+#define MAX_SIM_EVENTS 32
+
+// A ball contact of the last step
+struct SimEvent
+{
+	int nBrick;          // cell index, SIM_MOVER(mover index), SIM_PLATFORM or SIM_WALL
+	int nType;           // brick type before the hit
+	Real fX, fY;         // contact point
+	Real fNormX, fNormY; // from the contact point to the ball center, not normalized
+	Real fTime;          // since the start of the step
+};
+
+// Contacts of one step, in the order they happened. Effects, debug drawing, scoring and networking
+// read them after SimStep instead of working inside the collision loop.
+struct SimEventQueue
+{
+	int nCount, nLost; // contacts over MAX_SIM_EVENTS are only counted
+	SimEvent events[MAX_SIM_EVENTS];
+	void Clear() { nCount = nLost = 0; }
+	void Push(const SimEvent &ev)
+	{
+		if( nCount < MAX_SIM_EVENTS )
+			events[nCount++] = ev;
+		else
+			nLost++;
+	}
+};
+
+// Work counters for the benchmarks, cheap enough to keep in every build
+struct SimStats
+{
+	int nSteps;      // SimStep calls
+	int nSubSteps;   // ball moves between collisions
+	int nCellTests;  // bricks tested against the swept ball bounds
+	int nShapeTests; // exact ball-shape intersection tests
+	int nNodeTests;  // mover tree nodes tested
+};
+
+// A brick off the level grid, sliding back and forth or going round a center.
+// It keeps its box for the collisions of the whole tick, moving is only checked against the ball at the tick edges.
+struct SimMover
+{
+	int nType;                       // brick type, 0 once it is gone
+	Real fX, fY;                     // center
+	Real fVX, fVY;                   // velocity of a sliding one
+	Real fMinX, fMinY, fMaxX, fMaxY; // where a sliding one turns back
+	Real fCX, fCY;                   // center of an orbiting one
+	Real fCos, fSin;                 // its rotation per step, fSin is 0 for a sliding one
+};
+
+// The movers of a world and the tree of their boxes the ball queries, next to the level grid
+class SimMovers
+{
+	std::vector<SimMover> m_vMovers;
+	std::vector<int> m_vProxies; // tree proxy of each mover, -1 once it is gone
+	AabbTree m_tree;
+	int m_nLive;
+
+	Aabb GetBox(const SimMover &mover) const;
+	// Box it goes into the tree with: its whole path when that is short, so it never has to move there
+	Aabb GetReach(const SimMover &mover) const;
+public:
+	SimMovers():m_nLive(0){}
+	void Clear();
+	// Returns the mover index
+	int Add(const SimMover &mover);
+	// Moves every mover one step on and refits the tree
+	void Step(Real dt);
+	// The mover was hit and turns into the next type of its brick type
+	void Hit(int i);
+	// Calls f(i) for every mover whose box may overlap the box
+	template<class F>
+	void Query(const Aabb &box, F f, int &nTests) const { m_tree.Query(box, f, nTests); }
+
+	int GetCount() const { return (int)m_vMovers.size(); }
+	int GetLive() const { return m_nLive; }
+	const SimMover &operator[](int i) const { return m_vMovers[i]; }
+	const AabbTree &GetTree() const { return m_tree; }
+	// Movers as one block for snapshots, the tree is refitted to them on load
+	int GetSize() const { return (int)(m_vMovers.size() * sizeof(SimMover)); }
+	void Save(void *pData) const
+	{
+		if( !m_vMovers.empty() )
+			memcpy(pData, &m_vMovers[0], GetSize());
+	}
+	void Load(const void *pData);
+};
+
+// What a step changes apart from the bricks, as one trivially copyable block for snapshots
+struct SimState
+{
+	Real fBallX, fBallY, fBallDirX, fBallDirY;
+	Real fPlatX;
+	bool bValidSpeed;
+	int nCollisions;
+};
+
+// Complete gameplay state; only changed by SimStep, so peers stepping the same inputs stay identical
+struct World : SimState
+{
+	LevelGrid level;
+	SimMovers movers;
+	Real fSpanX, fSpanY, fPlatY; // walls and platform, grown with the level
+	SimStats stats;
+	SimEventQueue *pEvents; // cleared and filled by every step, NULL when nobody listens
+	World():pEvents(NULL){}
+	bool IsCleared() const { return level.IsCleared() && !movers.GetLive(); }
+};
+
+// Fits the walls and the platform around world.level and resets the ball
+void SimCreate(World &world);
+void SimReset(World &world);
+void SimStep(World &world, const SimInput &input, Real dt);
+
+// Preallocated ring of world snapshots for rollback, one per tick.
+// Saving or restoring one is a copy of the SimState block, one of the bricks block and one of the movers.
+class SimSnapshots
+{
+	struct Slot
+	{
+		int nTick;
+		SimState state;
+	};
+	int m_nSlots, m_nSlotSize, m_nBricksSize, m_nMoversSize;
+	std::vector<__int64> m_vData; // m_nSlots slots of m_nSlotSize bytes: Slot, the bricks and the movers
+
+	Slot &GetSlot(int nTick) { return *(Slot*)((BYTE*)&m_vData[0] + (nTick % m_nSlots) * m_nSlotSize); }
+	const Slot &GetSlot(int nTick) const { return *(const Slot*)((const BYTE*)&m_vData[0] + (nTick % m_nSlots) * m_nSlotSize); }
+public:
+	SimSnapshots():m_nSlots(0), m_nSlotSize(0), m_nBricksSize(0), m_nMoversSize(0){}
+	// Room for the last nSlots ticks of the world, with the bricks it has now
+	void Create(const World &world, int nSlots);
+	// The world at the start of the tick
+	void Save(const World &world, int nTick);
+	// False if the tick was not saved or has been overwritten since
+	bool Restore(World &world, int nTick) const;
+	int GetSlotSize() const { return m_nSlotSize; }
+};
+
+// A point of the predicted ball path
+struct SimBounce
+{
+	Real fX, fY;  // ball center
+	Real fTime;   // from the queried state
+	int nBrick;   // cell index, SIM_WALL, or SIM_PLATFORM for the arrival at the platform line
+};
+
+// Follows the ball ahead with the same step code as SimStep, for aim guides and AI players.
+// The level is not changed and the platform and the movers are left out: the path ends where the ball comes down to it.
+// A prediction is reused, only shifted, while the ball stays on it and the level does not change,
+// so asking every tick or many times per tick costs a few comparisons.
+class SimPredictor
+{
+	struct Tick
+	{
+		Real fX, fY, fDirX, fDirY;
+	};
+	std::vector<Tick> m_vTicks;        // ball at the start of each predicted tick
+	std::vector<SimBounce> m_vBounces; // times from the first tick
+	std::vector<SimBounce> m_vResult;
+	SimBounce m_arrival;
+	LevelOverlay m_overlay;
+	const LevelGrid *m_pLevel;
+	unsigned int m_uVersion;
+	Real m_fSpanX, m_fPlatY;
+	bool m_bArrived;                   // the path ends at the platform line
+	int m_nTick, m_nPredicted, m_nReused;
+
+	int Find(const World &world) const;
+	void Run(const World &world, int nTicks, int nMaxBounces);
+public:
+	SimPredictor():m_pLevel(NULL), m_uVersion(0), m_fSpanX(0), m_fPlatY(0), m_bArrived(false), m_nTick(0), m_nPredicted(0), m_nReused(0){}
+	// Bounces within fHorizon seconds, up to nMaxBounces, and the arrival at the platform line if it comes first.
+	// The result stays valid until the next call.
+	const std::vector<SimBounce> &Predict(const World &world, Real fHorizon, int nMaxBounces);
+	// Forgets the path; a level replaced by another one gets a new version, so this is never needed for that
+	void Invalidate() { m_pLevel = NULL; }
+	int GetPredicted() const { return m_nPredicted; }
+	int GetReused() const { return m_nReused; }
+};
+
+#endif __SIMULATION_H_
@@ -0,0 +1,249 @@
+#include <algorithm>
+
+#include "SplineTree.h"
+
+static float DistBoxPoint2(const Point &ptMin, const Point &ptMax, const Point &pt)
+{
+	const float
+		dx = max(0.0f, max(ptMin.x - pt.x, pt.x - ptMax.x)),
+		dy = max(0.0f, max(ptMin.y - pt.y, pt.y - ptMax.y)),
+		dz = max(0.0f, max(ptMin.z - pt.z, pt.z - ptMax.z));
+	return dx * dx + dy * dy + dz * dz;
+}
+
+static float DistBoxBox2(const Point &ptMin1, const Point &ptMax1, const Point &ptMin2, const Point &ptMax2)
+{
+	const float
+		dx = max(0.0f, max(ptMin1.x - ptMax2.x, ptMin2.x - ptMax1.x)),
+		dy = max(0.0f, max(ptMin1.y - ptMax2.y, ptMin2.y - ptMax1.y)),
+		dz = max(0.0f, max(ptMin1.z - ptMax2.z, ptMin2.z - ptMax1.z));
+	return dx * dx + dy * dy + dz * dz;
+}
+
+static void SplineBox(const Point *pt, Point &ptMin, Point &ptMax)
+{
+	ptMin = ptMax = pt[0];
+	for(int i = 1; i < 4; i++)
+	{
+		ptMin = Point(min(ptMin.x, pt[i].x), min(ptMin.y, pt[i].y), min(ptMin.z, pt[i].z));
+		ptMax = Point(max(ptMax.x, pt[i].x), max(ptMax.y, pt[i].y), max(ptMax.z, pt[i].z));
+	}
+}
+
+void SplineTree::Clear()
+{
+	m_vNodes.clear();
+	m_vPoints.clear();
+	m_nRoot = -1;
+}
+
+void SplineTree::Build(const Point *ptSplines, int nCount)
+{
+	Clear();
+	if( nCount <= 0 )
+		return;
+	m_vPoints.assign(ptSplines, ptSplines + 4 * nCount);
+	m_vNodes.reserve(2 * nCount - 1);
+	std::vector<int> vSplines(nCount);
+	for(int i = 0; i < nCount; i++)
+		vSplines[i] = i;
+	m_nRoot = Build(&vSplines[0], nCount);
+}
+
+// compares splines by the center of their box along an axis
+struct SplineCenterLess
+{
+	const Point *pPoints;
+	int nAxis;
+	float Center(int nSpline) const
+	{
+		const float *pf = &pPoints[4 * nSpline].x + nAxis;
+		float fMin = pf[0], fMax = pf[0];
+		for(int i = 1; i < 4; i++)
+		{
+			fMin = min(fMin, pf[3 * i]);
+			fMax = max(fMax, pf[3 * i]);
+		}
+		return fMin + fMax;
+	}
+	bool operator()(int n1, int n2) const { return Center(n1) < Center(n2); }
+};
+
+int SplineTree::Build(int *pnSplines, int nCount)
+{
+	const int nNode = (int)m_vNodes.size();
+	m_vNodes.resize(nNode + 1);
+	if( nCount == 1 )
+	{
+		Node &node = m_vNodes[nNode];
+		SplineBox(GetSpline(pnSplines[0]), node.ptMin, node.ptMax);
+		node.nLeft = -1;
+		node.nRight = pnSplines[0];
+		return nNode;
+	}
+	// the longest side of the box of the centers
+	Point ptMin(FLT_MAX, FLT_MAX, FLT_MAX), ptMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for(int i = 0; i < nCount; i++)
+	{
+		Point ptBoxMin, ptBoxMax;
+		SplineBox(GetSpline(pnSplines[i]), ptBoxMin, ptBoxMax);
+		const Point ptCenter = (ptBoxMin + ptBoxMax) * 0.5f;
+		ptMin = Point(min(ptMin.x, ptCenter.x), min(ptMin.y, ptCenter.y), min(ptMin.z, ptCenter.z));
+		ptMax = Point(max(ptMax.x, ptCenter.x), max(ptMax.y, ptCenter.y), max(ptMax.z, ptCenter.z));
+	}
+	const Point ptSize = ptMax - ptMin;
+	SplineCenterLess less = { &m_vPoints[0], ptSize.x >= ptSize.y && ptSize.x >= ptSize.z ? 0 : ptSize.y >= ptSize.z ? 1 : 2 };
+	const int nHalf = nCount / 2;
+	std::nth_element(pnSplines, pnSplines + nHalf, pnSplines + nCount, less);
+
+	const int nLeft = Build(pnSplines, nHalf), nRight = Build(pnSplines + nHalf, nCount - nHalf);
+	Node &node = m_vNodes[nNode]; // after the children, which grow the vector
+	const Node &left = m_vNodes[nLeft], &right = m_vNodes[nRight];
+	node.ptMin = Point(min(left.ptMin.x, right.ptMin.x), min(left.ptMin.y, right.ptMin.y), min(left.ptMin.z, right.ptMin.z));
+	node.ptMax = Point(max(left.ptMax.x, right.ptMax.x), max(left.ptMax.y, right.ptMax.y), max(left.ptMax.z, right.ptMax.z));
+	node.nLeft = nLeft;
+	node.nRight = nRight;
+	return nNode;
+}
+
+int SplineTree::Nearest(const Point &ptPos, float fMaxDist, float *pfDist2, float *pfT, int &nTests, int &nSolves) const
+{
+	float fBest2 = fMaxDist < FLT_MAX ? fMaxDist * fMaxDist : FLT_MAX, fBestT = 0;
+	int nBest = -1;
+	if( m_nRoot < 0 )
+		return -1;
+	// the nearer child is tested first, so that the farther one is mostly pruned by then
+	int stack[MAX_TREE_DEPTH], nStack = 0;
+	stack[nStack++] = m_nRoot;
+	while( nStack )
+	{
+		const Node &node = m_vNodes[stack[--nStack]];
+		nTests++;
+		if( DistBoxPoint2(node.ptMin, node.ptMax, ptPos) > fBest2 )
+			continue;
+		if( node.IsLeaf() )
+		{
+			float t;
+			const float fDist2 = DistSplinePoint2(GetSpline(node.nRight), ptPos, -1, &t);
+			nSolves++;
+			if( fDist2 < fBest2 || (fDist2 == fBest2 && nBest < 0) )
+			{
+				fBest2 = fDist2;
+				fBestT = t;
+				nBest = node.nRight;
+			}
+			continue;
+		}
+		const Node &left = m_vNodes[node.nLeft], &right = m_vNodes[node.nRight];
+		const bool bLeftFirst = DistBoxPoint2(left.ptMin, left.ptMax, ptPos) <= DistBoxPoint2(right.ptMin, right.ptMax, ptPos);
+		ASSERT(nStack + 2 <= MAX_TREE_DEPTH);
+		stack[nStack++] = bLeftFirst ? node.nRight : node.nLeft;
+		stack[nStack++] = bLeftFirst ? node.nLeft : node.nRight;
+	}
+	if( nBest >= 0 )
+	{
+		if( pfDist2 ) *pfDist2 = fBest2;
+		if( pfT ) *pfT = fBestT;
+	}
+	return nBest;
+}
+
+int SplineTree::Nearest(const Point *ptSpline, float fMaxDist, float *pfDist2, float *pfT1, float *pfT2, int &nTests, int &nSolves) const
+{
+	float fBest2 = fMaxDist < FLT_MAX ? fMaxDist * fMaxDist : FLT_MAX, fBestT1 = 0, fBestT2 = 0;
+	int nBest = -1;
+	if( m_nRoot < 0 )
+		return -1;
+	Point ptMin, ptMax;
+	SplineBox(ptSpline, ptMin, ptMax);
+	int stack[MAX_TREE_DEPTH], nStack = 0;
+	stack[nStack++] = m_nRoot;
+	while( nStack )
+	{
+		const Node &node = m_vNodes[stack[--nStack]];
+		nTests++;
+		if( DistBoxBox2(node.ptMin, node.ptMax, ptMin, ptMax) > fBest2 )
+			continue;
+		if( node.IsLeaf() )
+		{
+			float t1, t2;
+			const float fDist2 = DistSplineSpline2(ptSpline, GetSpline(node.nRight), -1, &t1, &t2);
+			nSolves++;
+			if( fDist2 < fBest2 || (fDist2 == fBest2 && nBest < 0) )
+			{
+				fBest2 = fDist2;
+				fBestT1 = t1;
+				fBestT2 = t2;
+				nBest = node.nRight;
+			}
+			continue;
+		}
+		const Node &left = m_vNodes[node.nLeft], &right = m_vNodes[node.nRight];
+		const bool bLeftFirst = DistBoxBox2(left.ptMin, left.ptMax, ptMin, ptMax) <= DistBoxBox2(right.ptMin, right.ptMax, ptMin, ptMax);
+		ASSERT(nStack + 2 <= MAX_TREE_DEPTH);
+		stack[nStack++] = bLeftFirst ? node.nRight : node.nLeft;
+		stack[nStack++] = bLeftFirst ? node.nLeft : node.nRight;
+	}
+	if( nBest >= 0 )
+	{
+		if( pfDist2 ) *pfDist2 = fBest2;
+		if( pfT1 ) *pfT1 = fBestT1;
+		if( pfT2 ) *pfT2 = fBestT2;
+	}
+	return nBest;
+}
+
+void SplineTree::Pairs(float fRadius, std::vector<SplinePair> &vPairs, int &nTests, int &nSolves) const
+{
+	vPairs.clear();
+	if( m_nRoot < 0 )
+		return;
+	const float fRadius2 = fRadius * fRadius;
+	// The tree against itself: a node with itself goes on as its children with themselves and with each
+	// other, so every pair of leaves comes up once
+	std::vector<std::pair<int, int> > vStack;
+	vStack.push_back(std::make_pair(m_nRoot, m_nRoot));
+	while( !vStack.empty() )
+	{
+		const int nNode1 = vStack.back().first, nNode2 = vStack.back().second;
+		vStack.pop_back();
+		const Node &node1 = m_vNodes[nNode1], &node2 = m_vNodes[nNode2];
+		nTests++;
+		if( nNode1 == nNode2 )
+		{
+			if( !node1.IsLeaf() )
+			{
+				vStack.push_back(std::make_pair(node1.nLeft, node1.nLeft));
+				vStack.push_back(std::make_pair(node1.nRight, node1.nRight));
+				vStack.push_back(std::make_pair(node1.nLeft, node1.nRight));
+			}
+			continue;
+		}
+		if( DistBoxBox2(node1.ptMin, node1.ptMax, node2.ptMin, node2.ptMax) > fRadius2 )
+			continue;
+		if( node1.IsLeaf() && node2.IsLeaf() )
+		{
+			// the lower one first, for the same result whichever way the tree went
+			SplinePair pair;
+			pair.n1 = min(node1.nRight, node2.nRight);
+			pair.n2 = max(node1.nRight, node2.nRight);
+			pair.fDist2 = DistSplineSpline2(GetSpline(pair.n1), GetSpline(pair.n2), -1, &pair.t1, &pair.t2);
+			nSolves++;
+			if( pair.fDist2 <= fRadius2 )
+				vPairs.push_back(pair);
+			continue;
+		}
+		// the larger box is split
+		const Point ptSize1 = node1.ptMax - node1.ptMin, ptSize2 = node2.ptMax - node2.ptMin;
+		if( node2.IsLeaf() || (!node1.IsLeaf() && ptSize1.x + ptSize1.y + ptSize1.z >= ptSize2.x + ptSize2.y + ptSize2.z) )
+		{
+			vStack.push_back(std::make_pair(node1.nLeft, nNode2));
+			vStack.push_back(std::make_pair(node1.nRight, nNode2));
+		}
+		else
+		{
+			vStack.push_back(std::make_pair(nNode1, node2.nLeft));
+			vStack.push_back(std::make_pair(nNode1, node2.nRight));
+		}
+	}
+}
@@ -0,0 +1,54 @@
+#ifndef __SPLINETREE_H_
+#define __SPLINETREE_H_
+
+#include <vector>
+
+#include "Utils.h"
+#include "Math.h"
+#include "AabbTree.h" // MAX_TREE_DEPTH
+
+// Two splines of a SplineTree within the radius asked, n1 < n2, and their nearest points
+struct SplinePair
+{
+	int n1, n2;
+	float fDist2, t1, t2;
+};
+
+// Bounding volume tree over splines given by their 4 control points, for rails, trails and curved walls.
+// A spline lies within the convex hull of its control points, so the box of these bounds it; the boxes
+// prune the splines before DistSplinePoint2 and DistSplineSpline2 run on the ones left. The tree is built
+// at once top down, splitting the splines at the median of their centers along the longest side, and
+// built again when they change.
+class SplineTree
+{
+	struct Node
+	{
+		Point ptMin, ptMax;
+		int nLeft, nRight; // the children, or -1 and the spline for leaves
+		bool IsLeaf() const { return nLeft < 0; }
+	};
+	std::vector<Node> m_vNodes;
+	std::vector<Point> m_vPoints; // 4 control points for each spline
+	int m_nRoot;
+
+	int Build(int *pnSplines, int nCount);
+public:
+	SplineTree():m_nRoot(-1){}
+	// nCount splines of 4 control points each
+	void Build(const Point *ptSplines, int nCount);
+	void Clear();
+
+	int GetCount() const { return (int)m_vPoints.size() / 4; }
+	const Point *GetSpline(int nSpline) const { return &m_vPoints[4 * nSpline]; }
+
+	// The spline nearest to ptPos, and the squared distance and t of its nearest point. Returns -1 when
+	// none is within fMaxDist. nTests counts the nodes tested and nSolves the solver calls.
+	int Nearest(const Point &ptPos, float fMaxDist, float *pfDist2, float *pfT, int &nTests, int &nSolves) const;
+	// The same for the spline nearest to another one, which needs not be in the tree
+	int Nearest(const Point *ptSpline, float fMaxDist, float *pfDist2, float *pfT1, float *pfT2, int &nTests, int &nSolves) const;
+	// Every pair of splines in the tree within fRadius of each other, in no particular order. Splines
+	// joined end to end are pairs too.
+	void Pairs(float fRadius, std::vector<SplinePair> &vPairs, int &nTests, int &nSolves) const;
+};
+
+#endif __SPLINETREE_H_
@@ -0,0 +1,151 @@
+#include "ThreadPool.h"
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+ThreadPool::ThreadPool():m_evWork(true), m_evDone(false), m_nPending(0), m_bStop(false), m_nNext(0)
+{
+}
+
+ErrorCode ThreadPool::Start(int nThreads)
+{
+	Stop();
+	if( nThreads <= 0 )
+		nThreads = GetProcessors();
+	m_bStop = false;
+	for(int i = 0; i < nThreads; i++)
+	{
+		Worker *pWorker = new Worker;
+		pWorker->pPool = this;
+		pWorker->nIndex = i;
+		pWorker->nExecuted = 0;
+		pWorker->nStolen = 0;
+#ifdef _WIN32
+		pWorker->hThread = CreateThread(NULL, 0, WorkerProc, pWorker, 0, NULL);
+		if( !pWorker->hThread )
+#else
+		if( pthread_create(&pWorker->hThread, NULL, WorkerProc, pWorker) )
+#endif
+		{
+			delete pWorker;
+			Stop();
+			return "Failed to start a worker thread";
+		}
+		m_vWorkers.push_back(pWorker);
+	}
+	return NO_ERROR;
+}
+
+int ThreadPool::GetProcessors()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return max((int)info.dwNumberOfProcessors, 1);
+#else
+	return max((int)sysconf(_SC_NPROCESSORS_ONLN), 1);
+#endif
+}
+
+void ThreadPool::Stop()
+{
+	m_bStop = true;
+	m_evWork.Signal();
+	for(size_t i = 0; i < m_vWorkers.size(); i++)
+	{
+		Worker *pWorker = m_vWorkers[i];
+#ifdef _WIN32
+		WaitForSingleObject(pWorker->hThread, INFINITE);
+		CloseHandle(pWorker->hThread);
+#else
+		pthread_join(pWorker->hThread, NULL);
+#endif
+		delete pWorker;
+	}
+	m_vWorkers.clear();
+	m_evWork.Reset();
+}
+
+void ThreadPool::Add(TaskProc pProc, void *pParam)
+{
+	ASSERT(!m_vWorkers.empty());
+	Task task = { pProc, pParam };
+	Worker &worker = *m_vWorkers[m_nNext++ % m_vWorkers.size()];
+	InterlockedIncrement(&m_nPending);
+	{
+		Lock lock(worker.cs);
+		worker.tasks.push_back(task);
+	}
+	m_evWork.Signal();
+}
+
+void ThreadPool::Wait()
+{
+	while( m_nPending )
+		m_evDone.Wait(10);
+}
+
+int ThreadPool::GetStolen() const
+{
+	int nStolen = 0;
+	for(size_t i = 0; i < m_vWorkers.size(); i++)
+		nStolen += m_vWorkers[i]->nStolen;
+	return nStolen;
+}
+
+bool ThreadPool::Pop(Worker &worker, Task &task)
+{
+	Lock lock(worker.cs);
+	if( worker.tasks.empty() )
+		return false;
+	task = worker.tasks.back();
+	worker.tasks.pop_back();
+	return true;
+}
+
+bool ThreadPool::Steal(Worker &worker, Task &task)
+{
+	const int nWorkers = (int)m_vWorkers.size();
+	for(int i = 1; i < nWorkers; i++)
+	{
+		Worker &victim = *m_vWorkers[(worker.nIndex + i) % nWorkers];
+		Lock lock(victim.cs);
+		if( victim.tasks.empty() )
+			continue;
+		task = victim.tasks.front();
+		victim.tasks.pop_front();
+		worker.nStolen++;
+		return true;
+	}
+	return false;
+}
+
+#ifdef _WIN32
+DWORD WINAPI ThreadPool::WorkerProc(void *param)
+#else
+void *ThreadPool::WorkerProc(void *param)
+#endif
+{
+	Worker &worker = *(Worker*)param;
+	ThreadPool &pool = *worker.pPool;
+	char pchName[32];
+	SetThreadName(FORMAT(pchName, "Worker %d", worker.nIndex));
+	while( !pool.m_bStop )
+	{
+		Task task;
+		if( pool.Pop(worker, task) || pool.Steal(worker, task) )
+		{
+			task.pProc(task.pParam);
+			worker.nExecuted++;
+			if( !InterlockedDecrement(&pool.m_nPending) )
+			{
+				pool.m_evWork.Reset();
+				pool.m_evDone.Signal();
+			}
+			continue;
+		}
+		// the timeout covers a task added just before the reset above
+		pool.m_evWork.Wait(10);
+	}
+	return 0;
+}
@@ -0,0 +1,64 @@
+#ifndef __THREADPOOL_H_
+#define __THREADPOOL_H_
+
+#include <deque>
+#include <vector>
+
+#include "Utils.h"
+
+typedef void (*TaskProc)(void *pParam);
+
+// Work stealing thread pool.
+// Every worker has its own task queue: it takes the newest task from its own queue
+// and, when that is empty, the oldest one from the queue of another worker.
+class ThreadPool
+{
+	struct Task
+	{
+		TaskProc pProc;
+		void *pParam;
+	};
+	struct Worker
+	{
+		ThreadPool *pPool;
+		int nIndex;
+#ifdef _WIN32
+		HANDLE hThread;
+#else
+		pthread_t hThread;
+#endif
+		CriticalSection cs;
+		std::deque<Task> tasks;
+		int nExecuted, nStolen;
+	};
+	std::vector<Worker*> m_vWorkers;
+	Event m_evWork, m_evDone;
+	volatile LONG m_nPending;
+	volatile bool m_bStop;
+	int m_nNext;
+
+	bool Pop(Worker &worker, Task &task);
+	bool Steal(Worker &worker, Task &task);
+#ifdef _WIN32
+	static DWORD WINAPI WorkerProc(void *param);
+#else
+	static void *WorkerProc(void *param);
+#endif
+public:
+	ThreadPool();
+	~ThreadPool(){ Stop(); }
+
+	// nThreads = 0 starts one worker per processor
+	ErrorCode Start(int nThreads = 0);
+	void Stop();
+	// Tasks are spread over the workers round robin, the idle ones steal the rest
+	void Add(TaskProc pProc, void *pParam);
+	// Blocks until every added task is done
+	void Wait();
+
+	int GetThreads() const { return (int)m_vWorkers.size(); }
+	int GetStolen() const;
+	static int GetProcessors();
+};
+
+#endif __THREADPOOL_H_
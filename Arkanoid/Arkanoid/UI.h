@@ -5,7 +5,7 @@
 #include <list>
 #include <string>
 
-#include "graphics.h"
+#include "Graphics.h"
 
 #define FONT_FACE_SIZE 32
 
@@ -1,5 +1,8 @@
-#include "utils.h"
+#include "Utils.h"
 #include <time.h>
+#ifndef _WIN32
+#include <sys/prctl.h>
+#endif
 
 BOOL File::Open(const char *pchFileName, const char *pchMode)
 {
@@ -33,12 +36,15 @@ void Print(const char *fmt, ...)
 	va_start(ap, fmt);
 		_vsnprintf(text, 1024, fmt, ap);
 	va_end(ap);
+#ifdef _WIN32
 	static BOOL s_bIsDebuggerPresent = IsDebuggerPresent();
 	if(s_bIsDebuggerPresent)
 		OutputDebugString(text);
-	printf(text);
+#endif
+	fputs(text, stdout);
 }
 
+#ifdef _WIN32
 void Message(HWND hWnd, char *fmt, ...)
 {
 	// ATTN: blocks the execution and may eat input messages!
@@ -73,12 +79,21 @@ void SetThreadName(LPCSTR name, DWORD threadID)
 	{
 	}
 }
+#else
+void SetThreadName(LPCSTR name, DWORD threadID)
+{
+	// only the calling thread can be named here
+	if(name && name[0] && threadID == (DWORD)-1)
+		prctl(PR_SET_NAME, name, 0, 0, 0);
+}
+#endif
 
 void InitRandGen()
 {
 	srand((UINT)time(NULL));
 }
 
+#ifdef _WIN32
 const char *FileDialog::GetFilterStr()
 {
 	if(!m_lFilters.size())
@@ -212,3 +227,4 @@ void Directory::Reset()
 		h=NULL;
 	}
 }
+#endif
@@ -1,12 +1,48 @@
 #ifndef __UTILS_H_
 #define __UTILS_H_
 
+#ifdef _WIN32
 #include <windows.h>			// Windows API Definitions
+#else
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 #include <stdio.h>
 #include <assert.h>
 #include <list>
 #include <string>
 
+#ifndef _WIN32
+// The few Windows types and helpers the portable code (simulation, levels, benchmarks) uses
+#define __int64 long long
+#define __int32 int
+typedef unsigned int DWORD;
+typedef unsigned int UINT;
+typedef unsigned char BYTE;
+typedef int BOOL;
+typedef int LONG;
+typedef const char *LPCSTR;
+#define TRUE 1
+#define FALSE 0
+#define MAX_PATH 260
+#define ZeroMemory(dest, size) memset((dest), 0, (size))
+#define _snprintf snprintf
+#define _vsnprintf vsnprintf
+#define _fileno fileno
+template<class A> inline A min(A a, A b) { return a < b ? a : b; }
+template<class A> inline A max(A a, A b) { return a > b ? a : b; }
+inline LONG InterlockedIncrement(volatile LONG *p) { return __sync_add_and_fetch(p, 1); }
+inline LONG InterlockedDecrement(volatile LONG *p) { return __sync_sub_and_fetch(p, 1); }
+#endif
+
+#include "FastMath.h"
+
 #ifdef _DEBUG
 #	define ASSERT(_Expression) assert(_Expression)
 #else
@@ -17,7 +53,9 @@
 #define NO_ERROR 0
 #endif
 
+#ifdef _MSC_VER
 #pragma warning(disable:4996)
+#endif
 
 #ifndef PI
 #	define PI 3.1415926535897932384626433832795f
@@ -33,7 +71,7 @@
 #define BOOL_TO_STR(boolean) ((boolean) ? "true" : "false")
 
 // Returns formatted text
-#define FORMAT(buff, fmt, ...) ( _snprintf(buff, sizeof(buff) - 1, fmt, __VA_ARGS__), buff[sizeof(buff) - 1] = 0, buff )
+#define FORMAT(buff, fmt, ...) ( _snprintf(buff, sizeof(buff) - 1, fmt, ##__VA_ARGS__), buff[sizeof(buff) - 1] = 0, buff )
 
 #define ArrSize(A) (sizeof(A)/sizeof((A)[0]))
 
@@ -42,7 +80,9 @@ inline int StrLen(const char *text) { return (text && *text) ? (int)strlen(text)
 typedef const char* ErrorCode;
 
 void Print(const char *fmt, ...);
+#ifdef _WIN32
 void Message(HWND hWnd, char *fmt, ...);
+#endif
 
 void SetThreadName(LPCSTR name, DWORD threadID = -1);
 
@@ -61,32 +101,50 @@ inline float Random(float fMin, float fMax)
 
 void InitRandGen();
 
-// FLOAT TO INT OPERATIONS:
-inline int Trunc(float x)
-{
-	int retval;
-	_asm cvttss2si eax, x
-	_asm mov retval, eax
-	return retval;
-}
-inline int Round(float x)
+// Generator with its own state: the same seed gives the same numbers on every thread and machine
+class RandGen
 {
-	return Trunc(x < 0.0f ? (x - 0.5f) : (x + 0.5f));
-}
-inline float FastInvSqrt(float x)
+	unsigned int m_uState;
+public:
+	RandGen(unsigned int uSeed = 1):m_uState(uSeed){}
+	int Next()
+	{
+		m_uState = m_uState * 1103515245 + 12345;
+		return (m_uState >> 16) & 0x7fff;
+	}
+	int Next(int nRange) { return nRange ? Next() % nRange : 0; }
+	float Next(float fMin, float fMax) { return fMin + (fMax - fMin) * Next() / 0x7fff; }
+};
+
+// BIT OPERATIONS:
+// Index of the lowest set bit, mask must not be zero
+inline int LowBit(DWORD mask)
 {
-	float res;
-	_asm rsqrtss xmm0, x
-	_asm movss res, xmm0
-	return res;
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (int)index;
+#else
+	return __builtin_ctz(mask);
+#endif
 }
-inline bool IsFloatZero(float x)
+// Index of the highest set bit, mask must not be zero
+inline int HighBit(DWORD mask)
 {
-	return !(*(const __int32 *)&x) || (*(const __int32 *)&x) == 0x80000000;
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse(&index, mask);
+	return (int)index;
+#else
+	return 31 - __builtin_clz(mask);
+#endif
 }
-inline bool IsFloatZero(const float *x)
+// Number of set bits
+inline int BitCount(DWORD mask)
 {
-	return !(*(const __int32 *)x) || (*(const __int32 *)x) == 0x80000000;
+	mask = mask - ((mask >> 1) & 0x55555555);
+	mask = (mask & 0x33333333) + ((mask >> 2) & 0x33333333);
+	return (int)((((mask + (mask >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24);
 }
 class File
 {
@@ -105,6 +163,7 @@ public:
 class CriticalSection // Thread synchronization class
 {
 protected:
+#ifdef _WIN32
 	CRITICAL_SECTION critical_section;
 public:
 	CriticalSection()
@@ -123,10 +182,35 @@ public:
 	{
 		LeaveCriticalSection(&critical_section);
 	}
+#else
+	pthread_mutex_t critical_section;
+public:
+	CriticalSection()
+	{
+		// recursive like a Windows critical section
+		pthread_mutexattr_t attr;
+		pthread_mutexattr_init(&attr);
+		pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+		pthread_mutex_init(&critical_section, &attr);
+		pthread_mutexattr_destroy(&attr);
+	}
+	~CriticalSection()
+	{
+		pthread_mutex_destroy(&critical_section);
+	}
+	void Enter()
+	{
+		pthread_mutex_lock(&critical_section);
+	}
+	void Leave()
+	{
+		pthread_mutex_unlock(&critical_section);
+	}
+#endif
 	void Wait()
 	{
-		EnterCriticalSection(&critical_section);
-		LeaveCriticalSection(&critical_section);
+		Enter();
+		Leave();
 	}
 };
 
@@ -149,6 +233,7 @@ class Timer
 {
 protected:
 	__int64 nCountsPerSecond, nStartCounter;
+#ifdef _WIN32
 	static __int64 Count()
 	{
 		LARGE_INTEGER tmp;
@@ -165,6 +250,20 @@ public:
 		nCountsPerSecond = (__int64)tmp.QuadPart;
 		Restart();
 	}
+#else
+	static __int64 Count()
+	{
+		timespec tmp;
+		if(clock_gettime(CLOCK_MONOTONIC, &tmp))
+			return 0;
+		return (__int64)tmp.tv_sec * 1000000000 + tmp.tv_nsec;
+	}
+public:
+	Timer():nCountsPerSecond(1000000000), nStartCounter(0)
+	{
+		Restart();
+	}
+#endif
 	float Time()
 	{
 		return nCountsPerSecond ? (float)(Count() - nStartCounter) / nCountsPerSecond : 0;
@@ -179,6 +278,7 @@ public:
 	}
 };
 
+#ifdef _WIN32
 class Event
 {
 protected:
@@ -210,6 +310,66 @@ public:
 	}
 };
 
+#else
+class Event
+{
+protected:
+	mutable pthread_mutex_t m_mutex;
+	mutable pthread_cond_t m_cond;
+	mutable bool m_bSignaled;
+	bool m_bManualReset;
+public:
+	Event(bool bManualReset = false, char *pEventName = 0):m_bSignaled(false), m_bManualReset(bManualReset)
+	{
+		pthread_mutex_init(&m_mutex, NULL);
+		pthread_cond_init(&m_cond, NULL);
+	}
+	~Event()
+	{
+		pthread_cond_destroy(&m_cond);
+		pthread_mutex_destroy(&m_mutex);
+	}
+	bool IsSignaled() const
+	{
+		return Wait(0);
+	}
+	bool Wait(int timeout = -1) const
+	{
+		timespec until;
+		clock_gettime(CLOCK_REALTIME, &until);
+		until.tv_sec += timeout / 1000;
+		until.tv_nsec += (timeout % 1000) * 1000000;
+		if(until.tv_nsec >= 1000000000)
+			until.tv_sec++, until.tv_nsec -= 1000000000;
+		pthread_mutex_lock(&m_mutex);
+		int err = 0;
+		while(!m_bSignaled && !err)
+			err = timeout == -1 ? pthread_cond_wait(&m_cond, &m_mutex) : pthread_cond_timedwait(&m_cond, &m_mutex, &until);
+		bool bSignaled = m_bSignaled;
+		if(!m_bManualReset)
+			m_bSignaled = false;
+		pthread_mutex_unlock(&m_mutex);
+		return bSignaled;
+	}
+	void Signal() const
+	{
+		pthread_mutex_lock(&m_mutex);
+		m_bSignaled = true;
+		if(m_bManualReset)
+			pthread_cond_broadcast(&m_cond);
+		else
+			pthread_cond_signal(&m_cond);
+		pthread_mutex_unlock(&m_mutex);
+	}
+	void Reset() const
+	{
+		pthread_mutex_lock(&m_mutex);
+		m_bSignaled = false;
+		pthread_mutex_unlock(&m_mutex);
+	}
+};
+#endif
+
 template<class A>
 A Clamp(A value, A min, A max)
 {
@@ -220,6 +380,7 @@ A Clamp(A value, A min, A max)
 	return value;
 }
 
+#ifdef _WIN32
 class FileDialog
 {
 protected:
@@ -326,5 +487,6 @@ public:
 	const char *GetCurrent();
 	static BOOL SetCurrent(const char *current);
 };
+#endif
 
 #endif __UTILS_H_
\ No newline at end of file